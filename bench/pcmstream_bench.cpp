@@ -0,0 +1,169 @@
+// Measures the per-block hand-off of PcmStream between a producer and a consumer thread,
+// and counts the heap allocations made while streaming. Build with
+// -DCONVERTER_BUILD_BENCHMARKS=ON and run pcmstream_bench [blocks].
+
+#include "pcmstream.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+
+struct Result {
+    double nsPerBlock{0.0};
+    uint64_t allocations{0};       // During the whole run
+    uint64_t steadyAllocations{0}; // After the ring was filled once
+};
+
+// The consumer reads a block at a time; with a slow consumer the ring runs full,
+// so deep rings use every slot and the producer sleeps on it
+Result run(int capacityBlocks, uint64_t blocks, int channels, bool slowConsumer)
+{
+    const PcmFormat format{44100, channels, 16};
+    PcmStream stream{format, blocks * PcmStream::BlockFrames, capacityBlocks};
+
+    const std::vector<float> input(static_cast<size_t>(PcmStream::BlockFrames * channels), 0.25F);
+    std::vector<float> output(input.size());
+    const uint64_t warmupBlocks = static_cast<uint64_t>(capacityBlocks) * 2;
+
+    std::atomic<bool> go{false};
+    uint64_t steadyStart{0};
+
+    std::thread producer{[&] {
+        while (!go.load()) { }
+        for (uint64_t block = 0; block < blocks; ++block) {
+            if (block == warmupBlocks) {
+                steadyStart = allocations.load();
+            }
+            stream.write(input.data(), PcmStream::BlockFrames);
+        }
+        stream.finish();
+    }};
+
+    const uint64_t startAllocations = allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true);
+
+    float sink{0.0F};
+    while (stream.read(output.data(), PcmStream::BlockFrames) > 0) {
+        sink += output.front();
+        if (slowConsumer) {
+            // About the cost of encoding a block, so the ring fills up
+            const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds{20};
+            while (std::chrono::steady_clock::now() < until) { }
+        }
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    producer.join();
+    const uint64_t endAllocations = allocations.load();
+
+    if (sink < 0.0F) {
+        std::printf("unexpected\n");
+    }
+
+    Result result;
+    result.nsPerBlock = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+                      / static_cast<double>(blocks);
+    result.allocations = endAllocations - startAllocations;
+    result.steadyAllocations = blocks > warmupBlocks ? endAllocations - steadyStart : 0;
+    return result;
+}
+} // namespace
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size > 0 ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto align = static_cast<size_t>(alignment);
+    if (void* memory = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+int main(int argc, char** argv)
+{
+    const uint64_t blocks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    constexpr int Channels = 2;
+
+    std::printf("%-10s %-10s %12s %12s %14s\n", "capacity", "consumer", "ns/block", "allocations",
+                "steady allocs");
+
+    // Default ring, and a deep one like those of CUE image slices
+    for (const int capacity : {PcmStream::PreallocatedBlocks, PcmStream::PreallocatedBlocks * 16}) {
+        for (const bool slow : {false, true}) {
+            const uint64_t runBlocks = slow ? blocks / 10 : blocks;
+            const Result result = run(capacity, runBlocks, Channels, slow);
+            std::printf("%-10d %-10s %12.1f %12llu %14llu\n", capacity, slow ? "slow" : "fast", result.nsPerBlock,
+                        static_cast<unsigned long long>(result.allocations),
+                        static_cast<unsigned long long>(result.steadyAllocations));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,487 @@
+#include "batchjournal.h"
+#include "stagedoutput.h"
+
+#include <core/engine/audioloader.h>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <algorithm>
+#include <utility>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+constexpr int JournalVersion = 1;
+// State changes within this interval share one write and sync
+constexpr int GroupCommitMs = 500;
+
+const char* stateName(BatchJournal::State state)
+{
+    switch (state) {
+        case BatchJournal::State::Queued:
+            return "queued";
+        case BatchJournal::State::Running:
+            return "running";
+        case BatchJournal::State::Done:
+            return "done";
+        case BatchJournal::State::Failed:
+            return "failed";
+    }
+    return "queued";
+}
+
+BatchJournal::State stateFromName(const QString& name)
+{
+    if (name == u"running") {
+        return BatchJournal::State::Running;
+    }
+    if (name == u"done") {
+        return BatchJournal::State::Done;
+    }
+    if (name == u"failed") {
+        return BatchJournal::State::Failed;
+    }
+    return BatchJournal::State::Queued;
+}
+
+QJsonObject optionsToJson(const ConversionOptions& options)
+{
+    return {{"format", options.format},
+            {"bitrate", options.bitrate},
+            {"quality", options.quality},
+            {"sampleRate", options.sampleRate},
+            {"channels", options.channels},
+            {"compressionLevel", options.compressionLevel},
+            {"bitDepth", options.bitDepth},
+            {"replayGain", options.replayGain},
+            {"passthrough", options.passthrough}};
+}
+
+ConversionOptions optionsFromJson(const QJsonObject& json)
+{
+    ConversionOptions options;
+    options.format = json.value("format").toString();
+    options.bitrate = json.value("bitrate").toInt(options.bitrate);
+    options.quality = json.value("quality").toInt(options.quality);
+    options.sampleRate = json.value("sampleRate").toInt();
+    options.channels = json.value("channels").toInt();
+    options.compressionLevel = json.value("compressionLevel").toInt(options.compressionLevel);
+    options.bitDepth = json.value("bitDepth").toInt();
+    options.replayGain = json.value("replayGain").toBool();
+    options.passthrough = json.value("passthrough").toBool(options.passthrough);
+    return options;
+}
+
+// What the converter needs to queue the track again; the rest is read from the file on resume
+QJsonObject trackToJson(const Fooyin::Track& track)
+{
+    QJsonObject json{{"path", track.filepath()},
+                     {"duration", static_cast<qint64>(track.duration())},
+                     {"size", static_cast<qint64>(track.fileSize())},
+                     {"modified", static_cast<qint64>(track.modifiedTime())},
+                     {"title", track.title()},
+                     {"artists", QJsonArray::fromStringList(track.artists())},
+                     {"album", track.album()},
+                     {"albumArtists", QJsonArray::fromStringList(track.albumArtists())},
+                     {"trackNumber", track.trackNumber()},
+                     {"trackTotal", track.trackTotal()},
+                     {"discNumber", track.discNumber()},
+                     {"discTotal", track.discTotal()},
+                     {"date", track.date()},
+                     {"genres", QJsonArray::fromStringList(track.genres())}};
+    if (track.hasCue()) {
+        json.insert("cue", track.cuePath());
+        json.insert("offset", static_cast<qint64>(track.offset()));
+    }
+    return json;
+}
+
+QStringList toStringList(const QJsonValue& value)
+{
+    QStringList list;
+    for (const QJsonValue& item : value.toArray()) {
+        list.append(item.toString());
+    }
+    return list;
+}
+
+// Library tags of the journal, over whatever the track holds
+void applyTrackJson(Fooyin::Track& track, const QJsonObject& json)
+{
+    track.setTitle(json.value("title").toString());
+    track.setArtists(toStringList(json.value("artists")));
+    track.setAlbum(json.value("album").toString());
+    track.setAlbumArtists(toStringList(json.value("albumArtists")));
+    track.setTrackNumber(json.value("trackNumber").toString());
+    track.setTrackTotal(json.value("trackTotal").toString());
+    track.setDiscNumber(json.value("discNumber").toString());
+    track.setDiscTotal(json.value("discTotal").toString());
+    track.setDate(json.value("date").toString());
+    track.setGenres(toStringList(json.value("genres")));
+
+    // CUE tracks are slices of the image file
+    if (json.contains("cue")) {
+        track.setCuePath(json.value("cue").toString());
+        track.setOffset(static_cast<uint64_t>(json.value("offset").toInteger()));
+        track.setDuration(static_cast<uint64_t>(json.value("duration").toInteger()));
+    }
+}
+
+Fooyin::Track trackFromJson(const QJsonObject& json)
+{
+    Fooyin::Track track{json.value("path").toString()};
+    track.setDuration(static_cast<uint64_t>(json.value("duration").toInteger()));
+    track.setFileSize(static_cast<uint64_t>(json.value("size").toInteger()));
+    track.setModifiedTime(static_cast<uint64_t>(json.value("modified").toInteger()));
+    applyTrackJson(track, json);
+    return track;
+}
+
+QByteArray line(const QJsonObject& json)
+{
+    return QJsonDocument{json}.toJson(QJsonDocument::Compact) + '\n';
+}
+
+// Whether the start of the file looks like the output format, so a file that was published
+// but never reached the disk (zeros after a power loss) isn't taken as done
+bool hasFormatHeader(const QString& path, const QString& format)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray header = file.read(4);
+    if (header.size() < 4) {
+        return false;
+    }
+
+    if (format == u"flac") {
+        return header.startsWith("fLaC");
+    }
+    if (format == u"opus" || format == u"ogg") {
+        return header.startsWith("OggS");
+    }
+    if (format == u"mp3") {
+        // An ID3v2 tag, or straight to the first frame
+        const auto sync = static_cast<uchar>(header.at(1));
+        return header.startsWith("ID3") || (static_cast<uchar>(header.at(0)) == 0xFF && (sync & 0xE0) == 0xE0);
+    }
+    return true;
+}
+
+// A single worker keeps the writes of a journal in order
+QThreadPool* journalThreadPool()
+{
+    static QThreadPool* pool = [] {
+        auto* journalPool = new QThreadPool();
+        journalPool->setMaxThreadCount(1);
+        return journalPool;
+    }();
+    return pool;
+}
+} // namespace
+
+// The open journal file, shared with the writes queued on the worker
+struct BatchJournal::File {
+    explicit File(QString filePath)
+        : path{std::move(filePath)}
+    { }
+
+    ~File()
+    {
+        close();
+    }
+
+    void close()
+    {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    // Appends data and syncs it; journaling stops at the first error
+    void append(const QByteArray& data)
+    {
+        if (fd < 0) {
+            return;
+        }
+
+        qsizetype written{0};
+        while (written < data.size()) {
+            const ssize_t count = ::write(fd, data.constData() + written, static_cast<size_t>(data.size() - written));
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                fail();
+                return;
+            }
+            written += count;
+        }
+
+#ifdef Q_OS_LINUX
+        const int synced = ::fdatasync(fd);
+#else
+        // No fdatasync() on macOS
+        const int synced = ::fsync(fd);
+#endif
+        if (synced != 0) {
+            fail();
+        }
+    }
+
+    void fail()
+    {
+        qWarning() << "Audio Converter - Cannot write the batch journal" << path << "-" << std::strerror(errno);
+        close();
+    }
+
+    const QString path;
+    int fd{-1};
+};
+
+BatchJournal::BatchJournal(QString path, QObject* parent)
+    : QObject{parent}
+    , m_path{std::move(path)}
+    , m_commitTimer{new QTimer(this)}
+{
+    m_commitTimer->setSingleShot(true);
+    m_commitTimer->setInterval(GroupCommitMs);
+    connect(m_commitTimer, &QTimer::timeout, this, &BatchJournal::commit);
+}
+
+BatchJournal::~BatchJournal()
+{
+    // The batch may go on in the next session, so nothing recorded is dropped
+    commit();
+    journalThreadPool()->waitForDone();
+}
+
+bool BatchJournal::acquire(const QObject* owner)
+{
+    if (m_owner && m_owner != owner) {
+        return false;
+    }
+    m_owner = owner;
+    return true;
+}
+
+bool BatchJournal::isHeld() const
+{
+    return !m_owner.isNull();
+}
+
+bool BatchJournal::isHeldBy(const QObject* owner) const
+{
+    return m_owner && m_owner == owner;
+}
+
+void BatchJournal::start(const Batch& batch, const QList<Source>& sources)
+{
+    m_pending.clear();
+    m_commitTimer->stop();
+    m_outputs.clear();
+
+    QJsonArray extraOutputs;
+    for (const Output& output : batch.extraOutputs) {
+        extraOutputs.append(QJsonObject{{"options", optionsToJson(output.options)}, {"output", output.folder}});
+    }
+
+    QByteArray data = line({{"journal", JournalVersion},
+                            {"started", QDateTime::currentMSecsSinceEpoch()},
+                            {"options", optionsToJson(batch.options)},
+                            {"output", batch.outputFolder},
+                            {"mirror", batch.mirror},
+                            {"mirrorRoot", batch.mirrorRoot},
+                            {"extraOutputs", extraOutputs}});
+    for (const Source& source : sources) {
+        m_outputs.insert(source.key, QStringList{source.outputPath} + source.extraOutputPaths);
+
+        QJsonObject json{{"key", source.key},
+                         {"state", stateName(source.state)},
+                         {"output", source.outputPath},
+                         {"track", trackToJson(source.track)}};
+        if (source.state == State::Done) {
+            json.insert("size", source.outputSize);
+        }
+        data += line(json);
+    }
+
+    m_file = std::make_shared<File>(m_path);
+    journalThreadPool()->start([file = m_file, data]() {
+        QDir{}.mkpath(QFileInfo{file->path}.absolutePath());
+        file->fd = ::open(QFile::encodeName(file->path).constData(),
+                          O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (file->fd < 0) {
+            file->fail();
+            return;
+        }
+        file->append(data);
+
+        // The new file has to survive a crash as well
+        const QByteArray directory = QFile::encodeName(QFileInfo{file->path}.absolutePath());
+        if (const int dirFd = ::open(directory.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); dirFd >= 0) {
+            ::fsync(dirFd);
+            ::close(dirFd);
+        }
+    });
+}
+
+void BatchJournal::record(const QString& key, State state)
+{
+    if (!m_file) {
+        return;
+    }
+
+    m_pending.append({key, state, state == State::Done ? m_outputs.value(key) : QStringList{}});
+    if (!m_commitTimer->isActive()) {
+        m_commitTimer->start();
+    }
+}
+
+void BatchJournal::commit()
+{
+    m_commitTimer->stop();
+    if (!m_file || m_pending.isEmpty()) {
+        return;
+    }
+
+    // Sizes are read on the worker, stat() is slow on network shares
+    journalThreadPool()->start([file = m_file, changes = std::exchange(m_pending, {})]() {
+        // Done must not get to the disk before the outputs do: one sync for the group
+        QStringList outputs;
+        for (const Change& change : changes) {
+            outputs += change.outputPaths;
+        }
+        if (!outputs.isEmpty()) {
+            syncOutputs(outputs);
+        }
+
+        QByteArray data;
+        for (const Change& change : changes) {
+            QJsonObject json{{"key", change.key}, {"state", stateName(change.state)}};
+            if (change.state == State::Done && !change.outputPaths.isEmpty()) {
+                json.insert("size", QFileInfo{change.outputPaths.constFirst()}.size());
+            }
+            data += line(json);
+        }
+        file->append(data);
+    });
+}
+
+void BatchJournal::remove()
+{
+    m_pending.clear();
+    m_commitTimer->stop();
+    m_outputs.clear();
+    m_owner.clear();
+
+    if (!m_file) {
+        return;
+    }
+
+    journalThreadPool()->start([file = std::exchange(m_file, {})]() {
+        file->close();
+        QFile::remove(file->path);
+    });
+}
+
+std::optional<BatchJournal::Interrupted> BatchJournal::read(const QString& path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    const QJsonObject header = QJsonDocument::fromJson(file.readLine()).object();
+    if (header.value("journal").toInt() != JournalVersion) {
+        qWarning() << "Audio Converter - Ignoring batch journal" << path << "from another version";
+        return {};
+    }
+
+    Interrupted batch;
+    batch.batch.options = optionsFromJson(header.value("options").toObject());
+    batch.batch.outputFolder = header.value("output").toString();
+    batch.batch.mirror = header.value("mirror").toBool();
+    batch.batch.mirrorRoot = header.value("mirrorRoot").toString();
+    const QJsonArray extraOutputs = header.value("extraOutputs").toArray();
+    for (const QJsonValue& output : extraOutputs) {
+        batch.batch.extraOutputs.append(
+            {optionsFromJson(output.toObject().value("options").toObject()), output.toObject().value("output").toString()});
+    }
+
+    QHash<QString, qsizetype> indexes;
+    while (!file.atEnd()) {
+        // A line cut off by a crash doesn't parse and is skipped
+        const QJsonObject json = QJsonDocument::fromJson(file.readLine()).object();
+        const QString key = json.value("key").toString();
+        if (key.isEmpty()) {
+            continue;
+        }
+
+        if (json.contains("track")) {
+            indexes.insert(key, batch.sources.size());
+            batch.sources.append({key, json.value("output").toString(),
+                                  trackFromJson(json.value("track").toObject()),
+                                  stateFromName(json.value("state").toString()), json.value("size").toInteger()});
+            continue;
+        }
+
+        if (const auto index = indexes.constFind(key); index != indexes.cend()) {
+            Source& source = batch.sources[index.value()];
+            source.state = stateFromName(json.value("state").toString());
+            source.outputSize = json.value("size").toInteger();
+        }
+    }
+
+    const bool unfinished = std::any_of(batch.sources.cbegin(), batch.sources.cend(),
+                                        [](const Source& source) { return source.state != State::Done; });
+    if (!unfinished) {
+        return {};
+    }
+    return batch;
+}
+
+void BatchJournal::prepareResume(Interrupted& batch, Fooyin::AudioLoader& loader)
+{
+    for (Source& source : batch.sources) {
+        if (source.state == State::Done) {
+            const QFileInfo output{source.outputPath};
+            if (output.exists() && output.size() == source.outputSize
+                && hasFormatHeader(source.outputPath, batch.batch.options.format)) {
+                continue;
+            }
+            qInfo() << "Audio Converter - Output" << source.outputPath << "is incomplete, converting it again";
+        }
+
+        source.state = State::Queued;
+
+        // Codec, bitrate, ReplayGain... for scheduling and passthrough, as in the library
+        const QJsonObject json = trackToJson(source.track);
+        Fooyin::Track track{source.track.filepath()};
+        if (loader.readTrackMetadata(track)) {
+            applyTrackJson(track, json);
+            source.track = track;
+        }
+    }
+}
+
+QString defaultBatchJournalPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/fooyin/converter/batch.journal";
+}
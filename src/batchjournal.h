@@ -0,0 +1,116 @@
+#pragma once
+
+#include "codecwrapper.h"
+
+#include <core/track.h>
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <optional>
+
+namespace Fooyin {
+class AudioLoader;
+}
+
+class QTimer;
+
+// Append-only record of a batch run, so a batch cut short by a crash or by quitting fooyin
+// can be resumed. One JSON object per line: a header with the options, every source with
+// its output, then one line per state change. State changes are group-committed: they are
+// collected for a moment and written with a single write() and fdatasync() on a worker
+// thread, so journaling costs one sync per interval however many jobs finish. A line torn
+// by a crash is ignored when reading.
+class BatchJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class State
+    {
+        Queued,
+        Running,
+        Done,
+        Failed,
+    };
+
+    // A further format every source is converted to, next to the main one
+    struct Output {
+        ConversionOptions options;
+        QString folder; // As entered in the converter
+    };
+
+    struct Batch {
+        ConversionOptions options;
+        QString outputFolder; // As entered in the converter
+        bool mirror{false};
+        QString mirrorRoot; // Folder mirrored below outputFolder, so resumed outputs keep their paths
+        QList<Output> extraOutputs;
+    };
+
+    struct Source {
+        QString key; // Source path, with "#<offset>" appended for CUE tracks
+        QString outputPath; // Of the main format; the outputs of a source are published together
+        Fooyin::Track track;
+        State state{State::Queued};
+        qint64 outputSize{0}; // Recorded once done
+        QStringList extraOutputPaths; // Of the additional formats; not stored, only synced before done
+    };
+
+    struct Interrupted {
+        Batch batch;
+        QList<Source> sources;
+    };
+
+    explicit BatchJournal(QString path, QObject* parent = nullptr);
+    // Writes what is pending and waits for it
+    ~BatchJournal() override;
+
+    // There is one journal, so one batch at a time: a batch claims it before it starts.
+    // False while the batch of another owner holds it.
+    bool acquire(const QObject* owner);
+    [[nodiscard]] bool isHeld() const;
+    [[nodiscard]] bool isHeldBy(const QObject* owner) const;
+
+    // Starts a new journal for batch, replacing the previous one
+    void start(const Batch& batch, const QList<Source>& sources);
+    // Done also records the size of the output. The outputs are synced to disk before the line
+    // is written, so a done source survives a power loss with its files.
+    void record(const QString& key, State state);
+    // Batch finished or canceled: drops the journal once pending writes are done and releases it
+    void remove();
+
+    // The batch left in the journal at path, if it didn't finish. Blocks on I/O.
+    static std::optional<Interrupted> read(const QString& path);
+
+    // Checks the outputs of done sources (recorded size and a header of the output format)
+    // and reads the metadata of the others from their files again, keeping the library
+    // tags of the journal. Outputs that fail the check are queued again. Blocks on I/O.
+    static void prepareResume(Interrupted& batch, Fooyin::AudioLoader& loader);
+
+private:
+    struct File;
+
+    struct Change {
+        QString key;
+        State state;
+        QStringList outputPaths; // Set for done: synced first, the size of the main one is recorded
+    };
+
+    void commit();
+
+    const QString m_path;
+    QPointer<const QObject> m_owner; // Released if the owner goes away
+    std::shared_ptr<File> m_file;
+    QHash<QString, QStringList> m_outputs; // key -> output paths, main format first
+    QList<Change> m_pending;
+    QTimer* m_commitTimer;
+};
+
+// Where the converter keeps the journal of the current batch
+QString defaultBatchJournalPath();
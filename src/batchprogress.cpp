@@ -0,0 +1,89 @@
+#include "batchprogress.h"
+
+namespace {
+// Finished jobs the remaining time is estimated from
+constexpr size_t RateWindowJobs = 8;
+// Below this the overall rate is mostly process startup
+constexpr qint64 MinElapsedMs = 2000;
+} // namespace
+
+void BatchProgress::start()
+{
+    m_jobs.clear();
+    m_totalDuration = 0;
+    m_doneDuration = 0;
+    m_doneBytes = 0;
+    m_finished.clear();
+    // The start of the batch is the first point of the rate window
+    m_finished.emplace_back(0, 0);
+    m_clock.start();
+}
+
+void BatchProgress::addJob(int jobId, uint64_t durationMs, uint64_t bytes)
+{
+    m_jobs.insert(jobId, {durationMs, bytes, 0});
+    m_totalDuration += durationMs;
+}
+
+void BatchProgress::setProgress(int jobId, int percent)
+{
+    if (auto it = m_jobs.find(jobId); it != m_jobs.end()) {
+        it->percent = qBound(0, percent, 100);
+    }
+}
+
+void BatchProgress::finishJob(int jobId)
+{
+    const auto it = m_jobs.constFind(jobId);
+    if (it == m_jobs.cend()) {
+        return;
+    }
+
+    m_doneDuration += it->duration;
+    m_doneBytes += it->bytes;
+    m_jobs.erase(it);
+
+    m_finished.emplace_back(m_clock.elapsed(), m_doneDuration);
+    if (m_finished.size() > RateWindowJobs + 1) {
+        m_finished.pop_front();
+    }
+}
+
+BatchProgress::Status BatchProgress::status() const
+{
+    Status status;
+
+    // Running jobs count by their own percent
+    uint64_t doneDuration = m_doneDuration;
+    uint64_t doneBytes = m_doneBytes;
+    for (const Job& job : m_jobs) {
+        doneDuration += job.duration * static_cast<uint64_t>(job.percent) / 100;
+        doneBytes += job.bytes * static_cast<uint64_t>(job.percent) / 100;
+    }
+
+    if (m_totalDuration > 0) {
+        status.fraction = static_cast<double>(doneDuration) / static_cast<double>(m_totalDuration);
+    }
+
+    const qint64 elapsed = m_clock.isValid() ? m_clock.elapsed() : 0;
+    if (elapsed < MinElapsedMs || doneDuration == 0) {
+        return status;
+    }
+
+    status.realtime = static_cast<double>(doneDuration) / static_cast<double>(elapsed);
+    status.bytesPerSecond = static_cast<double>(doneBytes) * 1000.0 / static_cast<double>(elapsed);
+
+    // Audio per ms over the last finished jobs, over the whole batch until one has finished
+    double rate = static_cast<double>(doneDuration) / static_cast<double>(elapsed);
+    if (m_finished.size() > 1) {
+        const auto& [firstTime, firstDone] = m_finished.front();
+        const auto& [lastTime, lastDone] = m_finished.back();
+        if (lastTime > firstTime && lastDone > firstDone) {
+            rate = static_cast<double>(lastDone - firstDone) / static_cast<double>(lastTime - firstTime);
+        }
+    }
+
+    const uint64_t remaining = m_totalDuration > doneDuration ? m_totalDuration - doneDuration : 0;
+    status.remainingMs = static_cast<qint64>(static_cast<double>(remaining) / rate);
+    return status;
+}
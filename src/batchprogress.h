@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+// Overall progress of a batch whose jobs run several at a time. Jobs count by the length
+// of their audio, so a 20 minute track weighs as much as five 4 minute ones. Throughput
+// is measured over the whole batch; the remaining time uses the rate over the last few
+// finished jobs, which follows changes (e.g. from FLAC to a slow Opus album) without
+// jumping around on every progress update.
+class BatchProgress
+{
+public:
+    struct Status {
+        double fraction{0.0};       // Of the audio in the batch, 0 to 1
+        double realtime{0.0};       // Seconds of audio converted per second, 0 = not known yet
+        double bytesPerSecond{0.0}; // Input read
+        qint64 remainingMs{-1};     // -1 = not known yet
+    };
+
+    // Forgets all jobs and restarts the clock
+    void start();
+
+    void addJob(int jobId, uint64_t durationMs, uint64_t bytes);
+    void setProgress(int jobId, int percent);
+    void finishJob(int jobId);
+
+    bool hasDuration() const { return m_totalDuration > 0; }
+    Status status() const;
+
+private:
+    struct Job {
+        uint64_t duration{0};
+        uint64_t bytes{0};
+        int percent{0};
+    };
+
+    QElapsedTimer m_clock;
+    QHash<int, Job> m_jobs; // Queued and running
+    uint64_t m_totalDuration{0};
+    uint64_t m_doneDuration{0};
+    uint64_t m_doneBytes{0};
+    // Elapsed time and audio done when each of the last jobs finished, oldest first
+    std::deque<std::pair<qint64, uint64_t>> m_finished;
+};
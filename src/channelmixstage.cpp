@@ -0,0 +1,132 @@
+#include "channelmixstage.h"
+#include "dspkernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// -3 dB, the usual weight of centre and surround channels in a stereo downmix
+constexpr float Minus3dB = 0.70710678F;
+constexpr float Minus6dB = 0.5F;
+
+enum Side : int
+{
+    Left,
+    Right,
+    Both,
+    Neither,
+};
+
+struct Placement {
+    Side side;
+    float gain;
+};
+
+// Where each input channel lands in a stereo mix, for the common layouts
+Placement stereoPlacement(int inputChannels, int channel)
+{
+    static constexpr Placement Mono[] = {{Both, 1.0F}};
+    static constexpr Placement Centre[] = {{Left, 1.0F}, {Right, 1.0F}, {Both, Minus3dB}};
+    static constexpr Placement Quad[] = {{Left, 1.0F}, {Right, 1.0F}, {Left, Minus3dB}, {Right, Minus3dB}};
+    static constexpr Placement Surround50[]
+        = {{Left, 1.0F}, {Right, 1.0F}, {Both, Minus3dB}, {Left, Minus3dB}, {Right, Minus3dB}};
+    // LFE is left out, as in ITU-R BS.775
+    static constexpr Placement Surround51[]
+        = {{Left, 1.0F}, {Right, 1.0F}, {Both, Minus3dB}, {Neither, 0.0F}, {Left, Minus3dB}, {Right, Minus3dB}};
+    static constexpr Placement Surround61[] = {
+        {Left, 1.0F}, {Right, 1.0F}, {Both, Minus3dB}, {Neither, 0.0F}, {Both, Minus6dB}, {Left, Minus3dB}, {Right, Minus3dB},
+    };
+    static constexpr Placement Surround71[] = {
+        {Left, 1.0F},     {Right, 1.0F},     {Both, Minus3dB}, {Neither, 0.0F},
+        {Left, Minus3dB}, {Right, Minus3dB}, {Left, Minus3dB}, {Right, Minus3dB},
+    };
+
+    switch (inputChannels) {
+        case 1:
+            return Mono[channel];
+        case 3:
+            return Centre[channel];
+        case 4:
+            return Quad[channel];
+        case 5:
+            return Surround50[channel];
+        case 6:
+            return Surround51[channel];
+        case 7:
+            return Surround61[channel];
+        case 8:
+            return Surround71[channel];
+        default:
+            break;
+    }
+
+    // Unknown layouts alternate left/right; only the front pair is at full level
+    return {channel % 2 == 0 ? Left : Right, channel < 2 ? 1.0F : Minus3dB};
+}
+} // namespace
+
+ChannelMixStage::ChannelMixStage(const PcmFormat& inputFormat, int outputChannels)
+    : m_inputFormat{inputFormat}
+    , m_outputChannels{outputChannels}
+    , m_matrix{mixMatrix(inputFormat.channels, outputChannels)}
+{ }
+
+PcmFormat ChannelMixStage::outputFormat() const
+{
+    PcmFormat format{m_inputFormat};
+    format.channels = m_outputChannels;
+    return format;
+}
+
+std::vector<float> ChannelMixStage::mixMatrix(int inputChannels, int outputChannels)
+{
+    std::vector<float> stereo(static_cast<size_t>(2 * inputChannels), 0.0F);
+
+    for (int channel = 0; channel < inputChannels; ++channel) {
+        const Placement placement = stereoPlacement(inputChannels, channel);
+
+        if (placement.side == Left || placement.side == Both) {
+            stereo[channel] = placement.gain;
+        }
+        if (placement.side == Right || placement.side == Both) {
+            stereo[inputChannels + channel] = placement.gain;
+        }
+    }
+
+    std::vector<float> matrix;
+    if (outputChannels == 1) {
+        // Mono is the average of the stereo mix
+        matrix.resize(static_cast<size_t>(inputChannels));
+        for (int channel = 0; channel < inputChannels; ++channel) {
+            matrix[channel] = 0.5F * (stereo[channel] + stereo[inputChannels + channel]);
+        }
+    } else {
+        matrix = std::move(stereo);
+    }
+
+    // Scale down so a full-scale signal on every input cannot clip
+    float loudestRow{0.0F};
+    for (int row = 0; row < outputChannels; ++row) {
+        float sum{0.0F};
+        for (int channel = 0; channel < inputChannels; ++channel) {
+            sum += std::fabs(matrix[row * inputChannels + channel]);
+        }
+        loudestRow = std::max(loudestRow, sum);
+    }
+    if (loudestRow > 1.0F) {
+        for (float& coefficient : matrix) {
+            coefficient /= loudestRow;
+        }
+    }
+
+    return matrix;
+}
+
+const float* ChannelMixStage::process(const float* input, int64_t frames, int64_t& outputFrames)
+{
+    m_output.resize(static_cast<size_t>(frames * m_outputChannels));
+    Dsp::mixChannels(input, m_output.data(), frames, m_inputFormat.channels, m_outputChannels, m_matrix.data());
+
+    outputFrames = frames;
+    return m_output.data();
+}
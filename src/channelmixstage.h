@@ -0,0 +1,25 @@
+#pragma once
+
+#include "pcmstage.h"
+
+#include <vector>
+
+// Matrix mix of interleaved channels, e.g. 5.1/7.1 down to stereo or mono.
+// Assumes the WAVE/FFmpeg channel order (FL FR FC LFE BL BR SL SR).
+class ChannelMixStage : public PcmStage
+{
+public:
+    ChannelMixStage(const PcmFormat& inputFormat, int outputChannels);
+
+    PcmFormat outputFormat() const override;
+    const float* process(const float* input, int64_t frames, int64_t& outputFrames) override;
+
+    // outputChannels rows of inputChannels coefficients, scaled so no output can clip
+    static std::vector<float> mixMatrix(int inputChannels, int outputChannels);
+
+private:
+    PcmFormat m_inputFormat;
+    int m_outputChannels;
+    std::vector<float> m_matrix;
+    std::vector<float> m_output;
+};
@@ -0,0 +1,180 @@
+#include "codeccapabilities.h"
+#include "contenthash.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <optional>
+
+namespace {
+constexpr quint32 CacheMagic = 0x46594343; // "FYCC"
+constexpr quint32 CacheVersion = 1;
+// An encoder that hangs mustn't hold up startup for long
+constexpr int ProbeTimeoutMs = 5000;
+
+struct Entry {
+    qint64 size{0};
+    qint64 modified{0};
+    quint64 probeHash{0};
+    CodecCapabilities capabilities;
+};
+
+quint64 probeHash(const CodecProbe& probe)
+{
+    QByteArray data;
+    QDataStream stream{&data, QIODevice::WriteOnly};
+    stream << probe.versionPattern << probe.options;
+    return hashBytes(data.constData(), static_cast<size_t>(data.size()));
+}
+
+// Output of the executable on stdout and stderr, empty if it didn't exit in time
+std::optional<QString> run(const QString& execPath, const QString& argument)
+{
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+    process.start(execPath, {argument});
+    if (!process.waitForFinished(ProbeTimeoutMs) || process.exitStatus() != QProcess::NormalExit) {
+        process.kill();
+        process.waitForFinished();
+        return {};
+    }
+    return QString::fromLocal8Bit(process.readAll());
+}
+
+// Runs the executable; empty if it failed, so it is tried again next time
+std::optional<CodecCapabilities> probeExecutable(const QString& execPath, const CodecProbe& probe)
+{
+    const std::optional<QString> versionOutput = run(execPath, "--version");
+    if (!versionOutput) {
+        return {};
+    }
+
+    CodecCapabilities capabilities;
+    const QRegularExpressionMatch match = QRegularExpression{probe.versionPattern}.match(*versionOutput);
+    capabilities.version = match.hasMatch() ? match.captured(1) : QStringLiteral("Unknown");
+
+    if (probe.options.isEmpty()) {
+        return capabilities;
+    }
+
+    const std::optional<QString> help = run(execPath, "--help");
+    if (!help) {
+        return {};
+    }
+    for (const QString& option : probe.options) {
+        // Whole options only, --threads shouldn't match --threads-per-frame
+        const QRegularExpression listed{"(^|[\\s,])" + QRegularExpression::escape(option) + "($|[\\s,=\\[])"};
+        if (listed.match(*help).hasMatch()) {
+            capabilities.options.append(option);
+        }
+    }
+    return capabilities;
+}
+
+class CapabilityCache
+{
+public:
+    CapabilityCache()
+        : m_path{QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                 + "/fooyin/converter/codecs"}
+    {
+        load();
+    }
+
+    CodecCapabilities get(const QString& execPath, const CodecProbe& probe)
+    {
+        const QFileInfo info{execPath};
+        Entry entry{info.size(), info.lastModified().toMSecsSinceEpoch(), probeHash(probe), {}};
+
+        {
+            const QMutexLocker locker{&m_lock};
+            if (const auto it = m_entries.constFind(execPath); it != m_entries.cend() && it->size == entry.size
+                && it->modified == entry.modified && it->probeHash == entry.probeHash) {
+                return it->capabilities;
+            }
+        }
+
+        // Not under the lock, other encoders can be looked up meanwhile
+        const std::optional<CodecCapabilities> capabilities = probeExecutable(execPath, probe);
+        if (!capabilities) {
+            qWarning() << "Audio Converter - Cannot query" << execPath;
+            return {QStringLiteral("Unknown"), {}};
+        }
+        entry.capabilities = *capabilities;
+
+        const QMutexLocker locker{&m_lock};
+        m_entries.insert(execPath, entry);
+        save();
+        return entry.capabilities;
+    }
+
+private:
+    void load()
+    {
+        QFile file{m_path};
+        if (!file.open(QIODevice::ReadOnly)) {
+            return;
+        }
+
+        QDataStream stream{&file};
+        quint32 magic{0};
+        quint32 version{0};
+        stream >> magic >> version;
+        if (magic != CacheMagic || version != CacheVersion) {
+            return;
+        }
+
+        qint64 count{0};
+        stream >> count;
+        for (qint64 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+            QString path;
+            Entry entry;
+            stream >> path >> entry.size >> entry.modified >> entry.probeHash >> entry.capabilities.version
+                >> entry.capabilities.options;
+            m_entries.insert(path, entry);
+        }
+
+        if (stream.status() != QDataStream::Ok) {
+            // Everything is probed again
+            m_entries.clear();
+        }
+    }
+
+    // Called with m_lock held; the file is tiny and only written when an encoder changed
+    void save()
+    {
+        QByteArray data;
+        QDataStream stream{&data, QIODevice::WriteOnly};
+        stream << CacheMagic << CacheVersion << static_cast<qint64>(m_entries.size());
+        for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+            stream << it.key() << it->size << it->modified << it->probeHash << it->capabilities.version
+                   << it->capabilities.options;
+        }
+
+        QDir{}.mkpath(QFileInfo{m_path}.absolutePath());
+        QSaveFile file{m_path};
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+            qWarning() << "Audio Converter - Cannot write the codec capability cache:" << file.errorString();
+        }
+    }
+
+    const QString m_path;
+    QMutex m_lock;
+    QHash<QString, Entry> m_entries;
+};
+} // namespace
+
+CodecCapabilities codecCapabilities(const QString& execPath, const CodecProbe& probe)
+{
+    static CapabilityCache cache;
+    return cache.get(execPath, probe);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+// How to find out what an encoder executable supports
+struct CodecProbe {
+    QString versionPattern; // Matched against the --version output, the version is the first capture
+    QStringList options;    // Options to look for in the --help output
+};
+
+// What an encoder executable supports
+struct CodecCapabilities {
+    QString version;     // "Unknown" if the --version output didn't match
+    QStringList options; // The probed options listed by --help
+
+    bool supports(const QString& option) const { return options.contains(option); }
+};
+
+// Capabilities of the executable at execPath. Running an encoder takes a fork/exec and
+// its startup, so results are remembered on disk by path, size and timestamp; only new or
+// updated executables (or a changed probe) are run again. Thread-safe, blocks while probing.
+CodecCapabilities codecCapabilities(const QString& execPath, const CodecProbe& probe);
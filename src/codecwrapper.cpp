@@ -1,7 +1,170 @@
 #include "codecwrapper.h"
+#include "dspkernels.h"
+#include "pcmstream.h"
+#include "tracing.h"
 #include <QStandardPaths>
+#include <QTimer>
+#include <QtEndian>
+
+namespace {
+// Bytes queued on stdin before we stop pulling from the decoder
+constexpr qint64 MaxPendingBytes = 256 * 1024;
+// How often the peak memory of an encoder process is read
+constexpr int UsageSampleMs = 250;
+// Nominal bitrates of Vorbis quality levels 0-10
+constexpr int VorbisQualityKbps[] = {64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 500};
+// Average bitrates of LAME's VBR presets V0-V9
+constexpr int LameVbrKbps[] = {245, 225, 190, 175, 165, 130, 115, 100, 85, 65};
+constexpr int FallbackKbps = 320;
+} // namespace
+
+int nominalBitrate(const ConversionOptions& options)
+{
+    if (options.format == u"flac") {
+        return 0;
+    }
+
+    const int quality = options.quality;
+    if (options.format == u"ogg" && quality >= 0 && quality <= 10) {
+        return VorbisQualityKbps[quality];
+    }
+    if (options.format == u"mp3" && quality >= 0 && quality <= 9) {
+        return LameVbrKbps[quality];
+    }
+    return options.bitrate > 0 ? options.bitrate : FallbackKbps;
+}
 
 QString CodecWrapper::findExecutable(const QString& name) const
 {
     return QStandardPaths::findExecutable(name);
 }
+
+void CodecWrapper::measureProcess()
+{
+    m_usage = {};
+
+    auto* sampler = new QTimer(m_process);
+    sampler->setInterval(UsageSampleMs);
+    connect(sampler, &QTimer::timeout, this, [this]() { m_meter.sample(); });
+
+    // Until the encoder runs; the process is started right after this
+    Trace::begin("spawn", m_traceTrack);
+    connect(m_process, &QProcess::started, this, [this, sampler]() {
+        Trace::end("spawn", m_traceTrack);
+        m_meter.start(m_process->processId());
+        sampler->start();
+    });
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            Trace::end("spawn", m_traceTrack);
+        }
+    });
+
+    // Directly after the reap, before another child can be reaped
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this, sampler]() {
+        sampler->stop();
+        m_usage = m_meter.finish();
+    });
+}
+
+int CodecWrapper::streamBitsPerSample(const PcmFormat& format)
+{
+    return format.bitsPerSample > 16 ? 24 : 16;
+}
+
+void CodecWrapper::attachStream(std::shared_ptr<PcmStream> stream, int bitsPerSample, std::vector<int> channelOrder)
+{
+    m_stream = std::move(stream);
+    m_streamBits = bitsPerSample;
+    m_channelOrder = std::move(channelOrder);
+    m_framesFed = 0;
+    m_streamPercent = -1;
+    m_streamError.clear();
+    m_feedBuffer.resize(static_cast<size_t>(PcmStream::BlockFrames * m_stream->format().channels));
+
+    // The decoder thread wakes us up when new data arrives
+    m_stream->setReadyCallback([this]() {
+        QMetaObject::invokeMethod(this, &CodecWrapper::feedStream, Qt::QueuedConnection);
+    });
+
+    connect(m_process, &QProcess::started, this, &CodecWrapper::feedStream);
+    connect(m_process, &QProcess::bytesWritten, this, &CodecWrapper::feedStream);
+}
+
+void CodecWrapper::detachStream()
+{
+    if (!m_stream) {
+        return;
+    }
+
+    m_stream->setReadyCallback({});
+    m_stream->abort();
+    m_stream.reset();
+}
+
+void CodecWrapper::feedStream()
+{
+    if (!m_stream || !m_process || m_process->state() != QProcess::Running) {
+        return;
+    }
+
+    const PcmFormat format = m_stream->format();
+    const int bytesPerSample = m_streamBits / 8;
+
+    // Keep only a little data in flight, so a slow encoder throttles the decoder
+    while (m_stream && m_process->bytesToWrite() < MaxPendingBytes) {
+        const int64_t frames = m_stream->tryRead(m_feedBuffer.data(), PcmStream::BlockFrames);
+        if (frames == PcmStream::WouldBlock) {
+            return;
+        }
+
+        if (frames < 0) {
+            m_streamError = m_stream->errorString();
+            detachStream();
+            m_process->kill();
+            return;
+        }
+
+        if (frames == 0) {
+            // End of input, the encoder finishes once it sees EOF
+            detachStream();
+            m_process->closeWriteChannel();
+            return;
+        }
+
+        if (!m_channelOrder.empty()) {
+            reorderChannels(m_feedBuffer.data(), frames, m_channelOrder);
+        }
+
+        const auto samples = static_cast<size_t>(frames * format.channels);
+        m_feedBytes.resize(static_cast<qsizetype>(samples) * bytesPerSample);
+
+        if (m_streamBits == 16) {
+            auto* out = reinterpret_cast<int16_t*>(m_feedBytes.data());
+            Dsp::floatToInt16(m_feedBuffer.data(), out, samples);
+            qToLittleEndian<int16_t>(out, static_cast<qsizetype>(samples), out);
+        } else {
+            // Packed 24-bit little endian
+            m_feedSamples.resize(samples);
+            Dsp::floatToInt32(m_feedBuffer.data(), m_feedSamples.data(), samples, m_streamBits);
+
+            auto* out = reinterpret_cast<uchar*>(m_feedBytes.data());
+            for (const int32_t value : m_feedSamples) {
+                *out++ = static_cast<uchar>(value);
+                *out++ = static_cast<uchar>(value >> 8);
+                *out++ = static_cast<uchar>(value >> 16);
+            }
+        }
+
+        m_process->write(m_feedBytes);
+
+        m_framesFed += static_cast<uint64_t>(frames);
+        if (const uint64_t total = format.sampleRate > 0 ? m_stream->totalFrames() : 0) {
+            const int percent = static_cast<int>(qMin<uint64_t>(100, m_framesFed * 100 / total));
+            if (percent != m_streamPercent) {
+                m_streamPercent = percent;
+                emit progressChanged(percent);
+            }
+        }
+    }
+}
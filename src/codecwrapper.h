@@ -1,10 +1,22 @@
 #pragma once
 
+#include "jobstats.h"
+#include "pcmsource.h"
+
+#include <core/track.h>
+
+#include <QByteArray>
 #include <QObject>
 #include <QProcess>
 #include <QString>
 #include <QStringList>
 
+#include <memory>
+#include <utility>
+#include <vector>
+
+class PcmStream;
+
 struct ConversionOptions {
     QString format;        // "mp3", "flac", "opus", "ogg"
     int bitrate{320};     // kbps (for lossy formats)
@@ -12,8 +24,15 @@ struct ConversionOptions {
     int sampleRate{0};    // 0 = preserve original
     int channels{0};      // 0 = preserve original
     int compressionLevel{8}; // For FLAC (0-8)
+    int bitDepth{0};      // For FLAC, 0 = preserve original
+    bool replayGain{false}; // Measure loudness while encoding and write ReplayGain tags
+    bool passthrough{true}; // Copy sources that already match the target instead of re-encoding
 };
 
+// Typical bitrate in kbps of lossy options: that of the VBR quality level (Vorbis q0-q10,
+// LAME V0-V9) or the set bitrate, 320 if neither is known. 0 for lossless formats.
+int nominalBitrate(const ConversionOptions& options);
+
 class CodecWrapper : public QObject
 {
     Q_OBJECT
@@ -41,14 +60,79 @@ public:
         const ConversionOptions& options
     ) = 0;
 
+    // Async conversion of PCM decoded by a DecodeStage instead of reading inputPath directly
+    virtual void convertStreamAsync(
+        std::shared_ptr<PcmStream> stream,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) = 0;
+
     virtual void cancel() = 0;
 
+    // Whether this wrapper can read the given input file and honour the options
+    virtual bool canConvert(const QString& inputPath, const ConversionOptions& options) const
+    {
+        Q_UNUSED(inputPath);
+        Q_UNUSED(options);
+        return true;
+    }
+
+    // Whether this wrapper can encode a decoded stream of the given format with the options
+    virtual bool canConvertStream(const PcmFormat& format, const ConversionOptions& options) const
+    {
+        Q_UNUSED(format);
+        Q_UNUSED(options);
+        return true;
+    }
+
+    // Library metadata of the input, used by encoders that write tags themselves
+    void setSourceTrack(const Fooyin::Track& track) { m_sourceTrack = track; }
+
+    // CPU and memory of the last conversion, set before conversionFinished is emitted
+    EncoderUsage usage() const { return m_usage; }
+
+    // Trace track the encoder's own spans (process spawn) are recorded on
+    void setTraceTrack(uint64_t track) { m_traceTrack = track; }
+
 signals:
     void progressChanged(int percent);
     void conversionFinished(bool success, const QString& error);
 
 protected:
     QString findExecutable(const QString& name) const;
+
+    // Measures the resources of m_process into m_usage and traces its spawn. Call right after
+    // creating it, before connecting to finished, so m_usage is set when the wrapper reports.
+    void measureProcess();
+
+    // Feeds stream into m_process's stdin as raw signed little-endian PCM, with the channels
+    // put into channelOrder if given (see reorderChannels()).
+    // Call before starting the process; writes only as fast as the encoder reads.
+    void attachStream(std::shared_ptr<PcmStream> stream, int bitsPerSample, std::vector<int> channelOrder = {});
+    // Stops feeding and aborts the stream so the decoder thread exits
+    void detachStream();
+    // Returns and clears the decode error that ended the last streamed conversion, if any
+    QString takeStreamError() { return std::exchange(m_streamError, {}); }
+    // Raw sample width for stdin streams: 16 bit, or 24 bit for high resolution sources
+    static int streamBitsPerSample(const PcmFormat& format);
+
     QProcess* m_process{nullptr};
     QString m_outputPath; // Track output path for cancellation
+    Fooyin::Track m_sourceTrack;
+    EncoderUsage m_usage;
+
+private:
+    void feedStream();
+
+    ChildUsageMeter m_meter;
+    uint64_t m_traceTrack{0};
+    std::shared_ptr<PcmStream> m_stream;
+    int m_streamBits{16};
+    std::vector<int> m_channelOrder;
+    uint64_t m_framesFed{0};
+    int m_streamPercent{-1};
+    std::vector<float> m_feedBuffer;
+    std::vector<int32_t> m_feedSamples;
+    QByteArray m_feedBytes;
+    QString m_streamError;
 };
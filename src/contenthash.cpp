@@ -0,0 +1,591 @@
+#include "contenthash.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#ifdef HAVE_LIBXXHASH
+#include <xxhash.h>
+#endif
+
+namespace {
+constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t Prime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+constexpr qint64 FileChunkBytes = 4 * 1024 * 1024;
+
+uint64_t rotl(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian loads, unaligned
+uint64_t read64(const unsigned char* p)
+{
+    uint64_t value{0};
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+uint32_t read32(const unsigned char* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16)
+         | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t round(uint64_t acc, uint64_t input)
+{
+    acc += input * Prime2;
+    acc = rotl(acc, 31);
+    return acc * Prime1;
+}
+
+uint64_t mergeRound(uint64_t acc, uint64_t value)
+{
+    acc ^= round(0, value);
+    return acc * Prime1 + Prime4;
+}
+} // namespace
+
+ContentHasher::ContentHasher(uint64_t seed)
+    : m_lanes{seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1}
+    , m_seed{seed}
+    , m_buffer{}
+{ }
+
+void ContentHasher::add(const void* data, size_t size)
+{
+    const auto* p = static_cast<const unsigned char*>(data);
+    m_total += size;
+
+    // Top up a partial stripe first
+    if (m_buffered > 0) {
+        const size_t take = std::min(size, sizeof(m_buffer) - m_buffered);
+        std::memcpy(m_buffer + m_buffered, p, take);
+        m_buffered += take;
+        p += take;
+        size -= take;
+        if (m_buffered < sizeof(m_buffer)) {
+            return;
+        }
+        for (int lane = 0; lane < 4; ++lane) {
+            m_lanes[lane] = round(m_lanes[lane], read64(m_buffer + lane * 8));
+        }
+        m_buffered = 0;
+    }
+
+    while (size >= 32) {
+        for (int lane = 0; lane < 4; ++lane) {
+            m_lanes[lane] = round(m_lanes[lane], read64(p + lane * 8));
+        }
+        p += 32;
+        size -= 32;
+    }
+
+    std::memcpy(m_buffer, p, size);
+    m_buffered = size;
+}
+
+uint64_t ContentHasher::finish() const
+{
+    uint64_t hash{0};
+    if (m_total >= 32) {
+        hash = rotl(m_lanes[0], 1) + rotl(m_lanes[1], 7) + rotl(m_lanes[2], 12) + rotl(m_lanes[3], 18);
+        for (const uint64_t lane : m_lanes) {
+            hash = mergeRound(hash, lane);
+        }
+    } else {
+        hash = m_seed + Prime5;
+    }
+    hash += m_total;
+
+    const unsigned char* p = m_buffer;
+    size_t left = m_buffered;
+    while (left >= 8) {
+        hash ^= round(0, read64(p));
+        hash = rotl(hash, 27) * Prime1 + Prime4;
+        p += 8;
+        left -= 8;
+    }
+    if (left >= 4) {
+        hash ^= static_cast<uint64_t>(read32(p)) * Prime1;
+        hash = rotl(hash, 23) * Prime2 + Prime3;
+        p += 4;
+        left -= 4;
+    }
+    while (left > 0) {
+        hash ^= (*p) * Prime5;
+        hash = rotl(hash, 11) * Prime1;
+        ++p;
+        --left;
+    }
+
+    hash ^= hash >> 33;
+    hash *= Prime2;
+    hash ^= hash >> 29;
+    hash *= Prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+    ContentHasher hasher{seed};
+    hasher.add(data, size);
+    return hasher.finish();
+}
+
+uint64_t hashFile(const QString& path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    ContentHasher hasher;
+    const auto buffer = std::make_unique<char[]>(FileChunkBytes);
+    while (true) {
+        const qint64 got = file.read(buffer.get(), FileChunkBytes);
+        if (got < 0) {
+            return 0;
+        }
+        if (got == 0) {
+            break;
+        }
+        hasher.add(buffer.get(), static_cast<size_t>(got));
+    }
+    return hasher.finish();
+}
+
+namespace {
+// Hash of the audio fingerprint; XXH3 is several times faster than XXH64 where the CPU has
+// SIMD, so it's used whenever the library is there
+class PayloadHasher
+{
+public:
+#ifdef HAVE_LIBXXHASH
+    PayloadHasher()
+        : m_state{XXH3_createState()}
+    {
+        XXH3_64bits_reset(m_state);
+    }
+    ~PayloadHasher()
+    {
+        XXH3_freeState(m_state);
+    }
+
+    void reset()
+    {
+        XXH3_64bits_reset(m_state);
+    }
+    void add(const void* data, size_t size)
+    {
+        XXH3_64bits_update(m_state, data, size);
+    }
+    uint64_t finish() const
+    {
+        return XXH3_64bits_digest(m_state);
+    }
+#else
+    PayloadHasher() = default;
+
+    void reset()
+    {
+        m_hasher = ContentHasher{};
+    }
+    void add(const void* data, size_t size)
+    {
+        m_hasher.add(data, size);
+    }
+    uint64_t finish() const
+    {
+        return m_hasher.finish();
+    }
+#endif
+
+    PayloadHasher(const PayloadHasher&) = delete;
+    PayloadHasher& operator=(const PayloadHasher&) = delete;
+
+private:
+#ifdef HAVE_LIBXXHASH
+    XXH3_state_t* m_state;
+#else
+    ContentHasher m_hasher;
+#endif
+};
+
+// The file being fingerprinted and the parts of it hashed so far
+class Payload
+{
+public:
+    explicit Payload(const QString& path)
+        : m_file{path}
+        , m_buffer{std::make_unique<char[]>(FileChunkBytes)}
+    { }
+
+    bool open()
+    {
+        return m_file.open(QIODevice::ReadOnly);
+    }
+    qint64 size() const
+    {
+        return m_file.size();
+    }
+    char* buffer()
+    {
+        return m_buffer.get();
+    }
+
+    bool read(qint64 offset, void* data, qint64 size)
+    {
+        return m_file.seek(offset) && m_file.read(static_cast<char*>(data), size) == size;
+    }
+
+    // Hashes the bytes from begin up to end
+    bool hash(qint64 begin, qint64 end)
+    {
+        if (!m_file.seek(begin)) {
+            return false;
+        }
+        while (begin < end) {
+            const qint64 got = m_file.read(m_buffer.get(), std::min(FileChunkBytes, end - begin));
+            if (got <= 0) {
+                return false;
+            }
+            m_hasher.add(m_buffer.get(), static_cast<size_t>(got));
+            begin += got;
+        }
+        return true;
+    }
+
+    void add(const void* data, size_t size)
+    {
+        m_hasher.add(data, size);
+    }
+    void reset()
+    {
+        m_hasher.reset();
+    }
+    uint64_t finish() const
+    {
+        return m_hasher.finish();
+    }
+
+private:
+    QFile m_file;
+    std::unique_ptr<char[]> m_buffer;
+    PayloadHasher m_hasher;
+};
+
+uint32_t readBE32(const unsigned char* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+         | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+// ID3v2 sizes use 7 bits per byte
+qint64 syncsafe(const unsigned char* p)
+{
+    return (static_cast<qint64>(p[0] & 0x7F) << 21) | (static_cast<qint64>(p[1] & 0x7F) << 14)
+         | (static_cast<qint64>(p[2] & 0x7F) << 7) | static_cast<qint64>(p[3] & 0x7F);
+}
+
+// Size of an ID3v2 tag at the start of the file, 0 if there is none
+qint64 id3v2Size(const unsigned char* header)
+{
+    if (std::memcmp(header, "ID3", 3) != 0) {
+        return 0;
+    }
+    const bool hasFooter = header[5] & 0x10;
+    return 10 + syncsafe(header + 6) + (hasFooter ? 10 : 0);
+}
+
+// Where the tags appended to the file start: ID3v1, APEv2, Lyrics3v2 and ID3v2 footers,
+// in any order
+qint64 trailingTagsStart(Payload& payload, qint64 begin, qint64 end)
+{
+    unsigned char footer[32];
+
+    while (end > begin) {
+        if (end - begin >= 128 && payload.read(end - 128, footer, 3) && std::memcmp(footer, "TAG", 3) == 0) {
+            end -= 128;
+            continue;
+        }
+        if (end - begin >= 32 && payload.read(end - 32, footer, 32) && std::memcmp(footer, "APETAGEX", 8) == 0) {
+            const bool hasHeader = read32(footer + 20) & 0x80000000U;
+            const qint64 size = static_cast<qint64>(read32(footer + 12)) + (hasHeader ? 32 : 0);
+            if (size > end - begin) {
+                break;
+            }
+            end -= size;
+            continue;
+        }
+        if (end - begin >= 15 && payload.read(end - 15, footer, 15) && std::memcmp(footer + 6, "LYRICS200", 9) == 0) {
+            bool ok{false};
+            const qint64 size = QByteArray(reinterpret_cast<const char*>(footer), 6).toLongLong(&ok) + 15;
+            if (!ok || size > end - begin) {
+                break;
+            }
+            end -= size;
+            continue;
+        }
+        if (end - begin >= 10 && payload.read(end - 10, footer, 10) && std::memcmp(footer, "3DI", 3) == 0) {
+            const qint64 size = syncsafe(footer + 6) + 20;
+            if (size > end - begin) {
+                break;
+            }
+            end -= size;
+            continue;
+        }
+        break;
+    }
+
+    return end;
+}
+
+// STREAMINFO and the frames; every other metadata block is tags, pictures or padding
+bool hashFlac(Payload& payload, qint64 begin, qint64 end)
+{
+    qint64 pos = begin + 4;
+    bool last{false};
+
+    while (!last) {
+        unsigned char header[4];
+        if (pos + 4 > end || !payload.read(pos, header, 4)) {
+            return false;
+        }
+        last = header[0] & 0x80;
+        const int type = header[0] & 0x7F;
+        const qint64 length = (static_cast<qint64>(header[1]) << 16) | (header[2] << 8) | header[3];
+        pos += 4;
+
+        if (type == 0 && !payload.hash(pos, pos + length)) {
+            return false;
+        }
+        pos += length;
+    }
+
+    return pos <= end && payload.hash(pos, end);
+}
+
+// Header packets of the Ogg stream starting with packet, -1 for codecs that aren't known
+int oggHeaderPackets(const unsigned char* packet, qint64 size)
+{
+    if (size >= 7 && packet[0] == 0x01 && std::memcmp(packet + 1, "vorbis", 6) == 0) {
+        return 3;
+    }
+    if (size >= 8 && std::memcmp(packet, "OpusHead", 8) == 0) {
+        return 2;
+    }
+    if (size >= 9 && packet[0] == 0x7F && std::memcmp(packet + 1, "FLAC", 4) == 0) {
+        // Mapping header, then the number of metadata packets (0 = unknown)
+        const int count = (packet[7] << 8) | packet[8];
+        return count > 0 ? 1 + count : -1;
+    }
+    return -1;
+}
+
+// The packets of the first stream except its comment and setup headers, and the packets of
+// any other stream. Page headers are left out as well: their sequence numbers and checksums
+// change when the comment header grows by a page.
+bool hashOgg(Payload& payload, qint64 begin, qint64 end)
+{
+    auto* body = reinterpret_cast<unsigned char*>(payload.buffer());
+    uint32_t firstSerial{0};
+    int headerPackets{-1};
+    int packet{0};
+
+    qint64 pos = begin;
+    while (pos < end) {
+        unsigned char header[27 + 255];
+        if (pos + 27 > end || !payload.read(pos, header, 27) || std::memcmp(header, "OggS", 4) != 0) {
+            return false;
+        }
+        const int segments = header[26];
+        if (!payload.read(pos + 27, header + 27, segments)) {
+            return false;
+        }
+
+        qint64 bodySize{0};
+        for (int segment = 0; segment < segments; ++segment) {
+            bodySize += header[27 + segment];
+        }
+        const qint64 bodyStart = pos + 27 + segments;
+        if (bodyStart + bodySize > end) {
+            return false;
+        }
+
+        const uint32_t serial = read32(header + 14);
+        if (pos == begin) {
+            firstSerial = serial;
+        }
+
+        if (serial != firstSerial) {
+            if (!payload.hash(bodyStart, bodyStart + bodySize)) {
+                return false;
+            }
+        } else {
+            // At most 255 * 255 bytes, well within the buffer
+            if (!payload.read(bodyStart, body, bodySize)) {
+                return false;
+            }
+            if (headerPackets < 0) {
+                headerPackets = oggHeaderPackets(body, bodySize);
+                if (headerPackets < 0) {
+                    return false;
+                }
+            }
+
+            qint64 offset{0};
+            for (int segment = 0; segment < segments; ++segment) {
+                const int length = header[27 + segment];
+                if (packet == 0 || packet >= headerPackets) {
+                    payload.add(body + offset, static_cast<size_t>(length));
+                }
+                offset += length;
+                // A segment shorter than 255 bytes ends the packet
+                if (length < 255) {
+                    ++packet;
+                }
+            }
+        }
+
+        pos = bodyStart + bodySize;
+    }
+
+    return true;
+}
+
+// The contents of the "mdat" boxes; tags live in "moov", whose size changes with them
+bool hashMp4(Payload& payload, qint64 end)
+{
+    bool found{false};
+
+    qint64 pos{0};
+    while (pos + 8 <= end) {
+        unsigned char header[16];
+        if (!payload.read(pos, header, 8)) {
+            return false;
+        }
+
+        qint64 size = readBE32(header);
+        qint64 headerSize{8};
+        if (size == 1) {
+            if (pos + 16 > end || !payload.read(pos, header, 16)) {
+                return false;
+            }
+            size = (static_cast<qint64>(readBE32(header + 8)) << 32) | readBE32(header + 12);
+            headerSize = 16;
+        } else if (size == 0) {
+            size = end - pos;
+        }
+        if (size < headerSize || size > end - pos) {
+            return false;
+        }
+
+        if (std::memcmp(header + 4, "mdat", 4) == 0) {
+            if (!payload.hash(pos + headerSize, pos + size)) {
+                return false;
+            }
+            found = true;
+        }
+        pos += size;
+    }
+
+    return found;
+}
+
+// The "fmt " and "data" chunks; LIST/INFO, "id3 " and the like are tags
+bool hashWav(Payload& payload, qint64 end)
+{
+    bool found{false};
+
+    qint64 pos{12};
+    while (pos + 8 <= end) {
+        unsigned char header[8];
+        if (!payload.read(pos, header, 8)) {
+            return false;
+        }
+        const qint64 size = read32(header + 4);
+        if (size > end - pos - 8) {
+            return false;
+        }
+
+        if (std::memcmp(header, "fmt ", 4) == 0 || std::memcmp(header, "data", 4) == 0) {
+            if (!payload.hash(pos + 8, pos + 8 + size)) {
+                return false;
+            }
+            found = std::memcmp(header, "data", 4) == 0 || found;
+        }
+        // Chunks are padded to an even size
+        pos += 8 + size + (size & 1);
+    }
+
+    return found;
+}
+} // namespace
+
+uint64_t audioFingerprint(const QString& path)
+{
+    Payload payload{path};
+    if (!payload.open()) {
+        return 0;
+    }
+
+    const qint64 size = payload.size();
+    unsigned char magic[12]{};
+    if (!payload.read(0, magic, std::min<qint64>(size, sizeof(magic)))) {
+        return 0;
+    }
+
+    // Some FLAC and most MP3 files start with an ID3v2 tag
+    qint64 begin = size >= 10 ? id3v2Size(magic) : 0;
+    if (begin > 0) {
+        std::memset(magic, 0, sizeof(magic));
+        if (begin >= size || !payload.read(begin, magic, std::min<qint64>(size - begin, sizeof(magic)))) {
+            begin = 0;
+        }
+    }
+
+    bool parsed{false};
+    if (std::memcmp(magic, "fLaC", 4) == 0) {
+        parsed = hashFlac(payload, begin, trailingTagsStart(payload, begin, size));
+    } else if (std::memcmp(magic, "OggS", 4) == 0) {
+        parsed = hashOgg(payload, begin, size);
+    } else if (begin == 0 && std::memcmp(magic + 4, "ftyp", 4) == 0) {
+        parsed = hashMp4(payload, size);
+    } else if (begin == 0 && std::memcmp(magic, "RIFF", 4) == 0 && std::memcmp(magic + 8, "WAVE", 4) == 0) {
+        parsed = hashWav(payload, size);
+    } else {
+        // MPEG audio and other raw streams: everything between the tags
+        parsed = payload.hash(begin, trailingTagsStart(payload, begin, size));
+    }
+
+    if (!parsed) {
+        // Unknown layout or damaged: the whole file it is
+        payload.reset();
+        if (!payload.hash(0, size)) {
+            return 0;
+        }
+    }
+
+    // 0 is reserved for "not computed"
+    const uint64_t hash = payload.finish();
+    return hash != 0 ? hash : 1;
+}
+
+uint32_t audioFingerprintKind()
+{
+#ifdef HAVE_LIBXXHASH
+    return 2;
+#else
+    return 1;
+#endif
+}
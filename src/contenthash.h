@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit non-cryptographic hash (XXH64), fast enough to run at disk speed.
+// Used to recognise unchanged files and for the keys of the mirror manifest.
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Incremental form of hashBytes() for data that arrives in pieces
+class ContentHasher
+{
+public:
+    explicit ContentHasher(uint64_t seed = 0);
+
+    void add(const void* data, size_t size);
+    uint64_t finish() const;
+
+private:
+    uint64_t m_lanes[4];
+    uint64_t m_seed;
+    uint64_t m_total{0};
+    unsigned char m_buffer[32];
+    size_t m_buffered{0};
+};
+
+// Hash of the whole file at path, 0 if it can't be read
+uint64_t hashFile(const QString& path);
+
+// Hash of the audio payload of the file at path, 0 if it can't be read. Tags and
+// embedded pictures are left out (FLAC metadata blocks, ID3v1/v2, APEv2, Ogg comment
+// headers, everything outside "mdat" in MP4 and outside "fmt "/"data" in WAV), so
+// retagging a file doesn't change it. Other formats are hashed whole.
+uint64_t audioFingerprint(const QString& path);
+// Identifies the hash function audioFingerprint() uses in this build (XXH3 with
+// libxxhash, XXH64 otherwise); fingerprints of different kinds can't be compared.
+uint32_t audioFingerprintKind();
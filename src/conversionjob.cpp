@@ -0,0 +1,36 @@
+#include "conversionjob.h"
+
+#include <QFileInfo>
+
+uint64_t ConversionJob::estimatedWork() const
+{
+    // Each track of an image encodes only its own slice
+    if (isImage()) {
+        uint64_t work{0};
+        for (const ConversionTarget& target : targets) {
+            work += target.track.duration();
+        }
+        return work;
+    }
+
+    // Decoding is shared, so the encoders dominate
+    return audioDuration() * static_cast<uint64_t>(qMax<qsizetype>(1, targets.size()));
+}
+
+uint64_t ConversionJob::audioDuration() const
+{
+    // Prefer the real duration from the library
+    if (track.duration() > 0) {
+        return track.duration();
+    }
+
+    // Otherwise estimate it from the file size and bitrate (bits / kbps = ms)
+    uint64_t fileSize = track.fileSize();
+    if (fileSize == 0) {
+        fileSize = static_cast<uint64_t>(QFileInfo(inputPath).size());
+    }
+
+    // Assume a typical lossless bitrate when nothing else is known
+    const int bitrate = track.bitrate() > 0 ? track.bitrate() : 1000;
+    return fileSize * 8 / static_cast<uint64_t>(bitrate);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "codecwrapper.h"
+
+#include <core/track.h>
+
+#include <QList>
+#include <QString>
+
+#include <optional>
+
+// Order in which queued jobs are handed to free encoder slots
+enum class SchedulingPolicy : int
+{
+    Fifo = 0,         // Selection order
+    LongestFirst = 1, // Longest processing time first, keeps cores busy until the end of a batch
+};
+
+// Slice of the input a target encodes, in CD frames (1/75 s) as used by CUE sheets
+struct CueRange {
+    int64_t start{0};
+    int64_t end{-1}; // -1 = to the end of the input
+};
+
+// One output of a job. All targets of a job share a single decode of the input.
+struct ConversionTarget {
+    QString outputPath;
+    ConversionOptions options;
+
+    // Set for the tracks of a CUE image: the slice to cut and the track to tag it as
+    std::optional<CueRange> range;
+    Fooyin::Track track;
+};
+
+// A single queued or running conversion owned by ConversionManager
+struct ConversionJob {
+    int id{-1};
+    QString inputPath;
+    QList<ConversionTarget> targets;
+
+    // Library metadata of the source (duration, size, codec...), may be sparse
+    // for files that were picked from disk rather than from the library
+    Fooyin::Track track;
+
+    // Jobs with the same album id share ReplayGain album gain and peak, 0 = no album
+    int albumId{0};
+
+    // audioFingerprint() of the input for the encode cache, 0 = not computed
+    uint64_t sourceHash{0};
+
+    // True for a CUE image split into one target per track
+    bool isImage() const { return !targets.isEmpty() && targets.constFirst().range.has_value(); }
+
+    // Estimated amount of work in milliseconds of audio, summed over all targets
+    uint64_t estimatedWork() const;
+    // Length of the input in milliseconds, estimated from its size if unknown
+    uint64_t audioDuration() const;
+};
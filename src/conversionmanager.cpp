@@ -1,52 +1,284 @@
 #include "conversionmanager.h"
+#include "cuesheet.h"
+#include "decodersource.h"
+#include "decodestage.h"
+#include "encodecache.h"
+#include "filecopy.h"
+#include "inputprefetcher.h"
+#include "localstaging.h"
+#include "loudnessmeter.h"
+#include "loudnessstage.h"
+#include "passthroughcopier.h"
+#include "pcmstage.h"
+#include "pcmstream.h"
+#include "stagedoutput.h"
+#include "tracing.h"
 #include "flacwrapper.h"
 #include "lamewrapper.h"
 #include "opuswrapper.h"
 #include "oggwrapper.h"
+#ifdef HAVE_LIBFLAC
+#include "libflacencoder.h"
+#endif
+#ifdef HAVE_LIBMP3LAME
+#include "liblameencoder.h"
+#endif
+#ifdef HAVE_LIBOPUSENC
+#include "libopusencoder.h"
+#endif
+#ifdef HAVE_LIBVORBISENC
+#include "libvorbisencoder.h"
+#endif
+#include <core/engine/audioinput.h>
+#include <core/engine/audioloader.h>
+
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QMimeDatabase>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+// How far the decoder of a CUE image may run ahead of the track encoders
+constexpr uint64_t ImageReadAheadBytes = 256 * 1024 * 1024;
+// Queued inputs the prefetcher looks at, its window rarely covers more
+constexpr int PrefetchMaxInputs = 64;
+
+// The INDEX 01 entries of the CUE sheet that describe the image file
+QList<CueIndex> imageCueIndexes(const Fooyin::Track& track)
+{
+    if (!track.hasCue()) {
+        return {};
+    }
+
+    const QList<CueIndex> indexes = readCueSheet(track.cuePath());
+    const QString imageName = QFileInfo(track.filepath()).fileName();
+
+    QList<CueIndex> image;
+    QStringList files;
+    for (const CueIndex& index : indexes) {
+        if (QFileInfo(index.file).fileName().compare(imageName, Qt::CaseInsensitive) == 0) {
+            image.append(index);
+        }
+        if (!files.contains(index.file)) {
+            files.append(index.file);
+        }
+    }
+
+    // Renamed images still match a single-file sheet
+    if (image.isEmpty() && files.size() == 1) {
+        return indexes;
+    }
+    return image;
+}
+
+// Replaces the tags of an existing output with the library metadata of source and copies the
+// front cover embedded in it. With keepReplayGain, the values measured on the output stay.
+bool retagOutput(Fooyin::AudioLoader& loader, const Fooyin::Track& source, const QString& outputPath,
+                 bool keepReplayGain)
+{
+    Fooyin::Track output{source};
+    output.setFilePath(outputPath);
+    // Outputs of CUE tracks are files of their own
+    output.setCuePath({});
+    output.setOffset(0);
+
+    if (keepReplayGain) {
+        Fooyin::Track current{outputPath};
+        if (!loader.readTrackMetadata(current)) {
+            return false;
+        }
+        if (current.hasTrackGain()) {
+            output.setRGTrackGain(current.rgTrackGain());
+            output.setRGTrackPeak(current.rgTrackPeak());
+        }
+        if (current.hasAlbumGain()) {
+            output.setRGAlbumGain(current.rgAlbumGain());
+            output.setRGAlbumPeak(current.rgAlbumPeak());
+        }
+    }
+
+    // Tags are written in place; an output linked to the encode cache gets its own copy first
+    if (QString error; !unshareFile(outputPath, error)) {
+        qWarning() << "Audio Converter - Cannot unshare" << outputPath << "-" << error;
+        return false;
+    }
+
+    if (!loader.writeTrackMetadata(output, {})) {
+        return false;
+    }
+
+    const QByteArray cover = loader.readTrackCover(source, Fooyin::Track::Cover::Front);
+    if (cover.isEmpty()) {
+        return true;
+    }
+    const Fooyin::TrackCovers covers{
+        {Fooyin::Track::Cover::Front, {QMimeDatabase{}.mimeTypeForData(cover).name(), cover}}};
+    return loader.writeTrackCover(output, covers, {});
+}
+
+// Tags of a staged output, before it is published. Its path has no extension, so the reader
+// is chosen by the final name and works on the staged file.
+bool readStagedTags(Fooyin::AudioLoader& loader, const StagedOutput& output, Fooyin::Track& track)
+{
+    auto reader = loader.readerForFile(output.finalPath());
+    QFile file{output.path()};
+    if (!reader || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    Fooyin::AudioSource source;
+    source.filepath = output.finalPath();
+    source.device = &file;
+    return reader->readTrack(source, track);
+}
+
+bool writeStagedTags(Fooyin::AudioLoader& loader, const StagedOutput& output, const Fooyin::Track& track)
+{
+    auto reader = loader.readerForFile(output.finalPath());
+    QFile file{output.path()};
+    if (!reader || !file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+
+    Fooyin::AudioSource source;
+    source.filepath = output.finalPath();
+    source.device = &file;
+    return reader->writeTrack(source, track, {});
+}
+
+// One output per track, all in the same format
+QList<QList<ConversionTarget>> singleTargets(const QStringList& outputPaths, const ConversionOptions& options)
+{
+    QList<QList<ConversionTarget>> targets;
+    for (const QString& outputPath : outputPaths) {
+        targets.append(QList<ConversionTarget>{{outputPath, options}});
+    }
+    return targets;
+}
+
+bool measuresReplayGain(const QList<QList<ConversionTarget>>& targets)
+{
+    return std::any_of(targets.cbegin(), targets.cend(), [](const QList<ConversionTarget>& outputs) {
+        return std::any_of(outputs.cbegin(), outputs.cend(),
+                           [](const ConversionTarget& target) { return target.options.replayGain; });
+    });
+}
+
+int64_t msToCueFrames(uint64_t ms)
+{
+    return static_cast<int64_t>((ms * 75 + 500) / 1000);
+}
+
+// Whether target can be a copy of the input. ReplayGain is copied along, so it must
+// already be there, and album gain can't mix copied and measured tracks.
+bool canPassThrough(const ConversionJob& job, const ConversionTarget& target)
+{
+    if (target.range || !PassthroughCopier::matches(job.track, target.options)) {
+        return false;
+    }
+    return !target.options.replayGain || (job.albumId == 0 && job.track.hasTrackGain());
+}
+
+// Album gain depends on the rest of the album, so those outputs can't be reused elsewhere
+bool cacheable(const ConversionJob& job, const ConversionTarget& target)
+{
+    return !canPassThrough(job, target) && (!target.options.replayGain || job.albumId == 0);
+}
+
+// Rough size of an output, reserved against the staging quota until the real size is known
+qint64 estimatedOutputBytes(const ConversionJob& job, const ConversionTarget& target)
+{
+    const uint64_t duration = target.range ? target.track.duration() : job.audioDuration();
+    // Lossless output is about as large as a lossless source, assume a typical FLAC otherwise.
+    // VBR settings have no bitrate, their quality level's is taken.
+    const int kbps = target.options.format == "flac" ? qMax(job.track.bitrate(), 1000) : nominalBitrate(target.options);
+    return static_cast<qint64>(duration * static_cast<uint64_t>(kbps) / 8);
+}
+} // namespace
 
 ConversionManager::ConversionManager(QObject* parent)
     : QObject(parent)
+    , m_prefetcher{new InputPrefetcher(this)}
+{
+    // Searching PATH and asking encoders for their version can take a while on a cold
+    // start, so it runs off the GUI thread
+    auto* watcher = new QFutureWatcher<QMap<QString, CodecInfo>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher]() {
+        watcher->deleteLater();
+        setCodecs(watcher->result());
+    });
+    watcher->setFuture(QtConcurrent::run(&ConversionManager::probeCodecs));
+
+    m_copyCancelled = std::make_shared<std::atomic<bool>>(false);
+    setMaxConcurrentJobs(0);
+}
+
+ConversionManager::~ConversionManager()
+{
+    cancel();
+    // A canceled copy stops after its current chunk
+    copyOutThreadPool()->waitForDone();
+    encodeCacheThreadPool()->waitForDone();
+    if (m_cache) {
+        m_cache->save();
+    }
+}
+
+QMap<QString, ConversionManager::CodecInfo> ConversionManager::probeCodecs()
 {
-    // Initialize codec wrappers
-    m_flacWrapper = new FlacWrapper(this);
-    m_lameWrapper = new LameWrapper(this);
-    m_opusWrapper = new OpusWrapper(this);
-    m_oggWrapper = new OggWrapper(this);
+    QMap<QString, CodecInfo> codecs;
+    const QStringList formats{"flac", "mp3", "opus", "ogg"};
+    for (const QString& format : formats) {
+        const std::unique_ptr<CodecWrapper> codec{createCodecWrapper(format, nullptr)};
+        CodecInfo& info = codecs[format];
+        info.executableName = codec->executableName();
+        info.available = codec->isAvailable();
+        info.version = codec->version();
+    }
+    return codecs;
+}
 
-    // Build codec map
-    m_codecMap["flac"] = m_flacWrapper;
-    m_codecMap["mp3"] = m_lameWrapper;
-    m_codecMap["opus"] = m_opusWrapper;
-    m_codecMap["ogg"] = m_oggWrapper;
+void ConversionManager::setCodecs(const QMap<QString, CodecInfo>& codecs)
+{
+    m_codecs = codecs;
+    m_codecsProbed = true;
 
-    // Log available codecs
     qInfo() << "Audio Converter - Available codecs:";
-    for (auto it = m_codecMap.constBegin(); it != m_codecMap.constEnd(); ++it) {
-        if (it.value()->isAvailable()) {
-            qInfo() << "  " << it.key() << "-" << it.value()->version();
+    for (auto it = m_codecs.constBegin(); it != m_codecs.constEnd(); ++it) {
+        if (it->available) {
+            qInfo() << "  " << it.key() << "-" << it->version;
         } else {
             qInfo() << "  " << it.key() << "- Not available";
         }
     }
-}
 
-ConversionManager::~ConversionManager()
-{
-    cancel();
+    emit codecsReady();
+
+    // Jobs queued meanwhile
+    requestSchedule();
 }
 
 bool ConversionManager::isCodecAvailable(const QString& format) const
 {
-    CodecWrapper* codec = m_codecMap.value(format.toLower(), nullptr);
-    return codec && codec->isAvailable();
+    return m_codecs.value(format.toLower()).available;
 }
 
 QStringList ConversionManager::availableCodecs() const
 {
     QStringList available;
-    for (auto it = m_codecMap.constBegin(); it != m_codecMap.constEnd(); ++it) {
-        if (it.value()->isAvailable()) {
+    for (auto it = m_codecs.constBegin(); it != m_codecs.constEnd(); ++it) {
+        if (it->available) {
             available << it.key();
         }
     }
@@ -55,16 +287,16 @@ QStringList ConversionManager::availableCodecs() const
 
 QString ConversionManager::codecVersion(const QString& format) const
 {
-    CodecWrapper* codec = m_codecMap.value(format.toLower(), nullptr);
-    if (codec) {
-        return codec->version();
+    const auto it = m_codecs.constFind(format.toLower());
+    if (it != m_codecs.cend()) {
+        return it->version;
     }
     return "Unknown";
 }
 
-CodecWrapper* ConversionManager::getCodecWrapper(const QString& format)
+void ConversionManager::setAudioLoader(std::shared_ptr<Fooyin::AudioLoader> audioLoader)
 {
-    return m_codecMap.value(format.toLower(), nullptr);
+    m_audioLoader = std::move(audioLoader);
 }
 
 bool ConversionManager::convert(
@@ -72,7 +304,7 @@ bool ConversionManager::convert(
     const QString& outputPath,
     const ConversionOptions& options)
 {
-    CodecWrapper* codec = getCodecWrapper(options.format);
+    const std::unique_ptr<CodecWrapper> codec{createCodecWrapper(options.format, nullptr)};
     if (!codec) {
         qWarning() << "No codec found for format:" << options.format;
         return false;
@@ -86,60 +318,1189 @@ bool ConversionManager::convert(
     return codec->convert(inputPath, outputPath, options);
 }
 
-void ConversionManager::convertAsync(
+int ConversionManager::convertAsync(
     const QString& inputPath,
     const QString& outputPath,
     const ConversionOptions& options)
 {
-    if (m_converting) {
-        qWarning() << "Conversion already in progress";
-        emit conversionFinished(false, "Another conversion is already in progress");
+    return convertAsync(Fooyin::Track{inputPath}, outputPath, options);
+}
+
+int ConversionManager::convertAsync(
+    const Fooyin::Track& track,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    return convertAsync(track, QList<ConversionTarget>{{outputPath, options}});
+}
+
+int ConversionManager::convertAsync(const Fooyin::Track& track, const QList<ConversionTarget>& targets)
+{
+    return queueJob(track, targets, 0);
+}
+
+QList<int> ConversionManager::convertAlbumAsync(
+    const Fooyin::TrackList& tracks,
+    const QStringList& outputPaths,
+    const ConversionOptions& options)
+{
+    return convertAlbumAsync(tracks, singleTargets(outputPaths, options));
+}
+
+QList<int> ConversionManager::convertAlbumAsync(const Fooyin::TrackList& tracks,
+                                                const QList<QList<ConversionTarget>>& targets)
+{
+    const int count = static_cast<int>(std::min<qsizetype>(tracks.size(), targets.size()));
+
+    int albumId{0};
+    if (count > 0 && measuresReplayGain(targets)) {
+        albumId = m_nextAlbumId++;
+        m_albums[albumId].remaining = count;
+    }
+
+    QList<int> jobIds;
+    for (int i = 0; i < count; ++i) {
+        jobIds.append(queueJob(tracks.at(i), targets.at(i), albumId));
+    }
+    return jobIds;
+}
+
+int ConversionManager::convertImageAsync(
+    const Fooyin::TrackList& tracks,
+    const QStringList& outputPaths,
+    const ConversionOptions& options)
+{
+    return convertImageAsync(tracks, singleTargets(outputPaths, options));
+}
+
+int ConversionManager::convertImageAsync(const Fooyin::TrackList& tracks,
+                                         const QList<QList<ConversionTarget>>& outputs)
+{
+    const auto count = std::min<qsizetype>(tracks.size(), outputs.size());
+    if (count == 0) {
+        return -1;
+    }
+
+    // Slices are cut in order while decoding, so targets are sorted by position in the image
+    std::vector<std::pair<Fooyin::Track, QList<ConversionTarget>>> ordered;
+    for (qsizetype i = 0; i < count; ++i) {
+        ordered.emplace_back(tracks.at(i), outputs.at(i));
+    }
+    std::stable_sort(ordered.begin(), ordered.end(),
+                     [](const auto& a, const auto& b) { return a.first.offset() < b.first.offset(); });
+
+    // CUE positions are exact to the sample, fooyin's offsets only to the millisecond
+    const QList<CueIndex> indexes = imageCueIndexes(ordered.front().first);
+
+    QList<ConversionTarget> targets;
+    for (const auto& [track, trackOutputs] : ordered) {
+        CueRange range{msToCueFrames(track.offset()), msToCueFrames(track.offset() + track.duration())};
+
+        const int number = track.trackNumber().toInt();
+        const auto index = std::find_if(indexes.cbegin(), indexes.cend(),
+                                        [number](const CueIndex& entry) { return entry.track == number; });
+        if (index != indexes.cend()) {
+            range.start = index->start;
+            // Gaps belong to the end of the previous track, the last track runs to the end of the file
+            range.end = std::next(index) != indexes.cend() ? std::next(index)->start : -1;
+        }
+
+        // Every format of a track cuts the same slice
+        for (const ConversionTarget& output : trackOutputs) {
+            targets.append({output.outputPath, output.options, range, track});
+        }
+    }
+
+    // The whole file is decoded, from the first sample
+    Fooyin::Track image{ordered.front().first};
+    image.setOffset(0);
+    image.setDuration(0);
+
+    // An image selected in full is an album of its own
+    int albumId{0};
+    if (measuresReplayGain(outputs) && (indexes.isEmpty() || indexes.size() == count)) {
+        albumId = m_nextAlbumId++;
+        m_albums[albumId].remaining = 1;
+    }
+
+    return queueJob(image, targets, albumId);
+}
+
+void ConversionManager::retagAsync(const Fooyin::TrackList& tracks, const QStringList& outputPaths,
+                                   const ConversionOptions& options)
+{
+    if (tracks.empty()) {
         return;
     }
 
-    CodecWrapper* codec = getCodecWrapper(options.format);
-    if (!codec) {
-        qWarning() << "No codec found for format:" << options.format;
-        emit conversionFinished(false, "Unsupported format: " + options.format);
+    if (!m_audioLoader) {
+        QMetaObject::invokeMethod(
+            this,
+            [this, outputPaths] {
+                for (const QString& outputPath : outputPaths) {
+                    emit outputRetagged(outputPath, false);
+                }
+            },
+            Qt::QueuedConnection);
         return;
     }
 
-    if (!codec->isAvailable()) {
-        qWarning() << "Codec not available:" << options.format;
-        emit conversionFinished(false, "Codec not installed: " + codec->executableName());
+    // Destination I/O, so it shares the copy-out worker: one file at a time per destination
+    copyOutThreadPool()->start([this, tracks, outputPaths, keepReplayGain = options.replayGain,
+                                loader = m_audioLoader, cancelled = m_copyCancelled] {
+        for (size_t i = 0; i < tracks.size(); ++i) {
+            if (cancelled->load()) {
+                // Reported as failed, so a converter waiting for them still finishes its batch
+                QMetaObject::invokeMethod(
+                    this,
+                    [this, skipped = outputPaths.mid(static_cast<qsizetype>(i))] {
+                        for (const QString& outputPath : skipped) {
+                            emit outputRetagged(outputPath, false);
+                        }
+                    },
+                    Qt::QueuedConnection);
+                return;
+            }
+
+            const QString outputPath = outputPaths.at(static_cast<qsizetype>(i));
+            const Trace::Scope scope{"retag"};
+            const bool success = retagOutput(*loader, tracks.at(i), outputPath, keepReplayGain);
+            if (!success) {
+                qWarning() << "Audio Converter - Cannot retag" << outputPath;
+            }
+
+            QMetaObject::invokeMethod(
+                this,
+                [this, outputPath, success] { emit outputRetagged(outputPath, success); },
+                Qt::QueuedConnection);
+        }
+    });
+}
+
+int ConversionManager::queueJob(const Fooyin::Track& track, const QList<ConversionTarget>& targets, int albumId)
+{
+    ConversionJob job;
+    job.id = m_nextJobId++;
+    job.inputPath = track.filepath();
+    job.targets = targets;
+    job.track = track;
+    job.albumId = albumId;
+
+    const bool wasIdle = !isConverting();
+    if (usesEncodeCache(job)) {
+        hashSource(job);
+    } else {
+        enqueue(job);
+    }
+
+    if (wasIdle) {
+        m_jobStats.clear();
+        m_prefetcher->reset();
+        if (m_cache) {
+            m_cache->resetStats();
+        }
+        emit conversionStarted();
+    }
+
+    // Defer starting so a whole batch queued in one go is ordered before any job takes a slot
+    requestSchedule();
+    return job.id;
+}
+
+bool ConversionManager::usesEncodeCache(const ConversionJob& job) const
+{
+    return m_cache && std::any_of(job.targets.cbegin(), job.targets.cend(), [&job](const ConversionTarget& target) {
+               return cacheable(job, target);
+           });
+}
+
+void ConversionManager::hashSource(const ConversionJob& job)
+{
+    ++m_hashingJobs;
+
+    // The job is queued once its source is hashed; reading it here also warms the page cache for the decoder
+    encodeCacheThreadPool()->start([this, job, cache = m_cache, cancelled = m_copyCancelled] {
+        const uint64_t hash = cancelled->load() ? 0 : cache->sourceHash(job.inputPath);
+        QMetaObject::invokeMethod(
+            this,
+            [this, job, hash, cancelled]() mutable {
+                if (cancelled->load()) {
+                    emit jobFinished(job.id, false, "Conversion canceled");
+                    return;
+                }
+                --m_hashingJobs;
+                job.sourceHash = hash;
+                enqueue(job);
+                requestSchedule();
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+uint64_t ConversionManager::cacheKey(const ConversionJob& job, const ConversionTarget& target)
+{
+    if (!m_cache || job.sourceHash == 0 || !cacheable(job, target)) {
+        return 0;
+    }
+
+    const auto codec = m_codecs.constFind(target.options.format.toLower());
+    const QString encoder = codec != m_codecs.cend() ? codec->executableName + " " + codec->version : QString{};
+    return EncodeCache::key(job.sourceHash, target, target.range ? target.track : job.track, encoder);
+}
+
+void ConversionManager::storeInCache(const ActiveJob& active)
+{
+    if (!m_cache) {
+        return;
+    }
+
+    // Once published, so entries carry their ReplayGain tags
+    for (const ActiveTarget& running : active.targets) {
+        if (running.succeeded && running.cacheKey != 0 && running.cachedPath.isEmpty()) {
+            encodeCacheThreadPool()->start(
+                [cache = m_cache, key = running.cacheKey, outputPath = running.target.outputPath] {
+                    cache->insert(key, outputPath);
+                });
+        }
+    }
+}
+
+void ConversionManager::setEncodeCache(const QString& directory, qint64 maxBytes)
+{
+    const QString cacheDirectory = directory.isEmpty() ? defaultEncodeCacheDirectory() : directory;
+
+    if (maxBytes > 0 && m_cache && m_cache->directory() == cacheDirectory) {
+        m_cache->setMaxBytes(maxBytes);
+        return;
+    }
+
+    // Saved on the cache worker, after whatever it is still storing
+    if (m_cache) {
+        encodeCacheThreadPool()->start([cache = m_cache] { cache->save(); });
+    }
+    m_cache = maxBytes > 0 ? std::make_shared<EncodeCache>(cacheDirectory, maxBytes) : nullptr;
+}
+
+void ConversionManager::enqueue(const ConversionJob& job)
+{
+    if (m_policy == SchedulingPolicy::Fifo) {
+        m_pendingJobs.append(job);
+        return;
+    }
+
+    // Keep the queue sorted longest first; equal jobs stay in selection order
+    const uint64_t work = job.estimatedWork();
+    auto pos = std::upper_bound(m_pendingJobs.begin(), m_pendingJobs.end(), work,
+                                [](uint64_t value, const ConversionJob& queued) {
+                                    return value > queued.estimatedWork();
+                                });
+    m_pendingJobs.insert(pos, job);
+}
+
+void ConversionManager::setSchedulingPolicy(SchedulingPolicy policy)
+{
+    if (m_policy == policy) {
+        return;
+    }
+
+    m_policy = policy;
+
+    if (m_policy == SchedulingPolicy::LongestFirst) {
+        std::stable_sort(m_pendingJobs.begin(), m_pendingJobs.end(),
+                         [](const ConversionJob& a, const ConversionJob& b) {
+                             return a.estimatedWork() > b.estimatedWork();
+                         });
+    } else {
+        std::stable_sort(m_pendingJobs.begin(), m_pendingJobs.end(),
+                         [](const ConversionJob& a, const ConversionJob& b) { return a.id < b.id; });
+    }
+}
+
+void ConversionManager::setMaxConcurrentJobs(int count)
+{
+    m_maxConcurrentJobs = count > 0 ? count : qMax(1, QThread::idealThreadCount());
+    qInfo() << "Audio Converter - Running up to" << m_maxConcurrentJobs << "jobs in parallel";
+
+    // Fill any newly available slots
+    scheduleJobs();
+}
+
+void ConversionManager::setStaging(StagingMode mode, const QString& directory, qint64 quotaBytes)
+{
+    m_stagingMode = mode;
+    m_stagingDirectory = directory.isEmpty() ? defaultStagingDirectory() : directory;
+    m_stagingQuota = quotaBytes;
+    m_networkDirectories.clear();
+
+    // A larger quota may unblock queued jobs
+    requestSchedule();
+}
+
+bool ConversionManager::usesStaging(const ConversionJob& job, const ConversionTarget& target) const
+{
+    if (m_stagingMode == StagingMode::Off || m_stagingQuota <= 0) {
+        return false;
+    }
+    // Outputs that could never fit are written in place
+    if (estimatedOutputBytes(job, target) > m_stagingQuota) {
+        return false;
+    }
+    if (m_stagingMode == StagingMode::Always) {
+        return true;
+    }
+
+    const QString directory = QFileInfo(target.outputPath).absolutePath();
+    auto it = m_networkDirectories.constFind(directory);
+    if (it == m_networkDirectories.cend()) {
+        it = m_networkDirectories.insert(directory, isNetworkPath(directory));
+    }
+    return it.value();
+}
+
+qint64 ConversionManager::stagingReservation(const ConversionJob& job) const
+{
+    qint64 bytes{0};
+    for (const ConversionTarget& target : job.targets) {
+        if (usesStaging(job, target)) {
+            bytes += estimatedOutputBytes(job, target);
+        }
+    }
+    return bytes;
+}
+
+CodecWrapper* ConversionManager::createCodecWrapper(const QString& format, QObject* parent)
+{
+    // Every job gets its own wrapper, since a wrapper owns a single process
+    const QString key = format.toLower();
+
+#ifdef HAVE_LIBFLAC
+    if (key == "flac") {
+        return new LibFlacEncoder(parent);
+    }
+#endif
+#ifdef HAVE_LIBMP3LAME
+    if (key == "mp3") {
+        return new LibLameEncoder(parent);
+    }
+#endif
+#ifdef HAVE_LIBOPUSENC
+    if (key == "opus") {
+        return new LibOpusEncoder(parent);
+    }
+#endif
+#ifdef HAVE_LIBVORBISENC
+    if (key == "ogg") {
+        return new LibVorbisEncoder(parent);
+    }
+#endif
+
+    return createCliWrapper(key, parent);
+}
+
+CodecWrapper* ConversionManager::createCliWrapper(const QString& format, QObject* parent)
+{
+    const QString key = format.toLower();
+
+    if (key == "flac") {
+        return new FlacWrapper(parent);
+    }
+    if (key == "mp3") {
+        return new LameWrapper(parent);
+    }
+    if (key == "opus") {
+        return new OpusWrapper(parent);
+    }
+    if (key == "ogg") {
+        return new OggWrapper(parent);
+    }
+
+    return nullptr;
+}
+
+void ConversionManager::requestSchedule()
+{
+    if (m_scheduleRequested) {
+        return;
+    }
+
+    m_scheduleRequested = true;
+    QMetaObject::invokeMethod(this, &ConversionManager::scheduleJobs, Qt::QueuedConnection);
+}
+
+void ConversionManager::scheduleJobs()
+{
+    m_scheduleRequested = false;
+
+    // setCodecs() schedules again
+    if (!m_codecsProbed) {
+        return;
+    }
+
+    // Every target runs its own encoder, so a job takes one slot per target
+    while (!m_pendingJobs.isEmpty()) {
+        const int slots = static_cast<int>(m_pendingJobs.constFirst().targets.size());
+        // A job with more targets than slots still runs, just on its own
+        if (!m_activeJobs.isEmpty() && m_activeSlots + slots > m_maxConcurrentJobs) {
+            break;
+        }
+        // The staging directory is full; copy-outs in flight free it again
+        const qint64 staged = stagingReservation(m_pendingJobs.constFirst());
+        if (staged > 0 && m_stagedBytes > 0 && m_stagedBytes + staged > m_stagingQuota) {
+            break;
+        }
+        startJob(m_pendingJobs.takeFirst());
+    }
+
+    prefetchInputs();
+}
+
+void ConversionManager::prefetchInputs()
+{
+    QList<InputPrefetcher::Input> upcoming;
+    for (const ConversionJob& job : std::as_const(m_pendingJobs)) {
+        if (upcoming.size() == PrefetchMaxInputs) {
+            break;
+        }
+        upcoming.append({job.inputPath, static_cast<qint64>(job.track.fileSize())});
+    }
+    m_prefetcher->update(upcoming);
+}
+
+void ConversionManager::startJob(const ConversionJob& job)
+{
+    Trace::begin("job", Trace::jobTrack(job.id));
+    m_prefetcher->jobStarted(job.inputPath);
+    auto stallTimer = m_prefetcher->stallTimer();
+
+    // Copied targets don't need the decoder
+    QList<bool> passthrough;
+    QList<uint64_t> cacheKeys;
+    QStringList cached;
+    bool needsDecoder{false};
+    for (const ConversionTarget& target : job.targets) {
+        passthrough.append(canPassThrough(job, target));
+        cacheKeys.append(cacheKey(job, target));
+        cached.append(cacheKeys.constLast() != 0 ? m_cache->lookup(cacheKeys.constLast()) : QString{});
+        needsDecoder = needsDecoder || (!passthrough.constLast() && cached.constLast().isEmpty());
+    }
+    std::unique_ptr<PcmSource> source = needsDecoder ? openDecoder(job) : nullptr;
+
+    ActiveJob active;
+    active.job = job;
+    active.timer.start();
+    DecodeStage::OutputList outputs;
+
+    for (qsizetype index = 0; index < job.targets.size(); ++index) {
+        const ConversionTarget& target = job.targets.at(index);
+        const QString& format = target.options.format;
+        const bool encodes = !passthrough.at(index) && cached.at(index).isEmpty();
+        if (encodes && !isCodecAvailable(format)) {
+            const auto codec = m_codecs.constFind(format.toLower());
+            qWarning() << "Codec not available:" << format;
+            active.errors << (codec != m_codecs.cend() ? "Codec not installed: " + codec->executableName
+                                                       : "Unsupported format: " + format);
+            continue;
+        }
+
+        if (encodes && target.range && !source) {
+            active.errors << "Cannot decode " + QFileInfo(job.inputPath).fileName() + " to split it";
+            continue;
+        }
+
+        // Encoders write to a staged file that only replaces the output once complete
+        auto output = std::make_shared<StagedOutput>(target.outputPath);
+        if (QString error; !output->open(error)) {
+            active.errors << error;
+            continue;
+        }
+
+        // Encoded before with the same settings: on the same file system the output is just another link
+        if (!cached.at(index).isEmpty()) {
+            if (QString error; output->publishLink(cached.at(index), error)) {
+                m_publishedOutputs.append(target.outputPath);
+                continue;
+            }
+        }
+
+        ActiveTarget running;
+        running.target = target;
+        running.output = std::move(output);
+        running.cacheKey = cacheKeys.at(index);
+
+        // Slow destination: encode to local storage, copied over once complete
+        if (encodes && usesStaging(job, target)) {
+            const QString stagingPath = m_stagingDirectory + "/.fooyin-converter-"
+                                      + QString::number(QRandomGenerator::global()->generate64(), 36) + "."
+                                      + QFileInfo(target.outputPath).suffix();
+            if (QFile file{stagingPath}; file.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+                running.stagingPath = stagingPath;
+                running.stagedBytes = estimatedOutputBytes(job, target);
+                m_stagedBytes += running.stagedBytes;
+            } else {
+                qWarning() << "Audio Converter - Cannot stage in" << m_stagingDirectory << "-" << file.errorString();
+            }
+        }
+
+        if (passthrough.at(index)) {
+            running.codec = new PassthroughCopier();
+            running.passthrough = true;
+        } else if (!cached.at(index).isEmpty()) {
+            // Copied like a passthrough, reflinked where the file systems allow it
+            running.codec = new PassthroughCopier();
+            running.cachedPath = cached.at(index);
+        } else if (source) {
+            // Resampling etc. happens on the decoder thread, the encoder gets the final format
+            DecodeStage::Output output;
+            output.pipeline = PcmPipeline::create(source->format(), target.options);
+
+            // Measured last, on exactly the samples the encoder gets
+            if (target.options.replayGain) {
+                running.loudness = std::make_shared<LoudnessMeter>(output.pipeline->outputFormat());
+                output.pipeline->append(
+                    std::make_unique<LoudnessStage>(output.pipeline->outputFormat(), running.loudness));
+            }
+
+            uint64_t inputFrames = source->totalFrames();
+            int capacityBlocks = PcmStream::PreallocatedBlocks;
+
+            if (target.range) {
+                const int sampleRate = source->format().sampleRate;
+                output.startFrame = cueToFrames(target.range->start, sampleRate);
+                output.endFrame = target.range->end >= 0 ? cueToFrames(target.range->end, sampleRate) : 0;
+                inputFrames = output.endFrame > 0 ? output.endFrame - output.startFrame
+                                                  : target.track.duration() * static_cast<uint64_t>(sampleRate) / 1000;
+
+                // Room for the whole slice (stages may write partial blocks), so the decoder can move on
+                // while this track is encoded. Only queued blocks take memory, DecodeStage caps those.
+                const uint64_t sliceBlocks = output.pipeline->outputFrames(inputFrames) / PcmStream::BlockFrames;
+                capacityBlocks = static_cast<int>(
+                    std::clamp<uint64_t>(sliceBlocks * 2 + 2, PcmStream::PreallocatedBlocks, 1 << 20));
+            }
+
+            const PcmFormat streamFormat = output.pipeline->outputFormat();
+            output.stream = std::make_shared<PcmStream>(streamFormat, output.pipeline->outputFrames(inputFrames),
+                                                        capacityBlocks);
+
+            running.codec = createTargetCodec(job, target, &streamFormat);
+            running.stream = output.stream;
+            outputs.push_back(std::move(output));
+        } else {
+            running.codec = createTargetCodec(job, target, nullptr);
+        }
+
+        active.targets.append(running);
+    }
+
+    // Failed to start, or every output linked from the cache; still counts towards its album
+    if (active.targets.isEmpty()) {
+        m_activeJobs.insert(job.id, active);
+        emit jobStarted(job.id, job.inputPath);
+        finishLoudness(job.id);
+        return;
+    }
+
+    active.remaining = static_cast<int>(active.targets.size());
+    m_activeSlots += active.remaining;
+    m_activeJobs.insert(job.id, active);
+
+    const int jobId = job.id;
+
+    for (int index = 0; index < active.targets.size(); ++index) {
+        CodecWrapper* codec = active.targets.at(index).codec;
+
+        connect(codec, &CodecWrapper::progressChanged, this, [this, jobId, index](int percent) {
+            updateProgress(jobId, index, percent);
+        });
+
+        connect(codec, &CodecWrapper::conversionFinished, this, [this, jobId, index](bool success, const QString& error) {
+            finishTarget(jobId, index, success, error);
+        });
+    }
+
+    emit jobStarted(job.id, job.inputPath);
+
+    // Works on the local copy, a target that fails to start may finish the job right away
+    for (int index = 0; index < active.targets.size(); ++index) {
+        const ActiveTarget& running = active.targets.at(index);
+        const uint64_t track = Trace::targetTrack(jobId, index);
+        Trace::begin("encode", track);
+        Trace::begin("first byte", track);
+        running.codec->setTraceTrack(track);
+
+        const QString outputPath = running.stagingPath.isEmpty() ? running.output->path() : running.stagingPath;
+        if (running.stream) {
+            running.codec->convertStreamAsync(running.stream, outputPath, running.target.options);
+        } else {
+            const QString inputPath = running.cachedPath.isEmpty() ? job.inputPath : running.cachedPath;
+            running.codec->convertAsync(inputPath, outputPath, running.target.options);
+        }
+    }
+
+    // One decode feeds every target
+    if (source) {
+        uint64_t readAheadBlocks{0};
+        if (job.isImage()) {
+            const auto blockBytes = static_cast<uint64_t>(PcmStream::BlockFrames * source->format().channels)
+                                  * sizeof(float);
+            readAheadBlocks = ImageReadAheadBytes / blockBytes;
+        }
+        DecodeStage::start(std::move(source), std::move(outputs), readAheadBlocks, std::move(stallTimer));
+    }
+}
+
+CodecWrapper* ConversionManager::createTargetCodec(
+    const ConversionJob& job,
+    const ConversionTarget& target,
+    const PcmFormat* streamFormat)
+{
+    const ConversionOptions& options = target.options;
+    CodecWrapper* codec = createCodecWrapper(options.format, this);
+
+    // In-process encoders don't handle every input and option yet, the CLI tools cover the rest
+    const bool supported = streamFormat ? codec->canConvertStream(*streamFormat, options)
+                                        : codec->canConvert(job.inputPath, options);
+    if (!supported) {
+        CodecWrapper* cli = createCliWrapper(options.format, this);
+        if (cli && cli->isAvailable() && (!streamFormat || cli->canConvertStream(*streamFormat, options))) {
+            delete codec;
+            codec = cli;
+        } else {
+            delete cli;
+        }
+    }
+
+    codec->setSourceTrack(target.range ? target.track : job.track);
+    return codec;
+}
+
+std::unique_ptr<PcmSource> ConversionManager::openDecoder(const ConversionJob& job) const
+{
+    if (!m_audioLoader) {
+        return nullptr;
+    }
+
+    auto source = std::make_unique<DecoderSource>(m_audioLoader, job.track);
+    if (!source->open(job.inputPath)) {
+        qWarning() << "Audio Converter - Cannot decode" << job.inputPath << "-" << source->errorString();
+        return nullptr;
+    }
+
+    return source;
+}
+
+void ConversionManager::updateProgress(int jobId, int targetIndex, int percent)
+{
+    auto it = m_activeJobs.find(jobId);
+    if (it == m_activeJobs.end()) {
+        return;
+    }
+
+    ActiveTarget& target = it->targets[targetIndex];
+    target.progress = percent;
+    if (!target.flowing) {
+        target.flowing = true;
+        Trace::end("first byte", Trace::targetTrack(jobId, targetIndex));
+    }
+
+    int total{0};
+    for (const ActiveTarget& running : std::as_const(it->targets)) {
+        total += running.finished ? 100 : running.progress;
+    }
+    emit jobProgressChanged(jobId, total / static_cast<int>(it->targets.size()));
+}
+
+void ConversionManager::finishTarget(int jobId, int targetIndex, bool success, const QString& encoderError)
+{
+    auto it = m_activeJobs.find(jobId);
+    if (it == m_activeJobs.end()) {
+        return;
+    }
+
+    ActiveTarget& running = it->targets[targetIndex];
+    if (running.finished || running.copying) {
+        return;
+    }
+
+    const uint64_t track = Trace::targetTrack(jobId, targetIndex);
+    if (!running.flowing) {
+        running.flowing = true;
+        Trace::end("first byte", track);
+    }
+    Trace::end("encode", track);
+    Trace::begin("finish", track);
+
+    // The decoder skips this target from now on
+    if (running.stream) {
+        running.stream->abort();
+    }
+    disconnect(running.codec, nullptr, this, nullptr);
+    const EncoderUsage usage = running.codec->usage();
+    // One encoder without CPU times leaves the job's total unknown
+    if (usage.userCpuUs < 0 || it->usage.userCpuUs < 0) {
+        it->usage.userCpuUs = -1;
+        it->usage.systemCpuUs = -1;
+    } else {
+        it->usage.userCpuUs += usage.userCpuUs;
+        it->usage.systemCpuUs += usage.systemCpuUs;
+    }
+    it->usage.peakRssKiB = qMax(it->usage.peakRssKiB, usage.peakRssKiB);
+    running.codec->deleteLater();
+    running.codec = nullptr;
+    --m_activeSlots;
+
+    if (success && !running.stagingPath.isEmpty()) {
+        // The encoder slot is free already, the copy overlaps with the next encodes
+        copyOut(jobId, targetIndex);
+        scheduleJobs();
+        return;
+    }
+
+    // Tagged while still staged, so the output shows up with the library's tags
+    if (success && running.passthrough && m_audioLoader) {
+        writeLibraryTags(jobId, targetIndex);
+        scheduleJobs();
+        return;
+    }
+
+    completeTarget(jobId, targetIndex, success, encoderError);
+}
+
+void ConversionManager::copyOut(int jobId, int targetIndex)
+{
+    ActiveTarget& running = m_activeJobs[jobId].targets[targetIndex];
+    running.copying = true;
+
+    // The estimate becomes the real size
+    const qint64 size = QFileInfo(running.stagingPath).size();
+    m_stagedBytes += size - running.stagedBytes;
+    running.stagedBytes = size;
+
+    // Holding the output keeps its descriptor (and so its /proc path) valid until the copy is done
+    copyOutThreadPool()->start([this, jobId, targetIndex, source = running.stagingPath, output = running.output,
+                                cancelled = m_copyCancelled] {
+        const Trace::Scope scope{"copy out"};
+        QString error;
+        const bool success = copyOutFile(source, output->path(), *cancelled, error);
+        if (cancelled->load()) {
+            return;
+        }
+        QMetaObject::invokeMethod(
+            this, [this, jobId, targetIndex, success, error] { completeTarget(jobId, targetIndex, success, error); },
+            Qt::QueuedConnection);
+    });
+}
+
+void ConversionManager::completeTarget(int jobId, int targetIndex, bool success, const QString& encoderError)
+{
+    auto it = m_activeJobs.find(jobId);
+    if (it == m_activeJobs.end()) {
+        return;
+    }
+
+    ActiveTarget& running = it->targets[targetIndex];
+    running.copying = false;
+
+    if (!running.stagingPath.isEmpty()) {
+        QFile::remove(running.stagingPath);
+        m_stagedBytes -= running.stagedBytes;
+        running.stagedBytes = 0;
+    }
+
+    running.finished = true;
+    running.succeeded = success;
+
+    if (!success) {
+        running.output->discard();
+        Trace::end("finish", Trace::targetTrack(jobId, targetIndex));
+        it->errors << targetError(*it, running, encoderError);
+    }
+
+    if (--it->remaining == 0) {
+        finishLoudness(jobId);
+    }
+
+    // Hand the freed slot (or staging space) to the next job, the outputs may still wait for their tags
+    scheduleJobs();
+}
+
+QString ConversionManager::targetError(const ActiveJob& active, const ActiveTarget& running, const QString& error)
+{
+    const QString& format = running.target.options.format;
+    if (active.job.isImage()) {
+        // The tracks of an image may be split to several formats as well
+        const bool formats = std::any_of(active.job.targets.cbegin(), active.job.targets.cend(),
+                                         [&format](const ConversionTarget& target) { return target.options.format != format; });
+        return running.target.track.title() + (formats ? " (" + format.toUpper() + "): " : ": ") + error;
+    }
+    return active.job.targets.size() > 1 ? format.toUpper() + ": " + error : error;
+}
+
+void ConversionManager::finishLoudness(int jobId)
+{
+    const ActiveJob& active = m_activeJobs[jobId];
+
+    QList<GainTarget> measured;
+    for (const ActiveTarget& running : active.targets) {
+        // The decode stage is done with the meter once the encoder has seen the end of the stream
+        if (running.loudness && running.succeeded) {
+            measured.append({running.output, running.target.options.format, running.loudness});
+        }
+    }
+
+    auto album = active.job.albumId != 0 ? m_albums.find(active.job.albumId) : m_albums.end();
+    if (album == m_albums.end()) {
+        writeReplayGain({jobId}, measured, false);
         return;
     }
 
-    m_currentCodec = codec;
-    m_converting = true;
+    // Album gain needs every track, so the outputs of an album wait for the last one
+    album->targets.append(measured);
+    album->jobs.append(jobId);
+    if (--album->remaining == 0) {
+        const PendingAlbum done = *album;
+        m_albums.erase(album);
+        writeReplayGain(done.jobs, done.targets, true);
+    }
+}
+
+void ConversionManager::writeReplayGain(const QList<int>& jobIds, const QList<GainTarget>& targets,
+                                        bool withAlbumGain)
+{
+    if (!m_audioLoader || targets.isEmpty()) {
+        for (const int jobId : jobIds) {
+            publishJob(jobId);
+        }
+        return;
+    }
+
+    // Tag I/O may hit a network share, so it runs with the other destination I/O
+    copyOutThreadPool()->start([this, jobIds, targets, withAlbumGain, loader = m_audioLoader,
+                                cancelled = m_copyCancelled] {
+        applyReplayGain(*loader, targets, withAlbumGain, *cancelled);
+        if (cancelled->load()) {
+            return;
+        }
+        QMetaObject::invokeMethod(
+            this,
+            [this, jobIds] {
+                for (const int jobId : jobIds) {
+                    publishJob(jobId);
+                }
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void ConversionManager::applyReplayGain(Fooyin::AudioLoader& loader, const QList<GainTarget>& targets,
+                                        bool withAlbumGain, const std::atomic<bool>& cancelled)
+{
+    const Trace::Scope scope{"replaygain tags"};
+
+    struct AlbumGain {
+        float gain;
+        float peak;
+    };
+
+    // Every format has its own pipeline (rate, channels...), so each gets its own album values
+    QHash<QString, AlbumGain> albumGains;
+    if (withAlbumGain) {
+        QHash<QString, std::vector<std::shared_ptr<LoudnessMeter>>> meters;
+        for (const GainTarget& target : targets) {
+            meters[target.format].push_back(target.loudness);
+        }
+        for (auto it = meters.cbegin(); it != meters.cend(); ++it) {
+            const double loudness = LoudnessMeter::integratedLoudness(it.value());
+            if (std::isfinite(loudness)) {
+                albumGains.insert(it.key(), {LoudnessMeter::replayGain(loudness), LoudnessMeter::peak(it.value())});
+            }
+        }
+    }
+
+    for (const GainTarget& target : targets) {
+        if (cancelled.load()) {
+            return;
+        }
+
+        const QString& outputPath = target.output->finalPath();
+        const double loudness = target.loudness->integratedLoudness();
+        if (!std::isfinite(loudness)) {
+            qInfo() << "Audio Converter - No ReplayGain for" << outputPath << "(silent or too short)";
+            continue;
+        }
+
+        // Start from what the encoder wrote, only the gain fields change
+        Fooyin::Track output{outputPath};
+        if (!readStagedTags(loader, *target.output, output)) {
+            qWarning() << "Audio Converter - Cannot read tags of" << outputPath;
+            continue;
+        }
+
+        output.setRGTrackGain(LoudnessMeter::replayGain(loudness));
+        output.setRGTrackPeak(target.loudness->peak());
+        if (const auto album = albumGains.constFind(target.format); album != albumGains.cend()) {
+            output.setRGAlbumGain(album->gain);
+            output.setRGAlbumPeak(album->peak);
+        }
+
+        if (!writeStagedTags(loader, *target.output, output)) {
+            qWarning() << "Audio Converter - Cannot write ReplayGain tags to" << outputPath;
+        }
+    }
+}
+
+void ConversionManager::publishJob(int jobId)
+{
+    auto it = m_activeJobs.find(jobId);
+    if (it == m_activeJobs.end()) {
+        return;
+    }
+
+    // Every output shows up complete, with its final tags
+    for (int index = 0; index < it->targets.size(); ++index) {
+        ActiveTarget& running = it->targets[index];
+        if (!running.succeeded) {
+            continue;
+        }
+
+        const uint64_t track = Trace::targetTrack(jobId, index);
+        Trace::begin("publish", track);
+        QString error;
+        if (running.output->publish(error)) {
+            m_publishedOutputs.append(running.target.outputPath);
+        } else {
+            running.succeeded = false;
+            running.output->discard();
+            it->errors << targetError(*it, running, error);
+        }
+        Trace::end("publish", track);
+        Trace::end("finish", track);
+    }
+
+    const bool jobSuccess = it->errors.isEmpty();
+    const QString jobError = it->errors.join('\n');
+    storeInCache(*it);
+    recordStats(*it, jobSuccess);
+    m_prefetcher->jobFinished(it->job.inputPath);
+    m_activeJobs.erase(it);
+    Trace::end("job", Trace::jobTrack(jobId));
+
+    emit jobFinished(jobId, jobSuccess, jobError);
+
+    // Deferred: a job that finishes while starting mustn't start the next one from inside startJob()
+    requestSchedule();
+
+    if (!isConverting()) {
+        endBatch();
+    }
+}
+
+void ConversionManager::writeLibraryTags(int jobId, int targetIndex)
+{
+    ActiveJob& active = m_activeJobs[jobId];
+    ActiveTarget& running = active.targets[targetIndex];
+    running.copying = true;
+
+    // A copy keeps the tags of the file; the library's may be newer
+    Fooyin::Track track{active.job.track};
+    track.setFilePath(running.output->finalPath());
 
-    // Connect codec signals
-    connect(codec, &CodecWrapper::progressChanged, this, [this](int percent) {
-        emit progressChanged(percent);
+    copyOutThreadPool()->start([this, jobId, targetIndex, track, output = running.output, loader = m_audioLoader,
+                                cancelled = m_copyCancelled] {
+        const Trace::Scope scope{"tags"};
+        const bool success = writeStagedTags(*loader, *output, track);
+        if (cancelled->load()) {
+            return;
+        }
+        const QString error = success ? QString{} : "Cannot write tags to " + output->finalPath();
+        QMetaObject::invokeMethod(
+            this, [this, jobId, targetIndex, success, error] { completeTarget(jobId, targetIndex, success, error); },
+            Qt::QueuedConnection);
     });
+}
 
-    connect(codec, &CodecWrapper::conversionFinished, this, [this](bool success, const QString& error) {
-        m_converting = false;
+void ConversionManager::recordStats(const ActiveJob& active, bool success)
+{
+    JobStats stats;
+    stats.jobId = active.job.id;
+    stats.inputPath = active.job.inputPath;
+    stats.success = success;
+    stats.wallMs = active.timer.elapsed();
+    stats.userCpuUs = active.usage.userCpuUs;
+    stats.systemCpuUs = active.usage.systemCpuUs;
+    stats.peakRssKiB = active.usage.peakRssKiB;
 
-        // Disconnect codec signals
-        if (m_currentCodec) {
-            disconnect(m_currentCodec, nullptr, this, nullptr);
-            m_currentCodec = nullptr;
+    for (const ConversionTarget& target : active.job.targets) {
+        stats.outputPaths.append(target.outputPath);
+        stats.formats.append(target.options.format);
+        if (active.job.isImage()) {
+            stats.inputDurationMs += target.track.duration();
+        }
+    }
+    if (!active.job.isImage()) {
+        stats.inputDurationMs = active.job.audioDuration();
+    }
+
+    // Outputs linked from the encode cache read and write nothing
+    bool readsInput{false};
+    for (const ActiveTarget& running : active.targets) {
+        if (running.cachedPath.isEmpty()) {
+            readsInput = true;
+        } else {
+            stats.bytesRead += QFileInfo(running.cachedPath).size();
         }
+        if (running.succeeded) {
+            stats.bytesWritten += QFileInfo(running.target.outputPath).size();
+        }
+    }
+    if (readsInput) {
+        stats.bytesRead += QFileInfo(active.job.inputPath).size();
+    }
+
+    m_jobStats.append(stats);
+}
 
-        emit conversionFinished(success, error);
+void ConversionManager::exportStats()
+{
+    if (m_statsDirectory.isEmpty() || m_jobStats.isEmpty()) {
+        return;
+    }
+
+    const QString base = m_statsDirectory + "/converter-stats-"
+                       + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss");
+    QThreadPool::globalInstance()->start([stats = m_jobStats, base, directory = m_statsDirectory] {
+        QDir{}.mkpath(directory);
+        if (QString error; !writeJobStats(stats, base + ".json", base + ".csv", error)) {
+            qWarning() << "Audio Converter -" << error;
+        } else {
+            qInfo() << "Audio Converter - Wrote job stats of" << stats.size() << "jobs to" << base + ".json";
+        }
     });
+}
 
-    emit conversionStarted();
-    codec->convertAsync(inputPath, outputPath, options);
+void ConversionManager::setTracing(bool enabled)
+{
+    Trace::setEnabled(enabled);
+}
+
+void ConversionManager::exportTrace()
+{
+    if (!Trace::isEnabled() || m_statsDirectory.isEmpty()) {
+        return;
+    }
+
+    const QString path = m_statsDirectory + "/converter-trace-"
+                       + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".json";
+    QThreadPool::globalInstance()->start([path, directory = m_statsDirectory] {
+        QDir{}.mkpath(directory);
+        if (QString error; !Trace::write(path, error)) {
+            qWarning() << "Audio Converter -" << error;
+        } else {
+            qInfo() << "Audio Converter - Wrote trace to" << path;
+        }
+    });
+}
+
+void ConversionManager::syncPublishedOutputs()
+{
+    if (m_publishedOutputs.isEmpty()) {
+        return;
+    }
+
+    // One pass at the end of the batch, off the GUI thread; slow on network shares
+    QThreadPool::globalInstance()->start([paths = std::exchange(m_publishedOutputs, {})] {
+        const Trace::Scope scope{"sync"};
+        syncOutputs(paths);
+        qInfo() << "Audio Converter - Synced" << paths.size() << "output files to disk";
+    });
+}
+
+void ConversionManager::endBatch()
+{
+    const InputPrefetcher::Stats prefetch = m_prefetcher->stats();
+    if (prefetch.hits + prefetch.misses > 0) {
+        qInfo().nospace() << "Audio Converter - Prefetch: " << prefetch.hits << " of "
+                          << prefetch.hits + prefetch.misses << " inputs cached at start, "
+                          << prefetch.coldBytes / (1024 * 1024) << " MiB read cold, "
+                          << prefetch.hintedBytes / (1024 * 1024) << " MiB hinted, "
+                          << prefetch.stallMs << " ms waiting for first blocks";
+    }
+
+    if (m_cache) {
+        const EncodeCache::Stats cache = m_cache->stats();
+        qInfo().nospace() << "Audio Converter - Encode cache: " << cache.hits << " hits, " << cache.misses
+                          << " misses, " << cache.evicted << " evicted, " << cache.bytes / (1024 * 1024)
+                          << " MiB of " << m_cache->directory();
+        // Queued behind the entries still being stored
+        encodeCacheThreadPool()->start([cache = m_cache] { cache->save(); });
+    }
+
+    exportStats();
+    syncPublishedOutputs();
+    exportTrace();
+    emit queueFinished();
 }
 
 void ConversionManager::cancel()
 {
-    if (m_converting && m_currentCodec) {
-        m_currentCodec->cancel();
-        m_converting = false;
-        disconnect(m_currentCodec, nullptr, this, nullptr);
-        m_currentCodec = nullptr;
+    // Every converter shares the manager: each dropped job still ends with jobFinished
+    QList<int> canceledJobs = m_activeJobs.keys();
+    for (const ConversionJob& job : std::as_const(m_pendingJobs)) {
+        canceledJobs.append(job.id);
+    }
+
+    m_pendingJobs.clear();
+    m_albums.clear();
+
+    const auto activeJobs = m_activeJobs;
+    m_activeJobs.clear();
+    m_activeSlots = 0;
+    m_stagedBytes = 0;
+    m_hashingJobs = 0;
+
+    // Copies and retags in flight stop, the results of queued ones are dropped
+    m_copyCancelled->store(true);
+    m_copyCancelled = std::make_shared<std::atomic<bool>>(false);
+
+    for (const ActiveJob& active : activeJobs) {
+        Trace::end("job", Trace::jobTrack(active.job.id));
+        for (const ActiveTarget& running : active.targets) {
+            if (running.finished) {
+                // Complete, only waiting for the other outputs of the job
+                if (QString error; running.succeeded && !running.loudness && running.output->publish(error)) {
+                    m_publishedOutputs.append(running.target.outputPath);
+                }
+                // One waiting for its ReplayGain tags lacks them, so it is dropped with its last
+                // reference; a tag write in flight on the copy-out worker still holds one
+                continue;
+            }
+            if (running.codec) {
+                disconnect(running.codec, nullptr, this, nullptr);
+                if (running.stream) {
+                    running.stream->abort();
+                }
+                running.codec->cancel();
+                running.codec->deleteLater();
+            }
+            // A running copy drops its output itself when it stops
+            if (!running.copying) {
+                running.output->discard();
+            }
+            if (!running.stagingPath.isEmpty()) {
+                QFile::remove(running.stagingPath);
+            }
+        }
     }
+
+    // Whatever finished before the cancel is kept, and synced like at the end of a batch
+    syncPublishedOutputs();
+
+    // Queued, so the caller is done with its own cleanup before the jobs are reported
+    QMetaObject::invokeMethod(
+        this,
+        [this, canceledJobs] {
+            for (const int jobId : canceledJobs) {
+                emit jobFinished(jobId, false, "Conversion canceled");
+            }
+        },
+        Qt::QueuedConnection);
 }
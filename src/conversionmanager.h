@@ -1,14 +1,30 @@
 #pragma once
 
 #include "codecwrapper.h"
+#include "conversionjob.h"
+#include "jobstats.h"
+#include "localstaging.h"
+#include <QElapsedTimer>
 #include <QObject>
+#include <QHash>
+#include <QList>
 #include <QMap>
 #include <QString>
+#include <QStringList>
 
-class FlacWrapper;
-class LameWrapper;
-class OpusWrapper;
-class OggWrapper;
+#include <atomic>
+#include <memory>
+
+namespace Fooyin {
+class AudioLoader;
+}
+
+class EncodeCache;
+class InputPrefetcher;
+class LoudnessMeter;
+class StagedOutput;
+class PcmSource;
+class PcmStream;
 
 class ConversionManager : public QObject
 {
@@ -18,6 +34,10 @@ public:
     explicit ConversionManager(QObject* parent = nullptr);
     ~ConversionManager() override;
 
+    // Codecs are looked up on a worker thread once the manager is created. Until
+    // codecsReady() is emitted none are available, and queued jobs wait.
+    bool codecsProbed() const { return m_codecsProbed; }
+
     // Check which codecs are available
     bool isCodecAvailable(const QString& format) const;
     QStringList availableCodecs() const;
@@ -30,31 +50,231 @@ public:
         const ConversionOptions& options
     );
 
-    void convertAsync(
+    // Queues an asynchronous conversion and returns its job id.
+    // Up to maxConcurrentJobs() jobs run at the same time.
+    int convertAsync(
         const QString& inputPath,
         const QString& outputPath,
         const ConversionOptions& options
     );
 
+    // Same as above, keeping the library metadata of the source for scheduling
+    int convertAsync(
+        const Fooyin::Track& track,
+        const QString& outputPath,
+        const ConversionOptions& options
+    );
+
+    // Encodes one track to several outputs at once. The input is read and decoded
+    // only once; the job finishes when every target is done.
+    int convertAsync(const Fooyin::Track& track, const QList<ConversionTarget>& targets);
+
+    // Queues the tracks of one album, tracks[i] going to outputPaths[i]. With ReplayGain
+    // enabled, album gain and peak are measured across all of them during encoding and
+    // written to every output once the last one is done.
+    QList<int> convertAlbumAsync(
+        const Fooyin::TrackList& tracks,
+        const QStringList& outputPaths,
+        const ConversionOptions& options
+    );
+    // Same for several outputs per track: targets[i] are the outputs of tracks[i]. Album
+    // gain is measured per format.
+    QList<int> convertAlbumAsync(const Fooyin::TrackList& tracks, const QList<QList<ConversionTarget>>& targets);
+
+    // Splits a CUE image: tracks (all from the same file) go to outputPaths in one job.
+    // The image is decoded once, front to back, and every track's slice is cut at the
+    // sample positions of the CUE sheet and encoded by its own encoder.
+    int convertImageAsync(
+        const Fooyin::TrackList& tracks,
+        const QStringList& outputPaths,
+        const ConversionOptions& options
+    );
+    // Same for several outputs per track: outputs[i] are those of tracks[i], their range
+    // and track are filled in. Still a single decode of the image.
+    int convertImageAsync(const Fooyin::TrackList& tracks, const QList<QList<ConversionTarget>>& outputs);
+
+    // Rewrites the tags and front cover of the existing outputPaths[i] from the library
+    // metadata of tracks[i], leaving the audio alone; with ReplayGain enabled, the gain
+    // measured on the output is kept. Runs one file after another on the copy-out worker
+    // and reports every output with outputRetagged.
+    void retagAsync(
+        const Fooyin::TrackList& tracks,
+        const QStringList& outputPaths,
+        const ConversionOptions& options
+    );
+
+    // Decodes inputs with fooyin's decoders and streams PCM to the encoders.
+    // Without a loader, encoders read the input files themselves.
+    void setAudioLoader(std::shared_ptr<Fooyin::AudioLoader> audioLoader);
+
+    // Cancels all running jobs and drops everything still queued, of every caller. Each
+    // dropped job and retag is still reported (failed) with jobFinished/outputRetagged.
     void cancel();
 
+    // Scheduler
+    int maxConcurrentJobs() const { return m_maxConcurrentJobs; }
+    void setMaxConcurrentJobs(int count); // 0 = one job per CPU core
+    SchedulingPolicy schedulingPolicy() const { return m_policy; }
+    void setSchedulingPolicy(SchedulingPolicy policy);
+
+    // Local staging: encoders write into directory (tmpfs/SSD) and finished files are copied
+    // to their destination by a background worker, overlapped with the next encodes. New
+    // jobs wait while more than quotaBytes are staged. Applies from the next job on.
+    StagingMode stagingMode() const { return m_stagingMode; }
+    void setStaging(StagingMode mode, const QString& directory, qint64 quotaBytes);
+
+    // Encode cache: outputs are stored in directory (up to maxBytes, LRU) and reused by later
+    // jobs with the same source audio, options, encoder and tags. 0 bytes turns it off.
+    void setEncodeCache(const QString& directory, qint64 maxBytes);
+    // Current cache and its counters, nullptr if turned off
+    EncodeCache* encodeCache() const { return m_cache.get(); }
+
     // Status
-    bool isConverting() const { return m_converting; }
+    bool isConverting() const
+    {
+        return !m_activeJobs.isEmpty() || !m_pendingJobs.isEmpty() || m_hashingJobs > 0;
+    }
+    int activeJobCount() const { return m_activeJobs.size(); }
+    int pendingJobCount() const { return m_pendingJobs.size(); }
+
+    // Page cache warming of queued inputs, for the current or last batch
+    InputPrefetcher* prefetcher() const { return m_prefetcher; }
+
+    // Resources used by every job of the current or last batch, in the order they finished
+    const QList<JobStats>& jobStats() const { return m_jobStats; }
+    // At the end of every batch, its job stats are written to directory as
+    // converter-stats-<date>.json and .csv. Empty turns the export off.
+    void setStatsDirectory(const QString& directory) { m_statsDirectory = directory; }
+    // Records a timeline of every job and stage, written next to the job stats as
+    // converter-trace-<date>.json (Chrome/Perfetto trace format) at the end of a batch
+    void setTracing(bool enabled);
 
 signals:
-    void progressChanged(int percent);
-    void conversionFinished(bool success, const QString& error);
     void conversionStarted();
+    void jobStarted(int jobId, const QString& inputPath);
+    void jobProgressChanged(int jobId, int percent);
+    void jobFinished(int jobId, bool success, const QString& error);
+    void queueFinished();
+    void outputRetagged(const QString& outputPath, bool success);
+    void codecsReady();
 
 private:
-    CodecWrapper* getCodecWrapper(const QString& format);
+    struct CodecInfo {
+        QString executableName;
+        QString version;
+        bool available{false};
+    };
+
+    struct ActiveTarget {
+        ConversionTarget target;
+        CodecWrapper* codec{nullptr};
+        std::shared_ptr<PcmStream> stream; // Set while a decode stage feeds the codec
+        std::shared_ptr<LoudnessMeter> loudness; // Set for ReplayGain, filled by the decode stage
+        std::shared_ptr<StagedOutput> output;    // Where the encoder writes until the target succeeds
+        QString stagingPath;                     // Local file the encoder writes to instead, if staged
+        qint64 stagedBytes{0};                   // Counted against the staging quota
+        QString cachedPath;                      // Encode cache entry the output is copied from, if any
+        uint64_t cacheKey{0};                    // Stored in the encode cache once done, 0 = not cacheable
+        int progress{0};
+        bool flowing{false};     // Encoder reported progress, ends its "first byte" span
+        bool passthrough{false}; // Source copied as is
+        bool copying{false};     // Encoded, waiting for the copy to the destination (or its tags)
+        bool finished{false};
+        bool succeeded{false};
+    };
+
+    struct ActiveJob {
+        ConversionJob job;
+        QList<ActiveTarget> targets;
+        int remaining{0};
+        QStringList errors;
+        QElapsedTimer timer;
+        EncoderUsage usage{0, 0, -1}; // Summed over the targets, peak RSS of the largest
+    };
+
+    // A finished output waiting for its ReplayGain tags, written before it is published
+    struct GainTarget {
+        std::shared_ptr<StagedOutput> output;
+        QString format;
+        std::shared_ptr<LoudnessMeter> loudness;
+    };
+
+    struct PendingAlbum {
+        int remaining{0}; // Jobs of the album not encoded yet
+        QList<GainTarget> targets;
+        QList<int> jobs; // Encoded, published once the album gain is written
+    };
+
+    // Runs on a worker thread
+    static QMap<QString, CodecInfo> probeCodecs();
+    void setCodecs(const QMap<QString, CodecInfo>& codecs);
+    static CodecWrapper* createCodecWrapper(const QString& format, QObject* parent);
+    static CodecWrapper* createCliWrapper(const QString& format, QObject* parent);
+    int queueJob(const Fooyin::Track& track, const QList<ConversionTarget>& targets, int albumId);
+    bool usesEncodeCache(const ConversionJob& job) const;
+    void hashSource(const ConversionJob& job);
+    uint64_t cacheKey(const ConversionJob& job, const ConversionTarget& target);
+    void storeInCache(const ActiveJob& active);
+    std::unique_ptr<PcmSource> openDecoder(const ConversionJob& job) const;
+    void enqueue(const ConversionJob& job);
+    void requestSchedule();
+    void scheduleJobs();
+    void startJob(const ConversionJob& job);
+    CodecWrapper* createTargetCodec(const ConversionJob& job, const ConversionTarget& target,
+                                    const PcmFormat* streamFormat);
+    void updateProgress(int jobId, int targetIndex, int percent);
+    bool usesStaging(const ConversionJob& job, const ConversionTarget& target) const;
+    qint64 stagingReservation(const ConversionJob& job) const;
+    void finishTarget(int jobId, int targetIndex, bool success, const QString& error);
+    void copyOut(int jobId, int targetIndex);
+    void completeTarget(int jobId, int targetIndex, bool success, const QString& error);
+    // Error of one output, prefixed with the track or format it belongs to
+    static QString targetError(const ActiveJob& active, const ActiveTarget& running, const QString& error);
+    void finishLoudness(int jobId);
+    void writeReplayGain(const QList<int>& jobIds, const QList<GainTarget>& targets, bool withAlbumGain);
+    // Runs on the copy-out worker, stops at the next file once cancelled
+    static void applyReplayGain(Fooyin::AudioLoader& loader, const QList<GainTarget>& targets, bool withAlbumGain,
+                                const std::atomic<bool>& cancelled);
+    void publishJob(int jobId);
+    void writeLibraryTags(int jobId, int targetIndex);
+    void recordStats(const ActiveJob& active, bool success);
+    void exportStats();
+    void exportTrace();
+    void syncPublishedOutputs();
+    void prefetchInputs();
+    void endBatch();
+
+    QMap<QString, CodecInfo> m_codecs;
+    bool m_codecsProbed{false};
+    std::shared_ptr<Fooyin::AudioLoader> m_audioLoader;
+    InputPrefetcher* m_prefetcher;
+
+    // Scheduler state
+    QList<ConversionJob> m_pendingJobs;
+    QHash<int, ActiveJob> m_activeJobs;
+    QHash<int, PendingAlbum> m_albums;
+    QStringList m_publishedOutputs; // Not yet synced to disk
+    int m_maxConcurrentJobs{1};
+    int m_activeSlots{0}; // Encoders running across all active jobs
+    SchedulingPolicy m_policy{SchedulingPolicy::LongestFirst};
+    int m_nextJobId{1};
+    int m_nextAlbumId{1};
+    bool m_scheduleRequested{false};
+
+    // Local staging
+    StagingMode m_stagingMode{StagingMode::Off};
+    QString m_stagingDirectory;
+    qint64 m_stagingQuota{0};
+    qint64 m_stagedBytes{0}; // Reserved by running encoders and held by files waiting for copy-out
+    mutable QHash<QString, bool> m_networkDirectories;
+    // Set on cancel for the background copies, retags and hashing of the batch
+    std::shared_ptr<std::atomic<bool>> m_copyCancelled;
 
-    FlacWrapper* m_flacWrapper;
-    LameWrapper* m_lameWrapper;
-    OpusWrapper* m_opusWrapper;
-    OggWrapper* m_oggWrapper;
+    // Encode cache
+    std::shared_ptr<EncodeCache> m_cache;
+    int m_hashingJobs{0}; // Jobs waiting for their source hash before being queued
 
-    QMap<QString, CodecWrapper*> m_codecMap;
-    CodecWrapper* m_currentCodec{nullptr};
-    bool m_converting{false};
+    // Resource accounting
+    QList<JobStats> m_jobStats;
+    QString m_statsDirectory;
 };
@@ -1,4 +1,5 @@
 #include "converterplugin.h"
+#include "batchjournal.h"
 #include "conversionmanager.h"
 #include "converterwidget.h"
 #include "convertersettings.h"
@@ -14,17 +15,36 @@
 #include <QDebug>
 #include <QAction>
 #include <QDialog>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QMessageBox>
 #include <QVBoxLayout>
+#include <QtConcurrent>
+
+#include <algorithm>
 
 void ConverterPlugin::initialise(const Fooyin::CorePluginContext& context)
 {
     // Store settings manager from core context
     m_settings = context.settingsManager;
 
+    // fooyin's decoders let us convert anything it can play
+    m_audioLoader = context.audioLoader;
+
     // Register settings with default values
     m_settings->createSetting<ConverterSettings::DefaultCodec>(QString("flac"), "AudioConverter/DefaultCodec");
     m_settings->createSetting<ConverterSettings::WindowWidth>(600, "AudioConverter/WindowWidth");
     m_settings->createSetting<ConverterSettings::WindowHeight>(500, "AudioConverter/WindowHeight");
+    m_settings->createSetting<ConverterSettings::MaxConcurrentJobs>(0, "AudioConverter/MaxConcurrentJobs");
+    m_settings->createSetting<ConverterSettings::SchedulingPolicy>(static_cast<int>(SchedulingPolicy::LongestFirst), "AudioConverter/SchedulingPolicy");
+    m_settings->createSetting<ConverterSettings::StagingMode>(static_cast<int>(StagingMode::Off), "AudioConverter/StagingMode");
+    m_settings->createSetting<ConverterSettings::StagingDirectory>(QString(), "AudioConverter/StagingDirectory");
+    m_settings->createSetting<ConverterSettings::StagingQuota>(2048, "AudioConverter/StagingQuota");
+    m_settings->createSetting<ConverterSettings::MirrorVerifyContent>(true, "AudioConverter/MirrorVerifyContent");
+    m_settings->createSetting<ConverterSettings::EncodeCacheDirectory>(QString(), "AudioConverter/EncodeCacheDirectory");
+    m_settings->createSetting<ConverterSettings::EncodeCacheSize>(0, "AudioConverter/EncodeCacheSize");
+    m_settings->createSetting<ConverterSettings::StatsDirectory>(QString(), "AudioConverter/StatsDirectory");
+    m_settings->createSetting<ConverterSettings::TraceEnabled>(false, "AudioConverter/TraceEnabled");
 
     qInfo() << "Audio Converter plugin: Settings registered";
 }
@@ -33,6 +53,36 @@ void ConverterPlugin::initialise(const Fooyin::GuiPluginContext& context)
 {
     // Initialize conversion manager
     m_manager = new ConversionManager(this);
+    m_manager->setAudioLoader(m_audioLoader);
+    m_manager->setMaxConcurrentJobs(m_settings->value<ConverterSettings::MaxConcurrentJobs>());
+    m_settings->subscribe<ConverterSettings::MaxConcurrentJobs>(m_manager, &ConversionManager::setMaxConcurrentJobs);
+    m_manager->setSchedulingPolicy(static_cast<SchedulingPolicy>(m_settings->value<ConverterSettings::SchedulingPolicy>()));
+    m_settings->subscribe<ConverterSettings::SchedulingPolicy>(m_manager, [this](int policy) {
+        m_manager->setSchedulingPolicy(static_cast<SchedulingPolicy>(policy));
+    });
+
+    const auto applyStaging = [this] {
+        m_manager->setStaging(static_cast<StagingMode>(m_settings->value<ConverterSettings::StagingMode>()),
+                              m_settings->value<ConverterSettings::StagingDirectory>(),
+                              static_cast<qint64>(m_settings->value<ConverterSettings::StagingQuota>()) * 1024 * 1024);
+    };
+    applyStaging();
+    m_settings->subscribe<ConverterSettings::StagingMode>(m_manager, [applyStaging](int) { applyStaging(); });
+    m_settings->subscribe<ConverterSettings::StagingDirectory>(m_manager, [applyStaging](const QString&) { applyStaging(); });
+    m_settings->subscribe<ConverterSettings::StagingQuota>(m_manager, [applyStaging](int) { applyStaging(); });
+
+    const auto applyEncodeCache = [this] {
+        m_manager->setEncodeCache(m_settings->value<ConverterSettings::EncodeCacheDirectory>(),
+                                  static_cast<qint64>(m_settings->value<ConverterSettings::EncodeCacheSize>()) * 1024 * 1024);
+    };
+    applyEncodeCache();
+    m_settings->subscribe<ConverterSettings::EncodeCacheDirectory>(m_manager, [applyEncodeCache](const QString&) { applyEncodeCache(); });
+    m_settings->subscribe<ConverterSettings::EncodeCacheSize>(m_manager, [applyEncodeCache](int) { applyEncodeCache(); });
+
+    m_manager->setStatsDirectory(m_settings->value<ConverterSettings::StatsDirectory>());
+    m_settings->subscribe<ConverterSettings::StatsDirectory>(m_manager, &ConversionManager::setStatsDirectory);
+    m_manager->setTracing(m_settings->value<ConverterSettings::TraceEnabled>());
+    m_settings->subscribe<ConverterSettings::TraceEnabled>(m_manager, &ConversionManager::setTracing);
 
     // Store track selection controller
     m_trackSelection = context.trackSelection;
@@ -40,22 +90,27 @@ void ConverterPlugin::initialise(const Fooyin::GuiPluginContext& context)
     // Register settings page
     new ConverterSettingsPage(m_settings, m_manager);
 
-    // Check if any codecs are available
-    QStringList available = m_manager->availableCodecs();
-    if (available.isEmpty()) {
-        qWarning() << "Audio Converter Plugin: No audio codecs found!";
-        qWarning() << "Please install one or more of: flac, lame, opusenc, oggenc";
-        // Still register the widget so users can see the error message
-    } else {
-        qInfo() << "Audio Converter Plugin initialized successfully";
-        qInfo() << "Available formats:" << available;
-    }
+    // One journal for every converter, so a batch can't replace or drop the journal of another
+    m_journal = new BatchJournal(defaultBatchJournalPath(), this);
+
+    // Codecs are looked up in the background, so fooyin's window doesn't wait for the encoders
+    connect(m_manager, &ConversionManager::codecsReady, this, [this]() {
+        QStringList available = m_manager->availableCodecs();
+        if (available.isEmpty()) {
+            qWarning() << "Audio Converter Plugin: No audio codecs found!";
+            qWarning() << "Please install one or more of: flac, lame, opusenc, oggenc";
+            // The widget stays registered so users can see the error message
+        } else {
+            qInfo() << "Available formats:" << available;
+        }
+        checkInterruptedBatch();
+    });
 
     // Register widget with fooyin
     context.widgetProvider->registerWidget(
         "AudioConverter",
         [this]() {
-            return new ConverterWidget(m_manager);
+            return new ConverterWidget(m_manager, m_journal);
         },
         "Audio Converter"
     );
@@ -104,9 +159,30 @@ void ConverterPlugin::showConverterDialog()
 
     qInfo() << "Converting" << tracks.size() << "track(s)";
 
+    ConverterWidget* dialog = converterDialog();
+
+    // Check if single or multiple tracks
+    if (tracks.size() == 1) {
+        // Single track conversion
+        qInfo() << "Single track:" << tracks.front().filepath();
+        dialog->loadTrack(tracks.front());
+    } else {
+        // Batch conversion - keep the full tracks so the queue can use their duration and size
+        qInfo() << "Batch conversion:" << tracks.size() << "tracks";
+        dialog->loadTracks(tracks);
+    }
+
+    // Show the dialog
+    dialog->show();
+    dialog->raise();
+    dialog->activateWindow();
+}
+
+ConverterWidget* ConverterPlugin::converterDialog()
+{
     // Create or reuse converter dialog
     if (!m_converterDialog) {
-        m_converterDialog = new ConverterWidget(m_manager, m_settings);
+        m_converterDialog = new ConverterWidget(m_manager, m_journal, m_settings);
         // Set window flags to make it a dialog
         m_converterDialog->setWindowFlags(Qt::Dialog | Qt::WindowCloseButtonHint);
         m_converterDialog->setWindowModality(Qt::ApplicationModal);
@@ -116,25 +192,55 @@ void ConverterPlugin::showConverterDialog()
         int height = m_settings->value<ConverterSettings::WindowHeight>();
         m_converterDialog->resize(width, height);
     }
+    return m_converterDialog;
+}
 
-    // Check if single or multiple tracks
-    if (tracks.size() == 1) {
-        // Single track conversion
-        QString filepath = tracks.front().filepath();
-        qInfo() << "Single track:" << filepath;
-        m_converterDialog->loadTrack(filepath);
-    } else {
-        // Batch conversion
-        QStringList filepaths;
-        for (const auto& track : tracks) {
-            filepaths << track.filepath();
-        }
-        qInfo() << "Batch conversion:" << filepaths.size() << "tracks";
-        m_converterDialog->loadTracks(filepaths);
+void ConverterPlugin::checkInterruptedBatch()
+{
+    if (!m_audioLoader) {
+        return;
     }
 
-    // Show the dialog
-    m_converterDialog->show();
-    m_converterDialog->raise();
-    m_converterDialog->activateWindow();
+    // Checks the finished outputs and reads every remaining source again
+    using Result = std::optional<BatchJournal::Interrupted>;
+    auto* watcher = new QFutureWatcher<Result>(this);
+    connect(watcher, &QFutureWatcher<Result>::finished, this, [this, watcher]() {
+        watcher->deleteLater();
+        const Result batch = watcher->result();
+        if (!batch) {
+            return;
+        }
+
+        const auto remaining = std::count_if(batch->sources.cbegin(), batch->sources.cend(), [](const auto& source) {
+            return source.state != BatchJournal::State::Done;
+        });
+        const QMessageBox::StandardButton reply = QMessageBox::question(
+            nullptr, tr("Resume Conversion"),
+            tr("A conversion of %1 files was interrupted with %2 files left to convert. Do you want to resume it?")
+                .arg(batch->sources.size())
+                .arg(remaining),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+
+        if (reply != QMessageBox::Yes) {
+            // Unless a new batch took the journal over meanwhile
+            if (!m_journal->isHeld()) {
+                QFile::remove(defaultBatchJournalPath());
+            }
+            return;
+        }
+
+        ConverterWidget* dialog = converterDialog();
+        dialog->show();
+        dialog->raise();
+        dialog->activateWindow();
+        dialog->resumeBatch(*batch);
+    });
+
+    watcher->setFuture(QtConcurrent::run([loader = m_audioLoader]() -> Result {
+        Result batch = BatchJournal::read(defaultBatchJournalPath());
+        if (batch) {
+            BatchJournal::prepareResume(*batch, *loader);
+        }
+        return batch;
+    }));
 }
@@ -4,13 +4,17 @@
 #include <core/plugins/plugin.h>
 #include <gui/plugins/guiplugin.h>
 
+#include <memory>
+
 class QAction;
 
 namespace Fooyin {
+class AudioLoader;
 class TrackSelectionController;
 class SettingsManager;
 }
 
+class BatchJournal;
 class ConversionManager;
 class ConverterWidget;
 
@@ -31,9 +35,15 @@ private slots:
     void showConverterDialog();
 
 private:
+    ConverterWidget* converterDialog();
+    // Offers to continue a batch that was cut short last session
+    void checkInterruptedBatch();
+
     ConversionManager* m_manager{nullptr};
+    BatchJournal* m_journal{nullptr}; // Shared by the converter widget and the dialog
     ConverterWidget* m_converterDialog{nullptr};
     Fooyin::TrackSelectionController* m_trackSelection{nullptr};
     Fooyin::SettingsManager* m_settings{nullptr};
+    std::shared_ptr<Fooyin::AudioLoader> m_audioLoader;
     QAction* m_convertAction{nullptr};
 };
@@ -10,10 +10,22 @@ enum Setting : uint32_t
 {
     // String settings
     DefaultCodec   = 5 << 28 | 1,  // Settings::String
+    StagingDirectory  = 5 << 28 | 8,  // Settings::String (empty = tmpfs or the temp directory)
+    EncodeCacheDirectory = 5 << 28 | 10, // Settings::String (empty = fooyin's cache folder)
+    StatsDirectory    = 5 << 28 | 12, // Settings::String (empty = no export)
+
+    // Bool settings
+    MirrorVerifyContent = 1 << 28 | 9,  // Settings::Bool
+    TraceEnabled        = 1 << 28 | 13, // Settings::Bool (written to StatsDirectory)
 
     // Int settings
     WindowWidth    = 2 << 28 | 2,  // Settings::Int
     WindowHeight   = 2 << 28 | 3,  // Settings::Int
+    MaxConcurrentJobs = 2 << 28 | 4,  // Settings::Int (0 = one per CPU core)
+    SchedulingPolicy  = 2 << 28 | 5,  // Settings::Int (::SchedulingPolicy)
+    StagingMode       = 2 << 28 | 6,  // Settings::Int (::StagingMode)
+    StagingQuota      = 2 << 28 | 7,  // Settings::Int (MiB)
+    EncodeCacheSize   = 2 << 28 | 11, // Settings::Int (MiB, 0 = off)
 };
 
 Q_ENUM_NS(Setting)
@@ -1,14 +1,23 @@
 #include "convertersettingspage.h"
 #include "convertersettings.h"
 #include "conversionmanager.h"
+#include "conversionjob.h"
+#include "encodecache.h"
+#include "localstaging.h"
 
 #include <utils/settings/settingsmanager.h>
 
+#include <QCheckBox>
 #include <QComboBox>
+#include <QFileDialog>
 #include <QFormLayout>
 #include <QGroupBox>
+#include <QHBoxLayout>
 #include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
 #include <QSpinBox>
+#include <QThread>
 #include <QVBoxLayout>
 
 ConverterSettingsPageWidget::ConverterSettingsPageWidget(Fooyin::SettingsManager* settings, ConversionManager* manager)
@@ -17,6 +26,16 @@ ConverterSettingsPageWidget::ConverterSettingsPageWidget(Fooyin::SettingsManager
     , m_windowWidthSpin{nullptr}
     , m_windowHeightSpin{nullptr}
     , m_defaultCodecCombo{nullptr}
+    , m_maxJobsSpin{nullptr}
+    , m_schedulingCombo{nullptr}
+    , m_mirrorVerifyCheck{nullptr}
+    , m_stagingModeCombo{nullptr}
+    , m_stagingDirEdit{nullptr}
+    , m_stagingQuotaSpin{nullptr}
+    , m_cacheDirEdit{nullptr}
+    , m_cacheSizeSpin{nullptr}
+    , m_statsDirEdit{nullptr}
+    , m_traceCheck{nullptr}
 {
     setupUI();
 }
@@ -55,17 +74,13 @@ void ConverterSettingsPageWidget::setupUI()
     auto* formatLayout = new QFormLayout(formatGroup);
 
     m_defaultCodecCombo = new QComboBox(this);
+    populateCodecs();
 
-    // Populate with available codecs
-    QStringList codecs = m_manager->availableCodecs();
-    if (codecs.isEmpty()) {
-        m_defaultCodecCombo->addItem(tr("None Available"), "");
-        m_defaultCodecCombo->setEnabled(false);
-    } else {
-        for (const auto& codec : codecs) {
-            m_defaultCodecCombo->addItem(codec.toUpper(), codec);
-        }
-    }
+    // Codec lookup may still run when the page is first built
+    connect(m_manager, &ConversionManager::codecsReady, this, [this]() {
+        populateCodecs();
+        loadDefaultCodec();
+    });
 
     formatLayout->addRow(tr("Default codec:"), m_defaultCodecCombo);
 
@@ -76,9 +91,179 @@ void ConverterSettingsPageWidget::setupUI()
 
     layout->addWidget(formatGroup);
 
+    // Batch conversion group
+    auto* batchGroup = new QGroupBox(tr("Batch Conversion"), this);
+    auto* batchLayout = new QFormLayout(batchGroup);
+
+    m_maxJobsSpin = new QSpinBox(this);
+    m_maxJobsSpin->setMinimum(0);
+    m_maxJobsSpin->setMaximum(256);
+    m_maxJobsSpin->setSpecialValueText(tr("Automatic (%1)").arg(QThread::idealThreadCount()));
+    batchLayout->addRow(tr("Parallel jobs:"), m_maxJobsSpin);
+
+    auto* jobsNote = new QLabel(tr("Number of tracks encoded at the same time. Automatic uses one job per CPU core."), this);
+    jobsNote->setWordWrap(true);
+    jobsNote->setStyleSheet("QLabel { color: gray; font-style: italic; }");
+    batchLayout->addRow(jobsNote);
+
+    m_schedulingCombo = new QComboBox(this);
+    m_schedulingCombo->addItem(tr("Longest tracks first"), static_cast<int>(SchedulingPolicy::LongestFirst));
+    m_schedulingCombo->addItem(tr("Selection order"), static_cast<int>(SchedulingPolicy::Fifo));
+    batchLayout->addRow(tr("Queue order:"), m_schedulingCombo);
+
+    auto* schedulingNote = new QLabel(tr("Starting long tracks first avoids a single long track running alone at the end of a batch."), this);
+    schedulingNote->setWordWrap(true);
+    schedulingNote->setStyleSheet("QLabel { color: gray; font-style: italic; }");
+    batchLayout->addRow(schedulingNote);
+
+    m_mirrorVerifyCheck = new QCheckBox(tr("Only retag outputs when just the tags of a source changed"), this);
+    batchLayout->addRow(tr("Mirror:"), m_mirrorVerifyCheck);
+
+    auto* mirrorNote = new QLabel(tr("Mirror runs fingerprint the audio of changed sources, leaving tags and cover "
+                                     "art out; sources with the same audio only get their output's tags rewritten. "
+                                     "Costs reading every converted source once more."), this);
+    mirrorNote->setWordWrap(true);
+    mirrorNote->setStyleSheet("QLabel { color: gray; font-style: italic; }");
+    batchLayout->addRow(mirrorNote);
+
+    layout->addWidget(batchGroup);
+
+    // Local staging group
+    auto* stagingGroup = new QGroupBox(tr("Local Staging"), this);
+    auto* stagingLayout = new QFormLayout(stagingGroup);
+
+    m_stagingModeCombo = new QComboBox(this);
+    m_stagingModeCombo->addItem(tr("Off"), static_cast<int>(StagingMode::Off));
+    m_stagingModeCombo->addItem(tr("Network destinations"), static_cast<int>(StagingMode::NetworkDestinations));
+    m_stagingModeCombo->addItem(tr("All destinations"), static_cast<int>(StagingMode::Always));
+    stagingLayout->addRow(tr("Stage outputs:"), m_stagingModeCombo);
+
+    auto* stagingDirLayout = new QHBoxLayout();
+    m_stagingDirEdit = new QLineEdit(this);
+    m_stagingDirEdit->setPlaceholderText(defaultStagingDirectory());
+    auto* stagingDirButton = new QPushButton(tr("Browse..."), this);
+    stagingDirLayout->addWidget(m_stagingDirEdit);
+    stagingDirLayout->addWidget(stagingDirButton);
+    stagingLayout->addRow(tr("Staging folder:"), stagingDirLayout);
+
+    connect(stagingDirButton, &QPushButton::clicked, this, [this]() {
+        const QString path = QFileDialog::getExistingDirectory(this, tr("Select Staging Folder"), m_stagingDirEdit->text());
+        if (!path.isEmpty()) {
+            m_stagingDirEdit->setText(path);
+        }
+    });
+
+    m_stagingQuotaSpin = new QSpinBox(this);
+    m_stagingQuotaSpin->setMinimum(64);
+    m_stagingQuotaSpin->setMaximum(1024 * 1024);
+    m_stagingQuotaSpin->setSingleStep(256);
+    m_stagingQuotaSpin->setSuffix(" MiB");
+    stagingLayout->addRow(tr("Staging quota:"), m_stagingQuotaSpin);
+
+    auto* stagingNote = new QLabel(tr("Encoders write to a fast local folder (tmpfs or SSD) and finished files are copied to the destination in the background, "
+                                      "so slow network shares don't hold up encoding. New tracks wait while the quota is used up."), this);
+    stagingNote->setWordWrap(true);
+    stagingNote->setStyleSheet("QLabel { color: gray; font-style: italic; }");
+    stagingLayout->addRow(stagingNote);
+
+    layout->addWidget(stagingGroup);
+
+    // Encode cache group
+    auto* cacheGroup = new QGroupBox(tr("Encode Cache"), this);
+    auto* cacheLayout = new QFormLayout(cacheGroup);
+
+    auto* cacheDirLayout = new QHBoxLayout();
+    m_cacheDirEdit = new QLineEdit(this);
+    m_cacheDirEdit->setPlaceholderText(defaultEncodeCacheDirectory());
+    auto* cacheDirButton = new QPushButton(tr("Browse..."), this);
+    cacheDirLayout->addWidget(m_cacheDirEdit);
+    cacheDirLayout->addWidget(cacheDirButton);
+    cacheLayout->addRow(tr("Cache folder:"), cacheDirLayout);
+
+    connect(cacheDirButton, &QPushButton::clicked, this, [this]() {
+        const QString path = QFileDialog::getExistingDirectory(this, tr("Select Cache Folder"), m_cacheDirEdit->text());
+        if (!path.isEmpty()) {
+            m_cacheDirEdit->setText(path);
+        }
+    });
+
+    m_cacheSizeSpin = new QSpinBox(this);
+    m_cacheSizeSpin->setMinimum(0);
+    m_cacheSizeSpin->setMaximum(1024 * 1024);
+    m_cacheSizeSpin->setSingleStep(1024);
+    m_cacheSizeSpin->setSuffix(" MiB");
+    m_cacheSizeSpin->setSpecialValueText(tr("Off"));
+    cacheLayout->addRow(tr("Cache size:"), m_cacheSizeSpin);
+
+    auto* cacheNote = new QLabel(tr("Keeps encoded files so converting the same tracks with the same settings again (e.g. to another device folder) "
+                                    "links or copies them instead of encoding. Outputs on the cache's drive are hard links and take no extra space."), this);
+    cacheNote->setWordWrap(true);
+    cacheNote->setStyleSheet("QLabel { color: gray; font-style: italic; }");
+    cacheLayout->addRow(cacheNote);
+
+    layout->addWidget(cacheGroup);
+
+    // Diagnostics group
+    auto* statsGroup = new QGroupBox(tr("Diagnostics"), this);
+    auto* statsLayout = new QFormLayout(statsGroup);
+
+    auto* statsDirLayout = new QHBoxLayout();
+    m_statsDirEdit = new QLineEdit(this);
+    m_statsDirEdit->setPlaceholderText(tr("Off"));
+    auto* statsDirButton = new QPushButton(tr("Browse..."), this);
+    statsDirLayout->addWidget(m_statsDirEdit);
+    statsDirLayout->addWidget(statsDirButton);
+    statsLayout->addRow(tr("Export folder:"), statsDirLayout);
+
+    connect(statsDirButton, &QPushButton::clicked, this, [this]() {
+        const QString path = QFileDialog::getExistingDirectory(this, tr("Select Export Folder"), m_statsDirEdit->text());
+        if (!path.isEmpty()) {
+            m_statsDirEdit->setText(path);
+        }
+    });
+
+    m_traceCheck = new QCheckBox(tr("Record a timeline trace"), this);
+    statsLayout->addRow(m_traceCheck);
+
+    auto* statsNote = new QLabel(tr("After every batch, writes the wall time, encoder CPU time, peak memory, bytes read and written "
+                                    "and audio length of each job to this folder, as JSON and CSV. The trace shows the decode, encode, "
+                                    "copy and publish steps of every job over time; open it in ui.perfetto.dev or chrome://tracing."), this);
+    statsNote->setWordWrap(true);
+    statsNote->setStyleSheet("QLabel { color: gray; font-style: italic; }");
+    statsLayout->addRow(statsNote);
+
+    layout->addWidget(statsGroup);
+
     layout->addStretch();
 }
 
+void ConverterSettingsPageWidget::populateCodecs()
+{
+    m_defaultCodecCombo->clear();
+
+    // Populate with available codecs
+    QStringList codecs = m_manager->availableCodecs();
+    if (codecs.isEmpty()) {
+        m_defaultCodecCombo->addItem(m_manager->codecsProbed() ? tr("None Available") : tr("Looking for encoders..."), "");
+        m_defaultCodecCombo->setEnabled(false);
+    } else {
+        for (const auto& codec : codecs) {
+            m_defaultCodecCombo->addItem(codec.toUpper(), codec);
+        }
+        m_defaultCodecCombo->setEnabled(true);
+    }
+}
+
+void ConverterSettingsPageWidget::loadDefaultCodec()
+{
+    QString defaultCodec = m_settings->value<ConverterSettings::DefaultCodec>();
+
+    int index = m_defaultCodecCombo->findData(defaultCodec);
+    if (index >= 0) {
+        m_defaultCodecCombo->setCurrentIndex(index);
+    }
+}
+
 void ConverterSettingsPageWidget::load()
 {
     // Load window size
@@ -88,13 +273,32 @@ void ConverterSettingsPageWidget::load()
     m_windowWidthSpin->setValue(width);
     m_windowHeightSpin->setValue(height);
 
-    // Load default codec
-    QString defaultCodec = m_settings->value<ConverterSettings::DefaultCodec>();
+    loadDefaultCodec();
 
-    int index = m_defaultCodecCombo->findData(defaultCodec);
-    if (index >= 0) {
-        m_defaultCodecCombo->setCurrentIndex(index);
+    // Load parallel job count
+    m_maxJobsSpin->setValue(m_settings->value<ConverterSettings::MaxConcurrentJobs>());
+
+    int policyIndex = m_schedulingCombo->findData(m_settings->value<ConverterSettings::SchedulingPolicy>());
+    if (policyIndex >= 0) {
+        m_schedulingCombo->setCurrentIndex(policyIndex);
+    }
+
+    m_mirrorVerifyCheck->setChecked(m_settings->value<ConverterSettings::MirrorVerifyContent>());
+
+    // Load local staging
+    int stagingIndex = m_stagingModeCombo->findData(m_settings->value<ConverterSettings::StagingMode>());
+    if (stagingIndex >= 0) {
+        m_stagingModeCombo->setCurrentIndex(stagingIndex);
     }
+    m_stagingDirEdit->setText(m_settings->value<ConverterSettings::StagingDirectory>());
+    m_stagingQuotaSpin->setValue(m_settings->value<ConverterSettings::StagingQuota>());
+
+    // Load encode cache
+    m_cacheDirEdit->setText(m_settings->value<ConverterSettings::EncodeCacheDirectory>());
+    m_cacheSizeSpin->setValue(m_settings->value<ConverterSettings::EncodeCacheSize>());
+
+    m_statsDirEdit->setText(m_settings->value<ConverterSettings::StatsDirectory>());
+    m_traceCheck->setChecked(m_settings->value<ConverterSettings::TraceEnabled>());
 }
 
 void ConverterSettingsPageWidget::apply()
@@ -103,9 +307,29 @@ void ConverterSettingsPageWidget::apply()
     m_settings->set<ConverterSettings::WindowWidth>(m_windowWidthSpin->value());
     m_settings->set<ConverterSettings::WindowHeight>(m_windowHeightSpin->value());
 
-    // Save default codec
+    // Save default codec, kept as is while codecs are still being looked up
     QString codec = m_defaultCodecCombo->currentData().toString();
-    m_settings->set<ConverterSettings::DefaultCodec>(codec);
+    if (!codec.isEmpty()) {
+        m_settings->set<ConverterSettings::DefaultCodec>(codec);
+    }
+
+    // Save parallel job count
+    m_settings->set<ConverterSettings::MaxConcurrentJobs>(m_maxJobsSpin->value());
+    m_settings->set<ConverterSettings::SchedulingPolicy>(m_schedulingCombo->currentData().toInt());
+
+    m_settings->set<ConverterSettings::MirrorVerifyContent>(m_mirrorVerifyCheck->isChecked());
+
+    // Save local staging
+    m_settings->set<ConverterSettings::StagingMode>(m_stagingModeCombo->currentData().toInt());
+    m_settings->set<ConverterSettings::StagingDirectory>(m_stagingDirEdit->text().trimmed());
+    m_settings->set<ConverterSettings::StagingQuota>(m_stagingQuotaSpin->value());
+
+    // Save encode cache
+    m_settings->set<ConverterSettings::EncodeCacheDirectory>(m_cacheDirEdit->text().trimmed());
+    m_settings->set<ConverterSettings::EncodeCacheSize>(m_cacheSizeSpin->value());
+
+    m_settings->set<ConverterSettings::StatsDirectory>(m_statsDirEdit->text().trimmed());
+    m_settings->set<ConverterSettings::TraceEnabled>(m_traceCheck->isChecked());
 }
 
 void ConverterSettingsPageWidget::reset()
@@ -114,6 +338,16 @@ void ConverterSettingsPageWidget::reset()
     m_settings->reset<ConverterSettings::WindowWidth>();
     m_settings->reset<ConverterSettings::WindowHeight>();
     m_settings->reset<ConverterSettings::DefaultCodec>();
+    m_settings->reset<ConverterSettings::MaxConcurrentJobs>();
+    m_settings->reset<ConverterSettings::SchedulingPolicy>();
+    m_settings->reset<ConverterSettings::MirrorVerifyContent>();
+    m_settings->reset<ConverterSettings::StagingMode>();
+    m_settings->reset<ConverterSettings::StagingDirectory>();
+    m_settings->reset<ConverterSettings::StagingQuota>();
+    m_settings->reset<ConverterSettings::EncodeCacheDirectory>();
+    m_settings->reset<ConverterSettings::EncodeCacheSize>();
+    m_settings->reset<ConverterSettings::StatsDirectory>();
+    m_settings->reset<ConverterSettings::TraceEnabled>();
 
     // Reload UI
     load();
@@ -21,6 +21,8 @@ public:
 
 private:
     void setupUI();
+    void populateCodecs();
+    void loadDefaultCodec();
 
     Fooyin::SettingsManager* m_settings;
     ConversionManager* m_manager;
@@ -29,6 +31,16 @@ private:
     class QSpinBox* m_windowWidthSpin;
     class QSpinBox* m_windowHeightSpin;
     class QComboBox* m_defaultCodecCombo;
+    class QSpinBox* m_maxJobsSpin;
+    class QComboBox* m_schedulingCombo;
+    class QCheckBox* m_mirrorVerifyCheck;
+    class QComboBox* m_stagingModeCombo;
+    class QLineEdit* m_stagingDirEdit;
+    class QSpinBox* m_stagingQuotaSpin;
+    class QLineEdit* m_cacheDirEdit;
+    class QSpinBox* m_cacheSizeSpin;
+    class QLineEdit* m_statsDirEdit;
+    class QCheckBox* m_traceCheck;
 };
 
 class ConverterSettingsPage : public Fooyin::SettingsPage
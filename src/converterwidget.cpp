@@ -1,4 +1,5 @@
 #include "converterwidget.h"
+#include "conversionjob.h"
 #include "conversionmanager.h"
 #include "convertersettings.h"
 
@@ -10,20 +11,163 @@
 #include <QGroupBox>
 #include <QLineEdit>
 #include <QComboBox>
+#include <QCheckBox>
 #include <QPushButton>
 #include <QProgressBar>
 #include <QLabel>
+#include <QListWidget>
 #include <QSpinBox>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QFileInfo>
+#include <QFutureWatcher>
+#include <QRegularExpression>
+#include <QtConcurrent>
 #include <QCloseEvent>
 #include <QKeyEvent>
 
-ConverterWidget::ConverterWidget(ConversionManager* manager, Fooyin::SettingsManager* settings, QWidget* parent)
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr auto MirrorManifestName = ".fooyin-mirror";
+
+// Identifies a source in the mirror manifest; the tracks of an image differ by offset
+QString mirrorKey(const Fooyin::Track& track)
+{
+    return track.hasCue() ? track.filepath() + "#" + QString::number(track.offset()) : track.filepath();
+}
+
+// Deepest folder containing all tracks
+QString commonFolder(const Fooyin::TrackList& tracks)
+{
+    QString common;
+    for (const Fooyin::Track& track : tracks) {
+        const QString folder = QFileInfo(track.filepath()).absolutePath();
+        if (common.isNull()) {
+            common = folder;
+            continue;
+        }
+        while (common != folder && !folder.startsWith(common + "/") && common != "/") {
+            common = QFileInfo(common).absolutePath();
+        }
+    }
+    return common;
+}
+
+// Tracks that share one file are slices of a CUE image. Returns the images and leaves
+// every other track in singleFiles.
+QList<Fooyin::TrackList> cueImages(const Fooyin::TrackList& tracks, Fooyin::TrackList& singleFiles)
+{
+    QStringList order;
+    QHash<QString, Fooyin::TrackList> files;
+
+    for (const Fooyin::Track& track : tracks) {
+        if (!files.contains(track.filepath())) {
+            order.append(track.filepath());
+        }
+        files[track.filepath()].push_back(track);
+    }
+
+    QList<Fooyin::TrackList> images;
+    for (const QString& path : std::as_const(order)) {
+        const Fooyin::TrackList& fileTracks = files.value(path);
+        if (fileTracks.size() > 1) {
+            images.append(fileTracks);
+        } else {
+            singleFiles.push_back(fileTracks.front());
+        }
+    }
+
+    return images;
+}
+
+// Splits a selection into whole albums and loose tracks. An album counts as whole when
+// each of its discs has as many selected tracks as its track total (if that is known).
+QList<Fooyin::TrackList> completeAlbums(const Fooyin::TrackList& tracks, Fooyin::TrackList& looseTracks)
+{
+    QStringList order;
+    QHash<QString, Fooyin::TrackList> albums;
+
+    for (const Fooyin::Track& track : tracks) {
+        if (track.album().isEmpty()) {
+            looseTracks.push_back(track);
+            continue;
+        }
+
+        const QString key = track.albumArtists().join(u'\x1f') + u'\x1e' + track.album();
+        if (!albums.contains(key)) {
+            order.append(key);
+        }
+        albums[key].push_back(track);
+    }
+
+    QList<Fooyin::TrackList> complete;
+    for (const QString& key : std::as_const(order)) {
+        const Fooyin::TrackList& album = albums.value(key);
+
+        QHash<QString, int> discTracks;
+        for (const Fooyin::Track& track : album) {
+            ++discTracks[track.discNumber()];
+        }
+
+        bool isComplete{true};
+        for (const Fooyin::Track& track : album) {
+            const int trackTotal = track.trackTotal().toInt();
+            if (trackTotal > 0 && discTracks.value(track.discNumber()) != trackTotal) {
+                isComplete = false;
+            }
+        }
+        const int discTotal = album.front().discTotal().toInt();
+        if (discTotal > 0 && discTracks.size() != discTotal) {
+            isComplete = false;
+        }
+
+        if (isComplete) {
+            complete.append(album);
+        } else {
+            looseTracks.insert(looseTracks.end(), album.cbegin(), album.cend());
+        }
+    }
+
+    return complete;
+}
+
+// "OPUS 128 kbps in /music/opus"
+QString describeOutput(const BatchJournal::Output& output)
+{
+    const ConversionOptions& options = output.options;
+    QString quality;
+    if (options.format == "flac") {
+        quality = QString("level %1").arg(options.compressionLevel);
+    } else if (options.bitrate > 0) {
+        quality = QString("%1 kbps").arg(options.bitrate);
+    } else if (options.quality >= 0) {
+        quality = QString(options.format == "mp3" ? "V%1" : "quality %1").arg(options.quality);
+    }
+    return QString("%1 %2 in %3").arg(options.format.toUpper(), quality, output.folder);
+}
+
+// Time left as shown in the status, e.g. "1 h 05 min", "4 min 10 s" or "35 s"
+QString formatRemaining(qint64 ms)
+{
+    const qint64 seconds = (ms + 999) / 1000;
+    if (seconds >= 3600) {
+        return QString("%1 h %2 min").arg(seconds / 3600).arg((seconds % 3600) / 60, 2, 10, QChar('0'));
+    }
+    if (seconds >= 60) {
+        return QString("%1 min %2 s").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+    }
+    return QString("%1 s").arg(seconds);
+}
+} // namespace
+
+ConverterWidget::ConverterWidget(ConversionManager* manager, BatchJournal* journal, Fooyin::SettingsManager* settings,
+                                 QWidget* parent)
     : FyWidget(parent)
     , m_manager(manager)
     , m_settings(settings)
+    , m_journal(journal)
 {
     setupUI();
 
@@ -33,12 +177,16 @@ ConverterWidget::ConverterWidget(ConversionManager* manager, Fooyin::SettingsMan
     }
 
     // Connect manager signals
-    connect(m_manager, &ConversionManager::progressChanged,
+    connect(m_manager, &ConversionManager::jobStarted,
+            this, &ConverterWidget::onJobStarted);
+    connect(m_manager, &ConversionManager::jobProgressChanged,
             this, &ConverterWidget::onProgress);
-    connect(m_manager, &ConversionManager::conversionFinished,
+    connect(m_manager, &ConversionManager::jobFinished,
             this, &ConverterWidget::onFinished);
-    connect(m_manager, &ConversionManager::conversionStarted,
-            this, &ConverterWidget::onStarted);
+    connect(m_manager, &ConversionManager::outputRetagged,
+            this, &ConverterWidget::onRetagged);
+    connect(m_manager, &ConversionManager::codecsReady,
+            this, &ConverterWidget::onCodecsReady);
 }
 
 void ConverterWidget::setupUI()
@@ -82,25 +230,7 @@ void ConverterWidget::setupUI()
 
     // Format selector
     m_formatCombo = new QComboBox();
-    QStringList availableCodecs = m_manager->availableCodecs();
-
-    // Add formats with availability info
-    if (availableCodecs.contains("mp3")) {
-        m_formatCombo->addItem("MP3", "mp3");
-    }
-    if (availableCodecs.contains("flac")) {
-        m_formatCombo->addItem("FLAC (Lossless)", "flac");
-    }
-    if (availableCodecs.contains("opus")) {
-        m_formatCombo->addItem("Opus", "opus");
-    }
-    if (availableCodecs.contains("ogg")) {
-        m_formatCombo->addItem("Ogg Vorbis", "ogg");
-    }
-
-    if (m_formatCombo->count() == 0) {
-        m_formatCombo->addItem("No codecs available!", "");
-    }
+    populateFormats();
 
     connect(m_formatCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &ConverterWidget::onFormatChanged);
@@ -128,6 +258,52 @@ void ConverterWidget::setupUI()
     m_channelsCombo->addItem("Stereo", 2);
     formatLayout->addRow("Channels:", m_channelsCombo);
 
+    // Bit depth (lossless output only)
+    m_bitDepthCombo = new QComboBox();
+    m_bitDepthCombo->addItem("Original", 0);
+    m_bitDepthCombo->addItem("16 bit", 16);
+    m_bitDepthCombo->addItem("24 bit", 24);
+    formatLayout->addRow("Bit Depth:", m_bitDepthCombo);
+
+    // Loudness is measured while encoding, whole albums also get album gain
+    m_replayGainCheck = new QCheckBox("Write track and album gain");
+    formatLayout->addRow("ReplayGain:", m_replayGainCheck);
+
+    // Sources already in the target format and quality are copied, not re-encoded
+    m_passthroughCheck = new QCheckBox("Copy files that already match");
+    m_passthroughCheck->setChecked(true);
+    formatLayout->addRow("Passthrough:", m_passthroughCheck);
+
+    // Batch runs into a folder can skip everything converted before and unchanged since
+    m_mirrorCheck = new QCheckBox("Only convert new or changed files (keeps folder structure)");
+    formatLayout->addRow("Mirror:", m_mirrorCheck);
+
+    // ===== Additional Formats =====
+    // Batches can encode every source to further formats, each into its own folder
+    m_extraOutputsGroup = new QGroupBox("Additional Formats");
+    auto* extraLayout = new QVBoxLayout(m_extraOutputsGroup);
+
+    m_extraOutputList = new QListWidget();
+    m_extraOutputList->setMaximumHeight(90);
+
+    auto* extraButtonLayout = new QHBoxLayout();
+    auto* addOutputButton = new QPushButton("Add Current Format");
+    addOutputButton->setToolTip("Also convert to the format settings and destination above, "
+                                "then change them for the main output");
+    auto* removeOutputButton = new QPushButton("Remove");
+    extraButtonLayout->addWidget(addOutputButton);
+    extraButtonLayout->addWidget(removeOutputButton);
+    extraButtonLayout->addStretch();
+
+    extraLayout->addWidget(m_extraOutputList);
+    extraLayout->addLayout(extraButtonLayout);
+
+    connect(addOutputButton, &QPushButton::clicked, this, &ConverterWidget::addExtraOutput);
+    connect(removeOutputButton, &QPushButton::clicked, this, &ConverterWidget::removeExtraOutput);
+
+    // Batch mode only
+    m_extraOutputsGroup->setEnabled(false);
+
     // ===== Progress Section =====
     auto* progressGroup = new QGroupBox("Progress");
     auto* progressLayout = new QVBoxLayout(progressGroup);
@@ -169,6 +345,7 @@ void ConverterWidget::setupUI()
     mainLayout->addWidget(inputGroup);
     mainLayout->addWidget(outputGroup);
     mainLayout->addWidget(formatGroup);
+    mainLayout->addWidget(m_extraOutputsGroup);
     mainLayout->addWidget(progressGroup);
     mainLayout->addLayout(buttonLayout);
     mainLayout->addWidget(m_codecInfoLabel);
@@ -178,8 +355,47 @@ void ConverterWidget::setupUI()
     updateQualityOptions();
 }
 
+void ConverterWidget::populateFormats()
+{
+    const QSignalBlocker blocker{m_formatCombo};
+    m_formatCombo->clear();
+
+    QStringList availableCodecs = m_manager->availableCodecs();
+
+    // Add formats with availability info
+    if (availableCodecs.contains("mp3")) {
+        m_formatCombo->addItem("MP3", "mp3");
+    }
+    if (availableCodecs.contains("flac")) {
+        m_formatCombo->addItem("FLAC (Lossless)", "flac");
+    }
+    if (availableCodecs.contains("opus")) {
+        m_formatCombo->addItem("Opus", "opus");
+    }
+    if (availableCodecs.contains("ogg")) {
+        m_formatCombo->addItem("Ogg Vorbis", "ogg");
+    }
+
+    if (m_formatCombo->count() == 0) {
+        m_formatCombo->addItem(m_manager->codecsProbed() ? "No codecs available!" : "Looking for encoders...", "");
+    }
+}
+
+void ConverterWidget::onCodecsReady()
+{
+    populateFormats();
+    applyDefaultCodec();
+    onFormatChanged(m_formatCombo->currentIndex());
+    updateCodecInfo();
+}
+
 void ConverterWidget::updateCodecInfo()
 {
+    if (!m_manager->codecsProbed()) {
+        m_codecInfoLabel->setText("Looking for encoders...");
+        return;
+    }
+
     QStringList available = m_manager->availableCodecs();
     QString info = "Available codecs: ";
 
@@ -209,7 +425,7 @@ void ConverterWidget::browseInput()
 void ConverterWidget::browseOutput()
 {
     // Check if in batch mode
-    if (!m_trackQueue.isEmpty()) {
+    if (!m_trackQueue.empty()) {
         // Batch mode: select output folder
         QString defaultPath = m_outputEdit->text();
         if (defaultPath == QStringLiteral("Same as source folder")) {
@@ -220,6 +436,11 @@ void ConverterWidget::browseOutput()
 
         if (!path.isEmpty()) {
             m_outputEdit->setText(path);
+
+            if (m_manager->stagingMode() == StagingMode::Off && isNetworkPath(path)) {
+                m_statusLabel->setText("The output folder is on a network share. Enabling local staging in the "
+                                       "converter settings keeps the encoders busy while files are copied.");
+            }
         }
     } else {
         // Single file mode: select output file
@@ -248,8 +469,8 @@ QString ConverterWidget::getOutputExtension() const
 void ConverterWidget::updateOutputPath()
 {
     // Skip output path updates when in batch mode
-    if (!m_trackQueue.isEmpty()) {
-        m_convertButton->setEnabled(!m_trackQueue.isEmpty() && !m_outputEdit->text().isEmpty());
+    if (!m_trackQueue.empty()) {
+        m_convertButton->setEnabled(!m_outputEdit->text().isEmpty());
         return;
     }
 
@@ -326,12 +547,20 @@ void ConverterWidget::updateQualityOptions()
         m_qualityCombo->addItem("Quality 2 (~96 kbps)", 2);
         m_qualityCombo->setCurrentIndex(1);  // Default: Quality 8
     }
+
+    m_bitDepthCombo->setEnabled(format == "flac");
 }
 
 bool ConverterWidget::validateInput()
 {
+    // Codec lookup at startup hasn't finished yet
+    if (!m_manager->codecsProbed()) {
+        QMessageBox::information(this, "Please Wait", "Still looking for installed encoders, try again in a moment.");
+        return false;
+    }
+
     // For batch mode, only validate output folder and codec
-    if (!m_trackQueue.isEmpty()) {
+    if (!m_trackQueue.empty()) {
         QString output = m_outputEdit->text();
         
         if (output.isEmpty()) {
@@ -339,6 +568,11 @@ bool ConverterWidget::validateInput()
             return false;
         }
 
+        if (m_mirrorCheck->isChecked() && output == QStringLiteral("Same as source folder")) {
+            QMessageBox::warning(this, "Invalid Output", "Mirror mode needs an output folder.");
+            return false;
+        }
+
         // If output is not "Same as source folder", validate it's a valid directory
         if (output != QStringLiteral("Same as source folder") && !QDir(output).exists()) {
             QMessageBox::warning(this, "Invalid Output", "Selected output folder does not exist.");
@@ -353,6 +587,33 @@ bool ConverterWidget::validateInput()
             return false;
         }
 
+        for (const BatchJournal::Output& extra : std::as_const(m_extraOutputs)) {
+            if (m_mirrorCheck->isChecked()) {
+                QMessageBox::warning(this, "Invalid Output",
+                    "Mirror mode converts to one format. Remove the additional formats or turn mirror mode off.");
+                return false;
+            }
+            if (!m_manager->isCodecAvailable(extra.options.format)) {
+                QMessageBox::critical(this, "Codec Not Available",
+                    QString("The codec for %1 format is not available.\n"
+                            "Please install the required encoder.").arg(extra.options.format.toUpper()));
+                return false;
+            }
+            if (extra.options.format == format && extra.folder == output) {
+                QMessageBox::warning(this, "Invalid Output",
+                    QString("The additional %1 output would overwrite the main one, choose another folder.")
+                        .arg(format.toUpper()));
+                return false;
+            }
+        }
+
+        // Starting would replace the journal of the other batch
+        if (!m_journal->acquire(this)) {
+            QMessageBox::warning(this, "Conversion Running",
+                "Another batch conversion is running. Wait for it to finish or cancel it first.");
+            return false;
+        }
+
         return true;
     }
 
@@ -386,22 +647,8 @@ bool ConverterWidget::validateInput()
     return true;
 }
 
-void ConverterWidget::startConversion()
+ConversionOptions ConverterWidget::currentOptions() const
 {
-    // Check if batch mode
-    if (!m_trackQueue.isEmpty()) {
-        // Start batch conversion
-        m_currentTrackIndex = -1;
-        processNextTrack();
-        return;
-    }
-
-    // Single file conversion
-    if (!validateInput()) {
-        return;
-    }
-
-    // Build conversion options
     ConversionOptions options;
     options.format = getOutputExtension();
 
@@ -434,27 +681,100 @@ void ConverterWidget::startConversion()
 
     options.sampleRate = m_sampleRateSpin->value();
     options.channels = m_channelsCombo->currentData().toInt();
+    options.bitDepth = options.format == "flac" ? m_bitDepthCombo->currentData().toInt() : 0;
+    options.replayGain = m_replayGainCheck->isChecked();
+    options.passthrough = m_passthroughCheck->isChecked();
+
+    return options;
+}
+
+void ConverterWidget::applyOptions(const ConversionOptions& options)
+{
+    if (const int index = m_formatCombo->findData(options.format); index >= 0) {
+        // Fills the quality choices of the format
+        m_formatCombo->setCurrentIndex(index);
+    }
+
+    int qualityValue{0};
+    if (options.format == "mp3") {
+        qualityValue = options.quality >= 0 ? -100 - options.quality : options.bitrate;
+    } else if (options.format == "flac") {
+        qualityValue = options.compressionLevel;
+    } else if (options.format == "opus") {
+        qualityValue = options.bitrate;
+    } else if (options.format == "ogg") {
+        qualityValue = options.quality;
+    }
+    if (const int index = m_qualityCombo->findData(qualityValue); index >= 0) {
+        m_qualityCombo->setCurrentIndex(index);
+    }
+
+    m_sampleRateSpin->setValue(options.sampleRate);
+    if (const int index = m_channelsCombo->findData(options.channels); index >= 0) {
+        m_channelsCombo->setCurrentIndex(index);
+    }
+    if (const int index = m_bitDepthCombo->findData(options.bitDepth); index >= 0) {
+        m_bitDepthCombo->setCurrentIndex(index);
+    }
+    m_replayGainCheck->setChecked(options.replayGain);
+    m_passthroughCheck->setChecked(options.passthrough);
+}
+
+void ConverterWidget::startConversion()
+{
+    // Check if batch mode
+    if (!m_trackQueue.empty()) {
+        if (!validateInput()) {
+            return;
+        }
+        startBatch();
+        return;
+    }
+
+    // Single file conversion
+    if (!validateInput()) {
+        return;
+    }
 
     // Start conversion
     QString input = m_inputEdit->text();
     QString output = m_outputEdit->text();
 
-    m_manager->convertAsync(input, output, options);
+    // Keep the library metadata unless the input was changed by hand
+    const Fooyin::Track source = m_sourceTrack.filepath() == input ? m_sourceTrack : Fooyin::Track{input};
+
+    onStarted();
+    m_singleJobId = m_manager->convertAsync(source, output, currentOptions());
 }
 
 void ConverterWidget::cancelConversion()
 {
     m_manager->cancel();
     m_isConverting = false;
+
+    // Keeps what was converted before the cancel
+    saveMirrorManifest();
+    m_mirrorManifest.reset();
+    m_mirrorPending.clear();
+    m_jobKeys.clear();
+    m_retagOutputs.clear();
+    // Canceled on purpose, nothing to resume
+    releaseJournal();
     m_statusLabel->setText("Conversion canceled");
     m_progressBar->setValue(0);
     m_convertButton->setEnabled(true);
     m_cancelButton->setEnabled(false);
 
+    m_singleJobId = -1;
+
     // Clear batch queue if in batch mode
-    if (!m_trackQueue.isEmpty()) {
+    if (!m_trackQueue.empty()) {
         m_trackQueue.clear();
-        m_currentTrackIndex = -1;
+        m_batchJobs.clear();
+        m_jobTracks.clear();
+        m_jobProgress.clear();
+        m_completedTracks = 0;
+        m_failedTracks = 0;
         m_totalTracks = 0;
         
         // Restore UI to single file mode
@@ -474,38 +794,129 @@ void ConverterWidget::onStarted()
     m_progressBar->setValue(0);
 }
 
-void ConverterWidget::onProgress(int percent)
+void ConverterWidget::onJobStarted(int jobId, const QString& inputPath)
 {
+    if (!m_batchJobs.contains(jobId)) {
+        return;
+    }
+
+    m_jobProgress.insert(jobId, 0);
+    m_currentFilename = QFileInfo(inputPath).fileName();
+    for (const QString& key : m_jobKeys.value(jobId)) {
+        m_journal->record(key, BatchJournal::State::Running);
+    }
+    updateBatchStatus();
+}
+
+void ConverterWidget::onProgress(int jobId, int percent)
+{
+    if (m_batchJobs.contains(jobId)) {
+        m_jobProgress.insert(jobId, percent);
+        m_batchProgress.setProgress(jobId, percent);
+        updateBatchStatus();
+        return;
+    }
+
+    if (jobId != m_singleJobId) {
+        return;
+    }
+
+    // Single file mode
     m_progressBar->setValue(percent);
+    m_statusLabel->setText(QString("Converting... %1%").arg(percent));
+}
 
-    // In batch mode, show the filename with progress
-    if (!m_trackQueue.isEmpty() && m_currentTrackIndex >= 0) {
-        m_statusLabel->setText(QString("Converting %1 of %2: %3 (%4%)")
-            .arg(m_currentTrackIndex + 1)
+void ConverterWidget::updateBatchStatus()
+{
+    if (m_totalTracks <= 0) {
+        return;
+    }
+
+    const BatchProgress::Status status = m_batchProgress.status();
+
+    if (m_batchProgress.hasDuration()) {
+        m_progressBar->setValue(qBound(0, static_cast<int>(status.fraction * 100), 100));
+    } else {
+        // Nothing to weigh by (only retags): count finished tracks fully and running tracks by their percent
+        int progressSum = m_completedTracks * 100;
+        for (auto it = m_jobProgress.cbegin(); it != m_jobProgress.cend(); ++it) {
+            progressSum += it.value() * m_jobTracks.value(it.key(), 1);
+        }
+        m_progressBar->setValue(progressSum / m_totalTracks);
+    }
+
+    const int current = qMin(m_completedTracks + 1, m_totalTracks);
+    QString text;
+    if (m_jobProgress.size() > 1) {
+        text = QString("Converting %1 of %2 (%3 running): %4")
+            .arg(current)
             .arg(m_totalTracks)
-            .arg(m_currentFilename)
-            .arg(percent));
+            .arg(m_jobProgress.size())
+            .arg(m_currentFilename);
     } else {
-        // Single file mode
-        m_statusLabel->setText(QString("Converting... %1%").arg(percent));
+        text = QString("Converting %1 of %2: %3")
+            .arg(current)
+            .arg(m_totalTracks)
+            .arg(m_currentFilename);
+    }
+
+    if (status.realtime > 0) {
+        text += QString(" - %1x realtime, %2 MB/s")
+            .arg(status.realtime, 0, 'f', 1)
+            .arg(status.bytesPerSecond / (1024.0 * 1024.0), 0, 'f', 1);
+        if (status.remainingMs >= 0) {
+            text += QString(", %1 left").arg(formatRemaining(status.remainingMs));
+        }
     }
+    m_statusLabel->setText(text);
 }
 
-void ConverterWidget::onFinished(bool success, const QString& error)
+void ConverterWidget::onFinished(int jobId, bool success, const QString& error)
 {
     // Check if batch mode
-    if (!m_trackQueue.isEmpty() && m_currentTrackIndex >= 0) {
+    if (m_batchJobs.contains(jobId)) {
+        // A CUE image job covers several tracks
+        const int tracks = m_jobTracks.take(jobId);
+        const int jobTracks = tracks > 0 ? tracks : 1;
+
         if (!success) {
-            // Show error but continue with next
+            // Show error but continue with the rest of the queue
             qWarning() << "Track conversion failed:" << error;
+            m_failedTracks += jobTracks;
+        }
+
+        // Reported once the last tags are written and the outputs published, so done means complete
+        const QStringList keys = m_jobKeys.take(jobId);
+        for (const QString& key : keys) {
+            m_journal->record(key, success ? BatchJournal::State::Done : BatchJournal::State::Failed);
+        }
+
+        // Converted sources are skipped by the next mirror run
+        if (success && m_mirrorManifest) {
+            for (const QString& key : keys) {
+                m_mirrorManifest->insert(m_mirrorPending.take(key));
+            }
         }
 
-        // Process next track
-        processNextTrack();
+        m_batchJobs.remove(jobId);
+        m_jobProgress.remove(jobId);
+        m_batchProgress.finishJob(jobId);
+        m_completedTracks += jobTracks;
+
+        if (m_batchJobs.isEmpty() && m_retagOutputs.isEmpty()) {
+            finishBatch();
+        } else {
+            updateBatchStatus();
+        }
+        return;
+    }
+
+    if (jobId != m_singleJobId) {
         return;
     }
 
     // Single file mode - conversion complete
+    m_singleJobId = -1;
     m_isConverting = false;
     m_convertButton->setEnabled(true);
     m_cancelButton->setEnabled(false);
@@ -523,11 +934,76 @@ void ConverterWidget::onFinished(bool success, const QString& error)
     }
 }
 
-void ConverterWidget::loadTrack(const QString& filepath)
+void ConverterWidget::onRetagged(const QString& outputPath, bool success)
 {
+    const auto it = m_retagOutputs.constFind(outputPath);
+    if (it == m_retagOutputs.cend()) {
+        return;
+    }
+    const QString key = it.value();
+    m_retagOutputs.erase(it);
+
+    // A failed output keeps its manifest entry and is retagged again next time
+    const MirrorManifest::Entry entry = m_mirrorPending.take(key);
+    if (success) {
+        m_mirrorManifest->insert(entry);
+    } else {
+        ++m_failedTracks;
+    }
+
+    ++m_completedTracks;
+    m_currentFilename = QFileInfo(outputPath).fileName();
+
+    if (m_batchJobs.isEmpty() && m_retagOutputs.isEmpty()) {
+        finishBatch();
+    } else {
+        updateBatchStatus();
+    }
+}
+
+void ConverterWidget::releaseJournal()
+{
+    // A journal held by the batch of another converter is left alone
+    if (m_journal->isHeldBy(this)) {
+        m_journal->remove();
+    }
+}
+
+void ConverterWidget::finishBatch()
+{
+    // All done - batch conversion complete
+    m_isConverting = false;
+    saveMirrorManifest();
+    releaseJournal();
+    m_progressBar->setValue(100);
+    m_convertButton->setEnabled(true);
+    m_cancelButton->setEnabled(false);
+
+    const int converted = m_totalTracks - m_failedTracks;
+    m_statusLabel->setText(QString("Batch conversion completed! (%1 of %2 files)").arg(converted).arg(m_totalTracks));
+
+    if (m_failedTracks > 0) {
+        QMessageBox::warning(this, "Batch Conversion Complete",
+            QString("Converted %1 of %2 files.\n%3 file(s) failed to convert.")
+                .arg(converted).arg(m_totalTracks).arg(m_failedTracks));
+    } else {
+        QMessageBox::information(this, "Batch Conversion Complete",
+            QString("Successfully converted %1 files!").arg(m_totalTracks));
+    }
+}
+
+void ConverterWidget::loadTrack(const Fooyin::Track& track)
+{
+    const QString filepath = track.filepath();
+    m_sourceTrack = track;
+
     // Clear batch queue
     m_trackQueue.clear();
-    m_currentTrackIndex = -1;
+    m_batchJobs.clear();
+    m_jobTracks.clear();
+    m_jobProgress.clear();
+    m_resumedOutputs.clear();
+    m_resumedMirrorRoot.clear();
     m_totalTracks = 0;
 
     // Set the input file and re-enable editing
@@ -541,6 +1017,7 @@ void ConverterWidget::loadTrack(const QString& filepath)
                        + "." + getOutputExtension();
     m_outputEdit->setText(outputPath);
     m_outputEdit->setEnabled(true);
+    m_extraOutputsGroup->setEnabled(false);
 
     // Reset progress and status
     m_progressBar->setValue(0);
@@ -551,16 +1028,21 @@ void ConverterWidget::loadTrack(const QString& filepath)
     m_cancelButton->setEnabled(false);
 }
 
-void ConverterWidget::loadTracks(const QStringList& filepaths)
+void ConverterWidget::loadTracks(const Fooyin::TrackList& tracks)
 {
-    if (filepaths.isEmpty()) {
+    if (tracks.empty()) {
         return;
     }
 
     // Store tracks for batch processing
-    m_trackQueue = filepaths;
-    m_currentTrackIndex = -1;
-    m_totalTracks = filepaths.size();
+    m_trackQueue = tracks;
+    m_sourceTrack = {};
+    m_batchJobs.clear();
+    m_jobTracks.clear();
+    m_jobProgress.clear();
+    m_resumedOutputs.clear();
+    m_resumedMirrorRoot.clear();
+    m_totalTracks = static_cast<int>(tracks.size());
 
     // Set input to show batch info and disable editing
     m_inputEdit->setText(QString("%1 files selected").arg(m_totalTracks));
@@ -569,6 +1051,7 @@ void ConverterWidget::loadTracks(const QStringList& filepaths)
     // Show "Same as source folder" but keep it enabled for folder selection
     m_outputEdit->setText(QStringLiteral("Same as source folder"));
     m_outputEdit->setEnabled(true);
+    m_extraOutputsGroup->setEnabled(true);
 
     // Reset progress and status
     m_progressBar->setValue(0);
@@ -579,81 +1062,367 @@ void ConverterWidget::loadTracks(const QStringList& filepaths)
     m_cancelButton->setEnabled(false);
 }
 
-void ConverterWidget::processNextTrack()
+void ConverterWidget::resumeBatch(const BatchJournal::Interrupted& batch)
 {
-    m_currentTrackIndex++;
+    Fooyin::TrackList tracks;
+    QHash<QString, qint64> done;
+    for (const BatchJournal::Source& source : batch.sources) {
+        tracks.push_back(source.track);
+        if (source.state == BatchJournal::State::Done) {
+            done.insert(source.key, source.outputSize);
+        }
+    }
 
-    if (m_currentTrackIndex >= m_trackQueue.size()) {
-        // All done - batch conversion complete
-        m_isConverting = false;
-        m_progressBar->setValue(100);
-        m_statusLabel->setText(QString("Batch conversion completed! (%1 files)").arg(m_totalTracks));
-        m_convertButton->setEnabled(true);
-        m_cancelButton->setEnabled(false);
+    // Same tracks, options and folder as before, so every output keeps its path
+    loadTracks(tracks);
+    applyOptions(batch.batch.options);
+    m_outputEdit->setText(batch.batch.outputFolder);
+    m_mirrorCheck->setChecked(batch.batch.mirror);
+    setExtraOutputs(batch.batch.extraOutputs);
+    m_resumedOutputs = done;
+    m_resumedMirrorRoot = batch.batch.mirrorRoot;
+
+    qInfo() << "Audio Converter - Resuming batch of" << tracks.size() << "files," << done.size() << "already done";
+    startConversion();
+}
 
-        QMessageBox::information(this, "Batch Conversion Complete",
-            QString("Successfully converted %1 files!").arg(m_totalTracks));
-        return;
-    }
+QString ConverterWidget::batchOutputPath(const QString& inputPath) const
+{
+    return batchOutputPath(inputPath, m_outputEdit->text(), getOutputExtension());
+}
 
-    // Get current track
-    QString inputPath = m_trackQueue[m_currentTrackIndex];
+QString ConverterWidget::batchOutputPath(const QString& inputPath, const QString& folder,
+                                         const QString& extension) const
+{
     QFileInfo info(inputPath);
 
-    // Store current filename for progress updates
-    m_currentFilename = info.fileName();
-
     // Generate output path - use selected folder or same as source
-    QString outputPath;
-    QString outputDir = m_outputEdit->text();
-    
-    if (outputDir == QStringLiteral("Same as source folder")) {
+    if (folder == QStringLiteral("Same as source folder")) {
         // Use same directory as source file
-        outputPath = info.absolutePath() + "/" + info.completeBaseName() + "." + getOutputExtension();
-    } else {
-        // Use selected output folder
-        outputPath = outputDir + "/" + info.completeBaseName() + "." + getOutputExtension();
+        return info.absolutePath() + "/" + info.completeBaseName() + "." + extension;
     }
 
-    // Update status (progress updates will add percentage)
-    m_statusLabel->setText(QString("Converting %1 of %2: %3")
-        .arg(m_currentTrackIndex + 1)
-        .arg(m_totalTracks)
-        .arg(m_currentFilename));
+    // Mirror mode keeps the folder structure below the sources' common folder
+    if (!m_mirrorRoot.isEmpty()) {
+        const QString relative = QDir(m_mirrorRoot).relativeFilePath(info.absolutePath());
+        return QDir::cleanPath(folder + "/" + relative + "/" + info.completeBaseName() + "." + extension);
+    }
 
-    // Build options
-    ConversionOptions options;
-    options.format = getOutputExtension();
+    // Use selected output folder
+    return folder + "/" + info.completeBaseName() + "." + extension;
+}
 
-    int qualityValue = m_qualityCombo->currentData().toInt();
-    if (options.format == "mp3") {
-        if (qualityValue < 0) {
-            options.quality = -qualityValue - 100;
-            options.bitrate = 0;
+QString ConverterWidget::trackOutputPath(const Fooyin::Track& track) const
+{
+    return trackOutputPath(track, m_outputEdit->text(), getOutputExtension());
+}
+
+QString ConverterWidget::trackOutputPath(const Fooyin::Track& track, const QString& folder,
+                                         const QString& extension) const
+{
+    // A single track of an image is still named after the track, not the image
+    return track.hasCue() ? imageTrackOutputPath(track, folder, extension)
+                          : batchOutputPath(track.filepath(), folder, extension);
+}
+
+QString ConverterWidget::imageTrackOutputPath(const Fooyin::Track& track) const
+{
+    return imageTrackOutputPath(track, m_outputEdit->text(), getOutputExtension());
+}
+
+QString ConverterWidget::imageTrackOutputPath(const Fooyin::Track& track, const QString& folder,
+                                              const QString& extension) const
+{
+    // The tracks of an image share its file name, so they are named by number and title
+    QString name = track.trackNumber().rightJustified(2, u'0');
+    if (!track.title().isEmpty()) {
+        name += " - " + track.title();
+    }
+
+    static const QRegularExpression invalidChars{QStringLiteral(R"([/\\:*?"<>|])")};
+    name.replace(invalidChars, QStringLiteral("_"));
+
+    const QString outputDir = QFileInfo(batchOutputPath(track.filepath(), folder, extension)).absolutePath();
+    return outputDir + "/" + name + "." + extension;
+}
+
+QList<ConversionTarget> ConverterWidget::trackTargets(const Fooyin::Track& track,
+                                                      const ConversionOptions& options) const
+{
+    QList<ConversionTarget> targets{{trackOutputPath(track), options}};
+    for (const BatchJournal::Output& extra : m_extraOutputs) {
+        targets.append({trackOutputPath(track, extra.folder, extra.options.format), extra.options});
+    }
+    return targets;
+}
+
+void ConverterWidget::addExtraOutput()
+{
+    const ConversionOptions options = currentOptions();
+    const QString folder = m_outputEdit->text();
+    if (options.format.isEmpty() || folder.isEmpty()) {
+        return;
+    }
+
+    for (const BatchJournal::Output& extra : std::as_const(m_extraOutputs)) {
+        if (extra.options.format == options.format && extra.folder == folder) {
+            QMessageBox::information(this, "Already Added",
+                QString("%1 output to this folder is in the list already.").arg(options.format.toUpper()));
+            return;
+        }
+    }
+
+    m_extraOutputs.append({options, folder});
+    m_extraOutputList->addItem(describeOutput(m_extraOutputs.constLast()));
+}
+
+void ConverterWidget::removeExtraOutput()
+{
+    const int row = m_extraOutputList->currentRow();
+    if (row < 0) {
+        return;
+    }
+
+    m_extraOutputs.removeAt(row);
+    delete m_extraOutputList->takeItem(row);
+}
+
+void ConverterWidget::setExtraOutputs(const QList<BatchJournal::Output>& outputs)
+{
+    m_extraOutputs = outputs;
+    m_extraOutputList->clear();
+    for (const BatchJournal::Output& output : outputs) {
+        m_extraOutputList->addItem(describeOutput(output));
+    }
+}
+
+void ConverterWidget::startBatch()
+{
+    m_batchJobs.clear();
+    m_jobTracks.clear();
+    m_jobProgress.clear();
+    m_completedTracks = 0;
+    m_failedTracks = 0;
+    m_totalTracks = static_cast<int>(m_trackQueue.size());
+
+    m_mirrorManifest.reset();
+    m_mirrorRoot.clear();
+    m_mirrorPending.clear();
+    m_jobKeys.clear();
+    m_retagOutputs.clear();
+
+    onStarted();
+
+    if (m_mirrorCheck->isChecked()) {
+        startMirror();
+        return;
+    }
+
+    m_statusLabel->setText(QString("Converting %1 files...").arg(m_totalTracks));
+    queueBatch(m_trackQueue);
+}
+
+void ConverterWidget::startMirror()
+{
+    const QString outputDir = m_outputEdit->text();
+    // A resumed batch may hold just the files left of a larger mirror run
+    m_mirrorRoot = m_resumedMirrorRoot.isEmpty() ? commonFolder(m_trackQueue) : std::exchange(m_resumedMirrorRoot, {});
+
+    m_mirrorManifest = std::make_shared<MirrorManifest>(outputDir + "/" + MirrorManifestName);
+    if (QString error; !m_mirrorManifest->load(error)) {
+        // Converts everything again and writes a fresh manifest
+        qWarning() << "Audio Converter -" << error;
+        m_mirrorManifest = std::make_shared<MirrorManifest>(outputDir + "/" + MirrorManifestName);
+    }
+
+    const ConversionOptions options = currentOptions();
+    const uint64_t optionsHash = MirrorManifest::optionsHash(options, m_manager->codecVersion(options.format));
+    const bool fingerprint = m_settings && m_settings->value<ConverterSettings::MirrorVerifyContent>();
+
+    QList<MirrorSource> sources;
+    sources.reserve(static_cast<qsizetype>(m_trackQueue.size()));
+    for (const Fooyin::Track& track : m_trackQueue) {
+        sources.append({mirrorKey(track), track.filepath(), trackOutputPath(track), track.fileSize(),
+                        static_cast<int64_t>(track.modifiedTime())});
+    }
+
+    m_statusLabel->setText(QString("Checking %1 files against the mirror...").arg(m_totalTracks));
+
+    // Stats every output, which takes a while on network shares
+    auto* watcher = new QFutureWatcher<MirrorPlan>(this);
+    connect(watcher, &QFutureWatcher<MirrorPlan>::finished, this, [this, watcher, manifest = m_mirrorManifest]() {
+        watcher->deleteLater();
+        // Canceled or restarted meanwhile
+        if (!m_isConverting || manifest != m_mirrorManifest) {
+            return;
+        }
+
+        const MirrorPlan plan = watcher->result();
+
+        Fooyin::TrackList stale;
+        for (qsizetype i = 0; i < plan.stale.size(); ++i) {
+            const Fooyin::Track& track = m_trackQueue.at(static_cast<size_t>(plan.stale.at(i)));
+            stale.push_back(track);
+            m_mirrorPending.insert(mirrorKey(track), plan.pending.at(i));
+        }
+
+        // Same audio as when converted: only the tags of the output are rewritten
+        Fooyin::TrackList retag;
+        QStringList retagPaths;
+        for (qsizetype i = 0; i < plan.retag.size(); ++i) {
+            const Fooyin::Track& track = m_trackQueue.at(static_cast<size_t>(plan.retag.at(i)));
+            const QString outputPath = trackOutputPath(track);
+            retag.push_back(track);
+            retagPaths.append(outputPath);
+            m_retagOutputs.insert(outputPath, mirrorKey(track));
+            m_mirrorPending.insert(mirrorKey(track), plan.retagged.at(i));
+        }
+
+        const int upToDate = m_totalTracks - static_cast<int>(stale.size() + retag.size());
+        qInfo() << "Audio Converter - Mirror:" << upToDate << "of" << m_totalTracks << "files up to date,"
+                << retag.size() << "with changed tags only";
+
+        if (stale.empty() && retag.empty()) {
+            saveMirrorManifest();
+            releaseJournal();
+            m_isConverting = false;
+            m_progressBar->setValue(100);
+            m_convertButton->setEnabled(true);
+            m_cancelButton->setEnabled(false);
+            m_statusLabel->setText(QString("Mirror is up to date (%1 files)").arg(m_totalTracks));
+            return;
+        }
+
+        m_totalTracks = static_cast<int>(stale.size() + retag.size());
+
+        m_statusLabel->setText(QString("Converting %1 new or changed files, retagging %2...")
+                                   .arg(stale.size())
+                                   .arg(retag.size()));
+        m_manager->retagAsync(retag, retagPaths, currentOptions());
+        queueBatch(stale);
+    });
+
+    watcher->setFuture(QtConcurrent::run([manifest = m_mirrorManifest, sources, optionsHash, fingerprint]() {
+        return planMirror(*manifest, sources, optionsHash, fingerprint);
+    }));
+}
+
+void ConverterWidget::queueBatch(const Fooyin::TrackList& tracks)
+{
+    // Queue every track up front; the manager runs as many at once as it has slots for
+    const ConversionOptions options = currentOptions();
+
+    // Outputs finished before a resumed batch was interrupted are kept
+    Fooyin::TrackList pending;
+    QList<BatchJournal::Source> sources;
+    for (const Fooyin::Track& track : tracks) {
+        const QString key = mirrorKey(track);
+        BatchJournal::Source source{key, trackOutputPath(track), track};
+        for (const BatchJournal::Output& extra : std::as_const(m_extraOutputs)) {
+            source.extraOutputPaths.append(trackOutputPath(track, extra.folder, extra.options.format));
+        }
+
+        if (const auto done = m_resumedOutputs.constFind(key); done != m_resumedOutputs.cend()) {
+            source.state = BatchJournal::State::Done;
+            source.outputSize = done.value();
+            ++m_completedTracks;
+            if (m_mirrorManifest && m_mirrorPending.contains(key)) {
+                m_mirrorManifest->insert(m_mirrorPending.take(key));
+            }
         } else {
-            options.bitrate = qualityValue;
-            options.quality = -1;
+            pending.push_back(track);
         }
+        sources.append(source);
     }
-    else if (options.format == "flac") {
-        options.compressionLevel = qualityValue;
-        options.bitrate = 0;
-        options.quality = -1;
+    m_resumedOutputs.clear();
+
+    m_batchProgress.start();
+    m_journal->start({options, m_outputEdit->text(), m_mirrorManifest != nullptr, m_mirrorRoot, m_extraOutputs},
+                     sources);
+
+    // CUE images are decoded once and split into all their selected tracks (in every format) in one job
+    Fooyin::TrackList singleFiles;
+    const QList<Fooyin::TrackList> images = cueImages(pending, singleFiles);
+
+    for (const Fooyin::TrackList& image : images) {
+        QList<QList<ConversionTarget>> targets;
+        for (const Fooyin::Track& track : image) {
+            targets.append(trackTargets(track, options));
+        }
+        addBatchJob(m_manager->convertImageAsync(image, targets), image);
     }
-    else if (options.format == "opus") {
-        options.bitrate = qualityValue;
-        options.quality = -1;
+
+    // Whole albums are queued as a unit so they get album gain without a second pass
+    const bool replayGain = options.replayGain
+                         || std::any_of(m_extraOutputs.cbegin(), m_extraOutputs.cend(),
+                                        [](const BatchJournal::Output& extra) { return extra.options.replayGain; });
+    Fooyin::TrackList looseTracks;
+    QList<Fooyin::TrackList> albums;
+    if (replayGain) {
+        albums = completeAlbums(singleFiles, looseTracks);
+    } else {
+        looseTracks = singleFiles;
     }
-    else if (options.format == "ogg") {
-        options.quality = qualityValue;
-        options.bitrate = 0;
+
+    for (const Fooyin::TrackList& album : std::as_const(albums)) {
+        QList<QList<ConversionTarget>> targets;
+        for (const Fooyin::Track& track : album) {
+            targets.append(trackTargets(track, options));
+        }
+        const QList<int> jobIds = m_manager->convertAlbumAsync(album, targets);
+        for (qsizetype i = 0; i < jobIds.size(); ++i) {
+            addBatchJob(jobIds.at(i), {album.at(static_cast<size_t>(i))});
+        }
     }
 
-    options.sampleRate = m_sampleRateSpin->value();
-    options.channels = m_channelsCombo->currentData().toInt();
+    for (const Fooyin::Track& track : std::as_const(looseTracks)) {
+        addBatchJob(m_manager->convertAsync(track, trackTargets(track, options)), {track});
+    }
 
-    // Start conversion
-    m_manager->convertAsync(inputPath, outputPath, options);
+    // Everything was done already
+    if (m_batchJobs.isEmpty() && m_retagOutputs.isEmpty()) {
+        finishBatch();
+    }
+}
+
+void ConverterWidget::addBatchJob(int jobId, const Fooyin::TrackList& tracks)
+{
+    m_batchJobs.insert(jobId);
+    if (tracks.size() > 1) {
+        m_jobTracks.insert(jobId, static_cast<int>(tracks.size()));
+    }
+
+    // Progress is weighted by audio length; the tracks of a CUE image read one file
+    uint64_t duration{0};
+    uint64_t bytes{0};
+    QSet<QString> files;
+    QStringList& keys = m_jobKeys[jobId];
+    for (const Fooyin::Track& track : tracks) {
+        keys.append(mirrorKey(track));
+
+        ConversionJob job;
+        job.inputPath = track.filepath();
+        job.track = track;
+        duration += job.audioDuration();
+
+        if (!files.contains(job.inputPath)) {
+            files.insert(job.inputPath);
+            bytes += track.fileSize() > 0 ? track.fileSize()
+                                          : static_cast<uint64_t>(QFileInfo{job.inputPath}.size());
+        }
+    }
+    m_batchProgress.addJob(jobId, duration, bytes);
+}
+
+void ConverterWidget::saveMirrorManifest()
+{
+    if (!m_mirrorManifest) {
+        return;
+    }
+
+    if (QString error; !m_mirrorManifest->save(error)) {
+        qWarning() << "Audio Converter -" << error;
+    }
 }
 
 void ConverterWidget::applyDefaultCodec()
@@ -1,17 +1,32 @@
 #pragma once
 
+#include "batchjournal.h"
+#include "batchprogress.h"
+#include "codecwrapper.h"
+#include "conversionjob.h"
+#include "mirrormanifest.h"
+
+#include <core/track.h>
 #include <gui/fywidget.h>
 
+#include <QHash>
+#include <QSet>
+
+#include <memory>
+
 namespace Fooyin {
 class SettingsManager;
 }
 
 class ConversionManager;
 class QLineEdit;
+class QCheckBox;
 class QComboBox;
+class QGroupBox;
 class QProgressBar;
 class QPushButton;
 class QLabel;
+class QListWidget;
 class QSpinBox;
 
 class ConverterWidget : public Fooyin::FyWidget
@@ -19,13 +34,17 @@ class ConverterWidget : public Fooyin::FyWidget
     Q_OBJECT
 
 public:
-    explicit ConverterWidget(ConversionManager* manager, Fooyin::SettingsManager* settings = nullptr, QWidget* parent = nullptr);
+    // journal is shared by every converter, only one of them runs a batch at a time
+    ConverterWidget(ConversionManager* manager, BatchJournal* journal, Fooyin::SettingsManager* settings = nullptr,
+                    QWidget* parent = nullptr);
 
     [[nodiscard]] QString name() const override { return QStringLiteral("Audio Converter"); }
     [[nodiscard]] QString layoutName() const override { return QStringLiteral("AudioConverter"); }
 
-    void loadTrack(const QString& filepath);
-    void loadTracks(const QStringList& filepaths);
+    void loadTrack(const Fooyin::Track& track);
+    void loadTracks(const Fooyin::TrackList& tracks);
+    // Continues a batch cut short by a crash or by quitting, skipping outputs already done
+    void resumeBatch(const BatchJournal::Interrupted& batch);
 
 protected:
     void closeEvent(QCloseEvent* event) override;
@@ -37,18 +56,43 @@ private slots:
     void startConversion();
     void cancelConversion();
     void onFormatChanged(int index);
-    void onProgress(int percent);
-    void onFinished(bool success, const QString& error);
+    void onProgress(int jobId, int percent);
+    void onFinished(int jobId, bool success, const QString& error);
+    void onJobStarted(int jobId, const QString& inputPath);
+    void onRetagged(const QString& outputPath, bool success);
+    void onCodecsReady();
     void onStarted();
+    void addExtraOutput();
+    void removeExtraOutput();
 
 private:
     void setupUI();
     QString getOutputExtension() const;
     void updateOutputPath();
     void updateQualityOptions();
+    void populateFormats();
     void updateCodecInfo();
     bool validateInput();
-    void processNextTrack();
+    ConversionOptions currentOptions() const;
+    void applyOptions(const ConversionOptions& options);
+    QString batchOutputPath(const QString& inputPath) const;
+    QString batchOutputPath(const QString& inputPath, const QString& folder, const QString& extension) const;
+    QString imageTrackOutputPath(const Fooyin::Track& track) const;
+    QString imageTrackOutputPath(const Fooyin::Track& track, const QString& folder, const QString& extension) const;
+    QString trackOutputPath(const Fooyin::Track& track) const;
+    QString trackOutputPath(const Fooyin::Track& track, const QString& folder, const QString& extension) const;
+    // The main output of track and one per additional format
+    QList<ConversionTarget> trackTargets(const Fooyin::Track& track, const ConversionOptions& options) const;
+    void setExtraOutputs(const QList<BatchJournal::Output>& outputs);
+    void startBatch();
+    void startMirror();
+    void queueBatch(const Fooyin::TrackList& tracks);
+    void addBatchJob(int jobId, const Fooyin::TrackList& tracks);
+    void saveMirrorManifest();
+    void updateBatchStatus();
+    void finishBatch();
+    // Drops the journal if this converter's batch holds it
+    void releaseJournal();
     void applyDefaultCodec();
 
     ConversionManager* m_manager;
@@ -57,11 +101,35 @@ private:
     // Conversion state
     bool m_isConverting{false};
 
+    // Single file conversion
+    Fooyin::Track m_sourceTrack;
+    int m_singleJobId{-1};
+
     // Batch conversion
-    QStringList m_trackQueue;
-    int m_currentTrackIndex{-1};
+    Fooyin::TrackList m_trackQueue;
+    QSet<int> m_batchJobs;             // job ids queued by this widget
+    QHash<int, int> m_jobTracks;       // job id -> tracks it converts, if more than one (CUE images)
+    QHash<int, int> m_jobProgress;     // job id -> percent, running jobs only
+    QHash<int, QStringList> m_jobKeys; // job id -> source keys
+    int m_completedTracks{0};
+    int m_failedTracks{0};
     int m_totalTracks{0};
     QString m_currentFilename;
+    BatchProgress m_batchProgress; // Duration-weighted progress, throughput and time left
+
+    // Mirror mode: only new or changed sources are converted
+    std::shared_ptr<MirrorManifest> m_mirrorManifest;
+    QString m_mirrorRoot; // Common folder of the sources, mirrored below the output folder
+    QHash<QString, MirrorManifest::Entry> m_mirrorPending; // source key -> entry once converted
+    QHash<QString, QString> m_retagOutputs;                // output path -> source key, being retagged
+
+    // Further formats every source of a batch is encoded to, from the same decode
+    QList<BatchJournal::Output> m_extraOutputs;
+
+    // Job states of the running batch, kept on disk to resume it after a crash. Owned by the plugin.
+    BatchJournal* m_journal;
+    QHash<QString, qint64> m_resumedOutputs; // source key -> output size, done before the batch was interrupted
+    QString m_resumedMirrorRoot;
 
     // UI elements
     QLineEdit* m_inputEdit;
@@ -70,6 +138,12 @@ private:
     QComboBox* m_qualityCombo;
     QSpinBox* m_sampleRateSpin;
     QComboBox* m_channelsCombo;
+    QComboBox* m_bitDepthCombo;
+    QCheckBox* m_replayGainCheck;
+    QCheckBox* m_passthroughCheck;
+    QCheckBox* m_mirrorCheck;
+    QGroupBox* m_extraOutputsGroup;
+    QListWidget* m_extraOutputList;
     QProgressBar* m_progressBar;
     QPushButton* m_convertButton;
     QPushButton* m_cancelButton;
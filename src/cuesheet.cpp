@@ -0,0 +1,45 @@
+#include "cuesheet.h"
+
+#include <QFile>
+#include <QRegularExpression>
+
+QList<CueIndex> readCueSheet(const QString& path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return {};
+    }
+
+    static const QRegularExpression fileRegex{QStringLiteral(R"(^FILE\s+"?(.*?)"?\s+\S+$)"),
+                                              QRegularExpression::CaseInsensitiveOption};
+    static const QRegularExpression trackRegex{QStringLiteral(R"(^TRACK\s+(\d+)\s+AUDIO)"),
+                                               QRegularExpression::CaseInsensitiveOption};
+    static const QRegularExpression indexRegex{QStringLiteral(R"(^INDEX\s+01\s+(\d+):(\d+):(\d+))"),
+                                               QRegularExpression::CaseInsensitiveOption};
+
+    QList<CueIndex> indexes;
+    QString currentFile;
+    int currentTrack{0};
+
+    // Only file names and numbers are used, so the text encoding of the sheet hardly matters
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+
+        if (const auto match = fileRegex.match(line); match.hasMatch()) {
+            currentFile = match.captured(1);
+            currentTrack = 0;
+        }
+        else if (const auto match = trackRegex.match(line); match.hasMatch()) {
+            currentTrack = match.captured(1).toInt();
+        }
+        else if (const auto match = indexRegex.match(line); match.hasMatch() && currentTrack > 0) {
+            const int64_t minutes = match.captured(1).toLongLong();
+            const int64_t seconds = match.captured(2).toLongLong();
+            const int64_t frames = match.captured(3).toLongLong();
+            indexes.append({currentFile, currentTrack, (minutes * 60 + seconds) * 75 + frames});
+            currentTrack = 0;
+        }
+    }
+
+    return indexes;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+
+#include <cstdint>
+
+// Where one track of a CUE sheet starts (INDEX 01), in CD frames of 1/75 s
+struct CueIndex {
+    QString file; // FILE entry the track belongs to
+    int track{0};
+    int64_t start{0};
+};
+
+// Reads the start of every track in a CUE sheet. Returns an empty list if the
+// sheet cannot be read.
+QList<CueIndex> readCueSheet(const QString& path);
+
+// Converts a CUE position to sample frames; exact for every rate divisible by 75
+inline uint64_t cueToFrames(int64_t cdFrames, int sampleRate)
+{
+    return static_cast<uint64_t>(cdFrames) * static_cast<uint64_t>(sampleRate) / 75;
+}
@@ -0,0 +1,188 @@
+#include "decodersource.h"
+#include "dspkernels.h"
+
+#include <core/engine/audiobuffer.h>
+#include <core/engine/audioformat.h>
+#include <core/engine/audioinput.h>
+#include <core/engine/audioloader.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr size_t ReadBytes = 64 * 1024;
+// Library durations of some formats are estimates, shorter input within this is accepted
+constexpr uint64_t ShortInputToleranceMs = 1000;
+constexpr uint64_t ShortInputTolerancePercent = 1;
+
+void toFloat(const std::byte* in, float* out, size_t samples, Fooyin::SampleFormat format)
+{
+    switch (format) {
+        case Fooyin::SampleFormat::U8: {
+            const auto* src = reinterpret_cast<const uint8_t*>(in);
+            for (size_t i = 0; i < samples; ++i) {
+                out[i] = (static_cast<int>(src[i]) - 128) / 128.0F;
+            }
+            break;
+        }
+        case Fooyin::SampleFormat::S16:
+            Dsp::int16ToFloat(reinterpret_cast<const int16_t*>(in), out, samples);
+            break;
+        case Fooyin::SampleFormat::S24In32:
+            Dsp::int24In32ToFloat(reinterpret_cast<const int32_t*>(in), out, samples);
+            break;
+        case Fooyin::SampleFormat::S32:
+            Dsp::int32ToFloat(reinterpret_cast<const int32_t*>(in), out, samples);
+            break;
+        case Fooyin::SampleFormat::F32:
+            std::memcpy(out, in, samples * sizeof(float));
+            break;
+        case Fooyin::SampleFormat::F64: {
+            const auto* src = reinterpret_cast<const double*>(in);
+            for (size_t i = 0; i < samples; ++i) {
+                out[i] = static_cast<float>(src[i]);
+            }
+            break;
+        }
+        default:
+            std::fill(out, out + samples, 0.0F);
+            break;
+    }
+}
+
+int bitsForFormat(Fooyin::SampleFormat format)
+{
+    switch (format) {
+        case Fooyin::SampleFormat::U8:
+            return 8;
+        case Fooyin::SampleFormat::S16:
+            return 16;
+        case Fooyin::SampleFormat::S24In32:
+            return 24;
+        case Fooyin::SampleFormat::S32:
+            return 32;
+        case Fooyin::SampleFormat::F32:
+        case Fooyin::SampleFormat::F64:
+            return 24; // Precision of a float mantissa
+        default:
+            return 0;
+    }
+}
+} // namespace
+
+DecoderSource::DecoderSource(std::shared_ptr<Fooyin::AudioLoader> audioLoader, const Fooyin::Track& track)
+    : m_audioLoader{std::move(audioLoader)}
+    , m_track{track}
+{ }
+
+DecoderSource::~DecoderSource()
+{
+    if (m_decoder) {
+        m_decoder->stop();
+    }
+}
+
+bool DecoderSource::open(const QString& path)
+{
+    m_decoder = m_audioLoader->decoderForFile(path);
+    if (!m_decoder) {
+        m_error = "No fooyin decoder for " + path;
+        return false;
+    }
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = "Cannot open input file: " + m_file.errorString();
+        return false;
+    }
+
+    Fooyin::AudioSource source;
+    source.filepath = path;
+    source.device = &m_file;
+
+    const auto audioFormat = m_decoder->init(source, m_track, {});
+    if (!audioFormat || !audioFormat->isValid()) {
+        m_error = "Failed to decode " + path;
+        return false;
+    }
+
+    const auto sampleFormat = audioFormat->sampleFormat();
+    m_sampleFormat = static_cast<int>(sampleFormat);
+    m_format.sampleRate = audioFormat->sampleRate();
+    m_format.channels = audioFormat->channelCount();
+    m_format.bitsPerSample = m_track.bitDepth() > 0 ? m_track.bitDepth() : bitsForFormat(sampleFormat);
+
+    if (!m_format.isValid()) {
+        m_error = "Unsupported sample format in " + path;
+        return false;
+    }
+
+    m_decoder->start();
+
+    // Tracks from a CUE sheet are a slice of a larger file; the first one starts at offset 0
+    if (m_track.hasCue()) {
+        m_decoder->seek(m_track.offset());
+    }
+
+    m_totalFrames = m_track.duration() * static_cast<uint64_t>(m_format.sampleRate) / 1000;
+
+    return true;
+}
+
+int64_t DecoderSource::read(float* buffer, int64_t maxFrames)
+{
+    const int channels = m_format.channels;
+
+    // Don't run past the end of a CUE slice (a whole image has no duration and is read to the end)
+    if (m_track.hasCue() && m_totalFrames > 0) {
+        maxFrames = std::min<int64_t>(maxFrames, static_cast<int64_t>(m_totalFrames - m_framesRead));
+    }
+
+    int64_t framesCopied{0};
+
+    while (framesCopied < maxFrames) {
+        if (m_pendingPos >= m_pending.size()) {
+            const Fooyin::AudioBuffer decoded = m_decoder->readBuffer(ReadBytes);
+            if (!decoded.isValid() || decoded.frameCount() == 0) {
+                // The decoder doesn't tell errors from the end, a corrupt or truncated input stops early
+                if (framesCopied == 0 && endsEarly()) {
+                    m_error = QString("Decoding stopped at %1 of %2 s, the input is damaged or truncated")
+                                  .arg(m_framesRead / static_cast<uint64_t>(m_format.sampleRate))
+                                  .arg(m_totalFrames / static_cast<uint64_t>(m_format.sampleRate));
+                    return -1;
+                }
+                break;
+            }
+
+            const auto samples = static_cast<size_t>(decoded.frameCount()) * channels;
+            m_pending.resize(samples);
+            m_pendingPos = 0;
+            toFloat(decoded.constData().data(), m_pending.data(), samples,
+                    static_cast<Fooyin::SampleFormat>(m_sampleFormat));
+        }
+
+        const auto available = static_cast<int64_t>((m_pending.size() - m_pendingPos) / channels);
+        const int64_t frames = std::min(available, maxFrames - framesCopied);
+
+        std::memcpy(buffer + framesCopied * channels, m_pending.data() + m_pendingPos,
+                    static_cast<size_t>(frames * channels) * sizeof(float));
+
+        m_pendingPos += static_cast<size_t>(frames * channels);
+        framesCopied += frames;
+    }
+
+    m_framesRead += static_cast<uint64_t>(framesCopied);
+    return framesCopied;
+}
+
+bool DecoderSource::endsEarly() const
+{
+    if (m_totalFrames == 0) {
+        return false;
+    }
+
+    const uint64_t rate = static_cast<uint64_t>(m_format.sampleRate);
+    const uint64_t tolerance
+        = std::max(ShortInputToleranceMs * rate / 1000, m_totalFrames * ShortInputTolerancePercent / 100);
+    return m_framesRead + tolerance < m_totalFrames;
+}
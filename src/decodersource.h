@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pcmsource.h"
+
+#include <core/track.h>
+
+#include <QFile>
+
+#include <memory>
+#include <vector>
+
+namespace Fooyin {
+class AudioDecoder;
+class AudioLoader;
+} // namespace Fooyin
+
+// Decodes any format fooyin can play, using fooyin's own decoder plugins
+class DecoderSource : public PcmSource
+{
+public:
+    DecoderSource(std::shared_ptr<Fooyin::AudioLoader> audioLoader, const Fooyin::Track& track);
+    ~DecoderSource() override;
+
+    bool open(const QString& path) override;
+    PcmFormat format() const override { return m_format; }
+    uint64_t totalFrames() const override { return m_totalFrames; }
+    int64_t read(float* buffer, int64_t maxFrames) override;
+
+private:
+    // Whether the decoder ran dry well before the length of the track
+    bool endsEarly() const;
+
+    std::shared_ptr<Fooyin::AudioLoader> m_audioLoader;
+    Fooyin::Track m_track;
+    std::unique_ptr<Fooyin::AudioDecoder> m_decoder;
+    QFile m_file;
+
+    PcmFormat m_format;
+    int m_sampleFormat{0};
+    uint64_t m_totalFrames{0};
+    uint64_t m_framesRead{0};
+
+    // Decoded samples not yet handed out by read()
+    std::vector<float> m_pending;
+    size_t m_pendingPos{0};
+};
@@ -0,0 +1,166 @@
+#include "decodestage.h"
+#include "pcmsource.h"
+#include "pcmstage.h"
+#include "pcmstream.h"
+#include "tracing.h"
+
+#include <QThreadPool>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+DecodeStage::DecodeStage(std::unique_ptr<PcmSource> source, OutputList outputs, uint64_t readAheadBlocks,
+                         std::function<void()> firstBlock)
+    : m_source{std::move(source)}
+    , m_outputs{std::move(outputs)}
+    , m_readAheadBlocks{readAheadBlocks}
+    , m_firstBlock{std::move(firstBlock)}
+{
+    setAutoDelete(true);
+}
+
+DecodeStage::~DecodeStage() = default;
+
+QThreadPool* DecodeStage::decoderThreadPool()
+{
+    static QThreadPool* pool = [] {
+        auto* decoderPool = new QThreadPool();
+        // One thread per running job; they mostly sleep on back-pressure
+        decoderPool->setMaxThreadCount(256);
+        return decoderPool;
+    }();
+    return pool;
+}
+
+void DecodeStage::start(std::unique_ptr<PcmSource> source, OutputList outputs, uint64_t readAheadBlocks,
+                        std::function<void()> firstBlock)
+{
+    decoderThreadPool()->start(
+        new DecodeStage(std::move(source), std::move(outputs), readAheadBlocks, std::move(firstBlock)));
+}
+
+void DecodeStage::run()
+{
+    const Trace::Scope scope{"decode"};
+    const int channels = m_source->format().channels;
+    std::vector<float> block(static_cast<size_t>(PcmStream::BlockFrames * channels));
+    uint64_t position{0};
+
+    while (true) {
+        const int64_t frames = m_source->read(block.data(), PcmStream::BlockFrames);
+        if (frames < 0) {
+            for (const Output& output : m_outputs) {
+                if (!output.finished) {
+                    output.stream->fail(m_source->errorString());
+                }
+            }
+            return;
+        }
+        if (frames == 0) {
+            break;
+        }
+        if (m_firstBlock) {
+            std::exchange(m_firstBlock, {})();
+        }
+
+        const uint64_t blockEnd = position + static_cast<uint64_t>(frames);
+
+        // Blocks while an encoder is behind; false means it gave up
+        bool anyOpen{false};
+        for (Output& output : m_outputs) {
+            if (output.finished || output.stream->isAborted()) {
+                continue;
+            }
+
+            // Part of this block inside the output's slice
+            const uint64_t begin = std::max(position, output.startFrame);
+            const uint64_t end = output.endFrame > 0 ? std::min(blockEnd, output.endFrame) : blockEnd;
+
+            if (begin < end && !write(output, block.data() + (begin - position) * channels, end - begin)) {
+                continue;
+            }
+
+            if (output.endFrame > 0 && blockEnd >= output.endFrame) {
+                finish(output);
+                continue;
+            }
+            anyOpen = true;
+        }
+        if (!anyOpen) {
+            return;
+        }
+
+        position = blockEnd;
+    }
+
+    for (Output& output : m_outputs) {
+        if (output.finished) {
+            continue;
+        }
+        // The next track of the CUE sheet starts past the end: the image is truncated
+        if (output.endFrame > 0 && position < output.endFrame) {
+            output.stream->fail("Input ends before the end of the track");
+            output.finished = true;
+            continue;
+        }
+        finish(output);
+    }
+}
+
+bool DecodeStage::write(Output& output, const float* data, int64_t frames)
+{
+    waitForReadAhead();
+
+    int64_t outputFrames{frames};
+    if (output.pipeline) {
+        data = output.pipeline->process(data, frames, outputFrames);
+    }
+
+    return outputFrames == 0 || output.stream->write(data, outputFrames);
+}
+
+void DecodeStage::finish(Output& output)
+{
+    // Drain what the stages still hold, e.g. the resampler's filter tail
+    if (output.pipeline) {
+        output.pipeline->flush([&output](const float* data, int64_t frames) {
+            output.stream->write(data, frames);
+        });
+    }
+
+    output.stream->finish();
+    output.finished = true;
+}
+
+void DecodeStage::waitForReadAhead()
+{
+    if (m_readAheadBlocks == 0) {
+        return;
+    }
+
+    while (true) {
+        uint64_t queued{0};
+        PcmStream* oldest{nullptr};
+        uint64_t oldestQueued{0};
+
+        for (const Output& output : m_outputs) {
+            if (output.stream->isAborted()) {
+                continue;
+            }
+            const uint64_t blocks = output.stream->queuedBlocks();
+            if (blocks > 0 && !oldest) {
+                oldest = output.stream.get();
+                oldestQueued = blocks;
+            }
+            queued += blocks;
+        }
+
+        if (queued < m_readAheadBlocks || !oldest) {
+            return;
+        }
+
+        // Outputs are filled in order, so the earliest slice holds the oldest data
+        oldest->waitUntilQueuedBelow(oldestQueued);
+    }
+}
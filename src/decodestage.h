@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QRunnable>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class PcmPipeline;
+class PcmSource;
+class PcmStream;
+class QThreadPool;
+
+// Pulls PCM from a source on a decoder thread and pushes every block into all outputs,
+// running each output's pipeline (resampling...) on the way.
+// An output can take just a slice of the source (one track of a CUE image); its stream
+// is finished as soon as the decoder passes the end of the slice.
+// Runs until the source ends, fails, or all consumers abort their streams.
+// The slowest consumer sets the pace once its stream is full.
+class DecodeStage : public QRunnable
+{
+public:
+    struct Output {
+        std::shared_ptr<PcmStream> stream;
+        std::unique_ptr<PcmPipeline> pipeline;
+        uint64_t startFrame{0};
+        uint64_t endFrame{0}; // 0 = to the end of the source
+        bool finished{false};
+    };
+    using OutputList = std::vector<Output>;
+
+    DecodeStage(std::unique_ptr<PcmSource> source, OutputList outputs, uint64_t readAheadBlocks,
+                std::function<void()> firstBlock);
+    ~DecodeStage() override;
+
+    void run() override;
+
+    // Starts decoding source into outputs. With readAheadBlocks set, the decoder may run up
+    // to that many blocks (summed over all outputs) ahead of the encoders, so the slices of
+    // an image are encoded in parallel while the image is only decoded once.
+    // firstBlock, if set, is called on the decoder thread once the first block is decoded.
+    static void start(std::unique_ptr<PcmSource> source, OutputList outputs, uint64_t readAheadBlocks = 0,
+                      std::function<void()> firstBlock = {});
+
+private:
+    // Decoders block on full streams, so they get their own pool rather than
+    // sharing one with the encoders they wait for
+    static QThreadPool* decoderThreadPool();
+
+    bool write(Output& output, const float* data, int64_t frames);
+    void finish(Output& output);
+    void waitForReadAhead();
+
+    std::unique_ptr<PcmSource> m_source;
+    OutputList m_outputs;
+    uint64_t m_readAheadBlocks;
+    std::function<void()> m_firstBlock;
+};
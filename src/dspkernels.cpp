@@ -0,0 +1,879 @@
+#include "dspkernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DSP_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define DSP_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+constexpr int MaxMixChannels = 8;
+
+struct Range {
+    float scale;
+    float maxValue;
+};
+
+// Full scale and largest positive code of a bits-wide format, as floats
+Range rangeFor(int bits)
+{
+    const float scale = std::ldexp(1.0F, bits - 1);
+    float maxValue = scale - 1.0F;
+    // 2^31 - 1 is not representable as float
+    if (maxValue >= scale) {
+        maxValue = std::nextafter(scale, 0.0F);
+    }
+    return {scale, maxValue};
+}
+
+uint32_t xorshift(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+float uniform(uint32_t& state)
+{
+    return static_cast<float>(xorshift(state) >> 8) * (1.0F / 16777216.0F);
+}
+
+// ----- Scalar reference versions, also used for loop tails -----
+
+float dotScalar(const float* a, const float* b, int count)
+{
+    float sum{0.0F};
+    for (int i = 0; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void int16ToFloatScalar(const int16_t* in, float* out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = in[i] * (1.0F / 32768.0F);
+    }
+}
+
+void int24In32ToFloatScalar(const int32_t* in, float* out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        // Sign-extend the low 24 bits before scaling
+        out[i] = static_cast<float>(static_cast<int32_t>(static_cast<uint32_t>(in[i]) << 8) >> 8)
+               * (1.0F / 8388608.0F);
+    }
+}
+
+void int32ToFloatScalar(const int32_t* in, float* out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<float>(in[i]) * (1.0F / 2147483648.0F);
+    }
+}
+
+void floatToInt32Scalar(const float* in, int32_t* out, size_t count, int bits)
+{
+    const Range range = rangeFor(bits);
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<int32_t>(std::lrintf(std::clamp(in[i] * range.scale, -range.scale, range.maxValue)));
+    }
+}
+
+void floatToInt16Scalar(const float* in, int16_t* out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<int16_t>(std::lrintf(std::clamp(in[i] * 32768.0F, -32768.0F, 32767.0F)));
+    }
+}
+
+void quantizeScalar(float* samples, size_t count, int bits, Dsp::DitherState* dither)
+{
+    const Range range = rangeFor(bits);
+    const float inverse = 1.0F / range.scale;
+
+    for (size_t i = 0; i < count; ++i) {
+        float value = samples[i] * range.scale;
+        if (dither) {
+            value += uniform(dither->lanes[0]) - uniform(dither->lanes[0]);
+        }
+        samples[i] = static_cast<float>(std::lrintf(std::clamp(value, -range.scale, range.maxValue))) * inverse;
+    }
+}
+
+void mixScalar(const float* in, float* out, int64_t frames, int inChannels, int outChannels, const float* matrix)
+{
+    for (int64_t f = 0; f < frames; ++f) {
+        const float* frame = in + f * inChannels;
+        for (int o = 0; o < outChannels; ++o) {
+            const float* row = matrix + o * inChannels;
+            float sum{0.0F};
+            for (int c = 0; c < inChannels; ++c) {
+                sum += frame[c] * row[c];
+            }
+            out[f * outChannels + o] = sum;
+        }
+    }
+}
+
+void filterPowerScalar(const float* in, int64_t frames, int channels, Dsp::BiquadCascade& filter, double* power,
+                       float* peak)
+{
+    const float* first = filter.coeffs[0];
+    const float* second = filter.coeffs[1];
+
+    for (int c = 0; c < channels; ++c) {
+        float z0 = filter.state[0][0][c];
+        float z1 = filter.state[0][1][c];
+        float z2 = filter.state[1][0][c];
+        float z3 = filter.state[1][1][c];
+        float sum{0.0F};
+        float maxValue{peak[c]};
+
+        for (int64_t f = 0; f < frames; ++f) {
+            const float x = in[f * channels + c];
+            maxValue = std::max(maxValue, std::abs(x));
+
+            const float y = first[0] * x + z0;
+            z0 = first[1] * x - first[3] * y + z1;
+            z1 = first[2] * x - first[4] * y;
+
+            const float out = second[0] * y + z2;
+            z2 = second[1] * y - second[3] * out + z3;
+            z3 = second[2] * y - second[4] * out;
+
+            sum += out * out;
+        }
+
+        filter.state[0][0][c] = z0;
+        filter.state[0][1][c] = z1;
+        filter.state[1][0][c] = z2;
+        filter.state[1][1][c] = z3;
+        power[c] += sum;
+        peak[c] = maxValue;
+    }
+}
+
+#ifdef DSP_X86
+// ----- SSE2, always available on x86-64 -----
+
+float horizontalSum(__m128 sum)
+{
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+float dotSse(const float* a, const float* b, int count)
+{
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+
+    int i{0};
+    for (; i + 8 <= count; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+
+    return horizontalSum(_mm_add_ps(sum0, sum1)) + dotScalar(a + i, b + i, count - i);
+}
+
+void int16ToFloatSse(const int16_t* in, float* out, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.0F / 32768.0F);
+
+    size_t i{0};
+    for (; i + 8 <= count; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // Duplicating each value into a 32-bit lane and shifting back sign-extends it
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+void int24In32ToFloatSse(const int32_t* in, float* out, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.0F / 8388608.0F);
+
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i extended = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(extended), scale));
+    }
+
+    int24In32ToFloatScalar(in + i, out + i, count - i);
+}
+
+void int32ToFloatSse(const int32_t* in, float* out, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.0F / 2147483648.0F);
+
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+
+    int32ToFloatScalar(in + i, out + i, count - i);
+}
+
+__m128i toInt32Sse(__m128 value, __m128 scale, __m128 minValue, __m128 maxValue)
+{
+    value = _mm_min_ps(_mm_max_ps(_mm_mul_ps(value, scale), minValue), maxValue);
+    // Rounds to nearest under the default MXCSR mode
+    return _mm_cvtps_epi32(value);
+}
+
+void floatToInt32Sse(const float* in, int32_t* out, size_t count, int bits)
+{
+    const Range range = rangeFor(bits);
+    const __m128 scale = _mm_set1_ps(range.scale);
+    const __m128 minValue = _mm_set1_ps(-range.scale);
+    const __m128 maxValue = _mm_set1_ps(range.maxValue);
+
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = toInt32Sse(_mm_loadu_ps(in + i), scale, minValue, maxValue);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+    }
+
+    floatToInt32Scalar(in + i, out + i, count - i, bits);
+}
+
+void floatToInt16Sse(const float* in, int16_t* out, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(32768.0F);
+    const __m128 minValue = _mm_set1_ps(-32768.0F);
+    const __m128 maxValue = _mm_set1_ps(32767.0F);
+
+    size_t i{0};
+    for (; i + 8 <= count; i += 8) {
+        const __m128i lo = toInt32Sse(_mm_loadu_ps(in + i), scale, minValue, maxValue);
+        const __m128i hi = toInt32Sse(_mm_loadu_ps(in + i + 4), scale, minValue, maxValue);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(lo, hi));
+    }
+
+    floatToInt16Scalar(in + i, out + i, count - i);
+}
+
+__m128 uniformSse(__m128i& state)
+{
+    __m128i x = state;
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    state = x;
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), _mm_set1_ps(1.0F / 16777216.0F));
+}
+
+void quantizeSse(float* samples, size_t count, int bits, Dsp::DitherState* dither)
+{
+    const Range range = rangeFor(bits);
+    const __m128 scale = _mm_set1_ps(range.scale);
+    const __m128 inverse = _mm_set1_ps(1.0F / range.scale);
+    const __m128 minValue = _mm_set1_ps(-range.scale);
+    const __m128 maxValue = _mm_set1_ps(range.maxValue);
+
+    __m128i state = dither ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->lanes)) : _mm_setzero_si128();
+
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        __m128 value = _mm_mul_ps(_mm_loadu_ps(samples + i), scale);
+        if (dither) {
+            const __m128 first = uniformSse(state);
+            value = _mm_add_ps(value, _mm_sub_ps(first, uniformSse(state)));
+        }
+        value = _mm_min_ps(_mm_max_ps(value, minValue), maxValue);
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtps_epi32(value)), inverse));
+    }
+
+    if (dither) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->lanes), state);
+    }
+    quantizeScalar(samples + i, count - i, bits, dither);
+}
+
+void mixSse(const float* in, float* out, int64_t frames, int inChannels, int outChannels, const float* matrix)
+{
+    if (inChannels > MaxMixChannels || outChannels > MaxMixChannels) {
+        mixScalar(in, out, frames, inChannels, outChannels, matrix);
+        return;
+    }
+
+    // Rows padded to 8 coefficients, so each frame is two masked vector loads
+    alignas(16) float rows[MaxMixChannels][MaxMixChannels]{};
+    alignas(16) uint32_t mask[MaxMixChannels]{};
+    for (int o = 0; o < outChannels; ++o) {
+        std::copy_n(matrix + o * inChannels, inChannels, rows[o]);
+    }
+    std::fill_n(mask, inChannels, 0xFFFFFFFFU);
+
+    const __m128 maskLo = _mm_load_ps(reinterpret_cast<const float*>(mask));
+    const __m128 maskHi = _mm_load_ps(reinterpret_cast<const float*>(mask + 4));
+    const int64_t totalSamples = frames * inChannels;
+
+    int64_t f{0};
+    // The loads cover 8 floats, the last frames are left to the scalar loop
+    for (; f < frames && f * inChannels + MaxMixChannels <= totalSamples; ++f) {
+        const float* frame = in + f * inChannels;
+        const __m128 lo = _mm_and_ps(_mm_loadu_ps(frame), maskLo);
+        const __m128 hi = _mm_and_ps(_mm_loadu_ps(frame + 4), maskHi);
+
+        for (int o = 0; o < outChannels; ++o) {
+            const __m128 sum = _mm_add_ps(_mm_mul_ps(lo, _mm_load_ps(rows[o])), _mm_mul_ps(hi, _mm_load_ps(rows[o] + 4)));
+            out[f * outChannels + o] = horizontalSum(sum);
+        }
+    }
+
+    mixScalar(in + f * inChannels, out + f * outChannels, frames - f, inChannels, outChannels, matrix);
+}
+
+// Channels live in the lanes of two vectors, so one frame is one step of every filter
+void filterPowerSse(const float* in, int64_t frames, int channels, Dsp::BiquadCascade& filter, double* power,
+                    float* peak)
+{
+    if (channels > MaxMixChannels) {
+        filterPowerScalar(in, frames, channels, filter, power, peak);
+        return;
+    }
+
+    alignas(16) uint32_t mask[MaxMixChannels]{};
+    std::fill_n(mask, channels, 0xFFFFFFFFU);
+    const __m128 maskLo = _mm_load_ps(reinterpret_cast<const float*>(mask));
+    const __m128 maskHi = _mm_load_ps(reinterpret_cast<const float*>(mask + 4));
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    __m128 k[2][5];
+    for (int s = 0; s < 2; ++s) {
+        for (int i = 0; i < 5; ++i) {
+            k[s][i] = _mm_set1_ps(filter.coeffs[s][i]);
+        }
+    }
+
+    // [stage][z1, z2][low, high lanes]
+    __m128 z[2][2][2];
+    for (int s = 0; s < 2; ++s) {
+        for (int i = 0; i < 2; ++i) {
+            z[s][i][0] = _mm_loadu_ps(filter.state[s][i]);
+            z[s][i][1] = _mm_loadu_ps(filter.state[s][i] + 4);
+        }
+    }
+
+    __m128 sum[2]{_mm_setzero_ps(), _mm_setzero_ps()};
+    __m128 maxValue[2]{_mm_setzero_ps(), _mm_setzero_ps()};
+    const int64_t totalSamples = frames * channels;
+
+    int64_t f{0};
+    for (; f < frames && f * channels + MaxMixChannels <= totalSamples; ++f) {
+        const float* frame = in + f * channels;
+        const __m128 x[2]{_mm_and_ps(_mm_loadu_ps(frame), maskLo), _mm_and_ps(_mm_loadu_ps(frame + 4), maskHi)};
+
+        for (int h = 0; h < 2; ++h) {
+            maxValue[h] = _mm_max_ps(maxValue[h], _mm_and_ps(x[h], absMask));
+
+            __m128 value = x[h];
+            for (int s = 0; s < 2; ++s) {
+                const __m128 y = _mm_add_ps(_mm_mul_ps(k[s][0], value), z[s][0][h]);
+                z[s][0][h] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(k[s][1], value), _mm_mul_ps(k[s][3], y)), z[s][1][h]);
+                z[s][1][h] = _mm_sub_ps(_mm_mul_ps(k[s][2], value), _mm_mul_ps(k[s][4], y));
+                value = y;
+            }
+            sum[h] = _mm_add_ps(sum[h], _mm_mul_ps(value, value));
+        }
+    }
+
+    alignas(16) float sums[MaxMixChannels];
+    alignas(16) float peaks[MaxMixChannels];
+    _mm_store_ps(sums, sum[0]);
+    _mm_store_ps(sums + 4, sum[1]);
+    _mm_store_ps(peaks, maxValue[0]);
+    _mm_store_ps(peaks + 4, maxValue[1]);
+
+    for (int c = 0; c < channels; ++c) {
+        power[c] += sums[c];
+        peak[c] = std::max(peak[c], peaks[c]);
+    }
+    for (int s = 0; s < 2; ++s) {
+        for (int i = 0; i < 2; ++i) {
+            _mm_storeu_ps(filter.state[s][i], z[s][i][0]);
+            _mm_storeu_ps(filter.state[s][i] + 4, z[s][i][1]);
+        }
+    }
+
+    filterPowerScalar(in + f * channels, frames - f, channels, filter, power, peak);
+}
+
+#if defined(__GNUC__)
+#define DSP_AVX2
+// ----- AVX2 + FMA, selected at runtime -----
+
+__attribute__((target("avx2,fma"))) float dotAvx2(const float* a, const float* b, int count)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+
+    int i{0};
+    for (; i + 16 <= count; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+    }
+
+    const __m256 sum = _mm256_add_ps(sum0, sum1);
+    const __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+
+    return horizontalSum(half) + dotSse(a + i, b + i, count - i);
+}
+
+// Down to mono or stereo: gathers one channel of 8 frames at a time
+__attribute__((target("avx2,fma"))) void mixAvx2(const float* in, float* out, int64_t frames, int inChannels,
+                                                 int outChannels, const float* matrix)
+{
+    if (inChannels > MaxMixChannels || outChannels > 2) {
+        mixSse(in, out, frames, inChannels, outChannels, matrix);
+        return;
+    }
+
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(inChannels));
+
+    int64_t f{0};
+    for (; f + 8 <= frames; f += 8) {
+        const float* base = in + f * inChannels;
+        __m256 left = _mm256_setzero_ps();
+        __m256 right = _mm256_setzero_ps();
+
+        for (int c = 0; c < inChannels; ++c) {
+            const __m256 v = _mm256_i32gather_ps(base + c, offsets, 4);
+            left = _mm256_fmadd_ps(v, _mm256_set1_ps(matrix[c]), left);
+            if (outChannels == 2) {
+                right = _mm256_fmadd_ps(v, _mm256_set1_ps(matrix[inChannels + c]), right);
+            }
+        }
+
+        if (outChannels == 1) {
+            _mm256_storeu_ps(out + f, left);
+            continue;
+        }
+
+        // Interleave back to L R L R...
+        const __m256 lo = _mm256_unpacklo_ps(left, right);
+        const __m256 hi = _mm256_unpackhi_ps(left, right);
+        _mm256_storeu_ps(out + f * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + f * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+
+    mixSse(in + f * inChannels, out + f * outChannels, frames - f, inChannels, outChannels, matrix);
+}
+// All 8 channels in one register; masked loads never touch memory past the input
+__attribute__((target("avx2,fma"))) void filterPowerAvx2(const float* in, int64_t frames, int channels,
+                                                         Dsp::BiquadCascade& filter, double* power, float* peak)
+{
+    if (channels > MaxMixChannels) {
+        filterPowerScalar(in, frames, channels, filter, power, peak);
+        return;
+    }
+
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(channels), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+    __m256 k[2][5];
+    __m256 z[2][2];
+    for (int s = 0; s < 2; ++s) {
+        for (int i = 0; i < 5; ++i) {
+            k[s][i] = _mm256_set1_ps(filter.coeffs[s][i]);
+        }
+        z[s][0] = _mm256_loadu_ps(filter.state[s][0]);
+        z[s][1] = _mm256_loadu_ps(filter.state[s][1]);
+    }
+
+    __m256 sum = _mm256_setzero_ps();
+    __m256 maxValue = _mm256_setzero_ps();
+
+    for (int64_t f = 0; f < frames; ++f) {
+        __m256 value = _mm256_maskload_ps(in + f * channels, mask);
+        maxValue = _mm256_max_ps(maxValue, _mm256_and_ps(value, absMask));
+
+        for (int s = 0; s < 2; ++s) {
+            const __m256 y = _mm256_fmadd_ps(k[s][0], value, z[s][0]);
+            z[s][0] = _mm256_fnmadd_ps(k[s][3], y, _mm256_fmadd_ps(k[s][1], value, z[s][1]));
+            z[s][1] = _mm256_fnmadd_ps(k[s][4], y, _mm256_mul_ps(k[s][2], value));
+            value = y;
+        }
+        sum = _mm256_fmadd_ps(value, value, sum);
+    }
+
+    alignas(32) float sums[MaxMixChannels];
+    alignas(32) float peaks[MaxMixChannels];
+    _mm256_store_ps(sums, sum);
+    _mm256_store_ps(peaks, maxValue);
+
+    for (int c = 0; c < channels; ++c) {
+        power[c] += sums[c];
+        peak[c] = std::max(peak[c], peaks[c]);
+    }
+    for (int s = 0; s < 2; ++s) {
+        _mm256_storeu_ps(filter.state[s][0], z[s][0]);
+        _mm256_storeu_ps(filter.state[s][1], z[s][1]);
+    }
+}
+#endif
+#endif
+
+#ifdef DSP_NEON
+// ----- NEON (AArch64) -----
+
+float dotNeon(const float* a, const float* b, int count)
+{
+    float32x4_t sum0 = vdupq_n_f32(0.0F);
+    float32x4_t sum1 = vdupq_n_f32(0.0F);
+
+    int i{0};
+    for (; i + 8 <= count; i += 8) {
+        sum0 = vfmaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+        sum1 = vfmaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+
+    return vaddvq_f32(vaddq_f32(sum0, sum1)) + dotScalar(a + i, b + i, count - i);
+}
+
+void int16ToFloatNeon(const int16_t* in, float* out, size_t count)
+{
+    size_t i{0};
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t v = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0F / 32768.0F));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0F / 32768.0F));
+    }
+
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+void int24In32ToFloatNeon(const int32_t* in, float* out, size_t count)
+{
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        const int32x4_t extended = vshrq_n_s32(vshlq_n_s32(vld1q_s32(in + i), 8), 8);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(extended), 1.0F / 8388608.0F));
+    }
+
+    int24In32ToFloatScalar(in + i, out + i, count - i);
+}
+
+void int32ToFloatNeon(const int32_t* in, float* out, size_t count)
+{
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), 1.0F / 2147483648.0F));
+    }
+
+    int32ToFloatScalar(in + i, out + i, count - i);
+}
+
+int32x4_t toInt32Neon(float32x4_t value, float scale, float32x4_t minValue, float32x4_t maxValue)
+{
+    value = vminq_f32(vmaxq_f32(vmulq_n_f32(value, scale), minValue), maxValue);
+    return vcvtnq_s32_f32(value);
+}
+
+void floatToInt32Neon(const float* in, int32_t* out, size_t count, int bits)
+{
+    const Range range = rangeFor(bits);
+    const float32x4_t minValue = vdupq_n_f32(-range.scale);
+    const float32x4_t maxValue = vdupq_n_f32(range.maxValue);
+
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        vst1q_s32(out + i, toInt32Neon(vld1q_f32(in + i), range.scale, minValue, maxValue));
+    }
+
+    floatToInt32Scalar(in + i, out + i, count - i, bits);
+}
+
+void floatToInt16Neon(const float* in, int16_t* out, size_t count)
+{
+    const float32x4_t minValue = vdupq_n_f32(-32768.0F);
+    const float32x4_t maxValue = vdupq_n_f32(32767.0F);
+
+    size_t i{0};
+    for (; i + 8 <= count; i += 8) {
+        const int32x4_t lo = toInt32Neon(vld1q_f32(in + i), 32768.0F, minValue, maxValue);
+        const int32x4_t hi = toInt32Neon(vld1q_f32(in + i + 4), 32768.0F, minValue, maxValue);
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+
+    floatToInt16Scalar(in + i, out + i, count - i);
+}
+
+float32x4_t uniformNeon(uint32x4_t& state)
+{
+    uint32x4_t x = state;
+    x = veorq_u32(x, vshlq_n_u32(x, 13));
+    x = veorq_u32(x, vshrq_n_u32(x, 17));
+    x = veorq_u32(x, vshlq_n_u32(x, 5));
+    state = x;
+    return vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(x, 8)), 1.0F / 16777216.0F);
+}
+
+void quantizeNeon(float* samples, size_t count, int bits, Dsp::DitherState* dither)
+{
+    const Range range = rangeFor(bits);
+    const float inverse = 1.0F / range.scale;
+    const float32x4_t minValue = vdupq_n_f32(-range.scale);
+    const float32x4_t maxValue = vdupq_n_f32(range.maxValue);
+
+    uint32x4_t state = dither ? vld1q_u32(dither->lanes) : vdupq_n_u32(0);
+
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t value = vmulq_n_f32(vld1q_f32(samples + i), range.scale);
+        if (dither) {
+            const float32x4_t first = uniformNeon(state);
+            value = vaddq_f32(value, vsubq_f32(first, uniformNeon(state)));
+        }
+        value = vminq_f32(vmaxq_f32(value, minValue), maxValue);
+        vst1q_f32(samples + i, vmulq_n_f32(vrndnq_f32(value), inverse));
+    }
+
+    if (dither) {
+        vst1q_u32(dither->lanes, state);
+    }
+    quantizeScalar(samples + i, count - i, bits, dither);
+}
+
+void mixNeon(const float* in, float* out, int64_t frames, int inChannels, int outChannels, const float* matrix)
+{
+    if (inChannels > MaxMixChannels || outChannels > MaxMixChannels) {
+        mixScalar(in, out, frames, inChannels, outChannels, matrix);
+        return;
+    }
+
+    float rows[MaxMixChannels][MaxMixChannels]{};
+    uint32_t mask[MaxMixChannels]{};
+    for (int o = 0; o < outChannels; ++o) {
+        std::copy_n(matrix + o * inChannels, inChannels, rows[o]);
+    }
+    std::fill_n(mask, inChannels, 0xFFFFFFFFU);
+
+    const uint32x4_t maskLo = vld1q_u32(mask);
+    const uint32x4_t maskHi = vld1q_u32(mask + 4);
+    const int64_t totalSamples = frames * inChannels;
+
+    int64_t f{0};
+    for (; f < frames && f * inChannels + MaxMixChannels <= totalSamples; ++f) {
+        const float* frame = in + f * inChannels;
+        const float32x4_t lo = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vld1q_f32(frame)), maskLo));
+        const float32x4_t hi = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vld1q_f32(frame + 4)), maskHi));
+
+        for (int o = 0; o < outChannels; ++o) {
+            const float32x4_t sum = vfmaq_f32(vmulq_f32(lo, vld1q_f32(rows[o])), hi, vld1q_f32(rows[o] + 4));
+            out[f * outChannels + o] = vaddvq_f32(sum);
+        }
+    }
+
+    mixScalar(in + f * inChannels, out + f * outChannels, frames - f, inChannels, outChannels, matrix);
+}
+void filterPowerNeon(const float* in, int64_t frames, int channels, Dsp::BiquadCascade& filter, double* power,
+                     float* peak)
+{
+    if (channels > MaxMixChannels) {
+        filterPowerScalar(in, frames, channels, filter, power, peak);
+        return;
+    }
+
+    uint32_t mask[MaxMixChannels]{};
+    std::fill_n(mask, channels, 0xFFFFFFFFU);
+    const uint32x4_t masks[2]{vld1q_u32(mask), vld1q_u32(mask + 4)};
+
+    float32x4_t z[2][2][2];
+    for (int s = 0; s < 2; ++s) {
+        for (int i = 0; i < 2; ++i) {
+            z[s][i][0] = vld1q_f32(filter.state[s][i]);
+            z[s][i][1] = vld1q_f32(filter.state[s][i] + 4);
+        }
+    }
+
+    float32x4_t sum[2]{vdupq_n_f32(0.0F), vdupq_n_f32(0.0F)};
+    float32x4_t maxValue[2]{vdupq_n_f32(0.0F), vdupq_n_f32(0.0F)};
+    const int64_t totalSamples = frames * channels;
+
+    int64_t f{0};
+    for (; f < frames && f * channels + MaxMixChannels <= totalSamples; ++f) {
+        const float* frame = in + f * channels;
+
+        for (int h = 0; h < 2; ++h) {
+            float32x4_t value = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vld1q_f32(frame + h * 4)), masks[h]));
+            maxValue[h] = vmaxq_f32(maxValue[h], vabsq_f32(value));
+
+            for (int s = 0; s < 2; ++s) {
+                const float* k = filter.coeffs[s];
+                const float32x4_t y = vfmaq_n_f32(z[s][0][h], value, k[0]);
+                z[s][0][h] = vfmsq_n_f32(vfmaq_n_f32(z[s][1][h], value, k[1]), y, k[3]);
+                z[s][1][h] = vfmsq_n_f32(vmulq_n_f32(value, k[2]), y, k[4]);
+                value = y;
+            }
+            sum[h] = vfmaq_f32(sum[h], value, value);
+        }
+    }
+
+    float sums[MaxMixChannels];
+    float peaks[MaxMixChannels];
+    vst1q_f32(sums, sum[0]);
+    vst1q_f32(sums + 4, sum[1]);
+    vst1q_f32(peaks, maxValue[0]);
+    vst1q_f32(peaks + 4, maxValue[1]);
+
+    for (int c = 0; c < channels; ++c) {
+        power[c] += sums[c];
+        peak[c] = std::max(peak[c], peaks[c]);
+    }
+    for (int s = 0; s < 2; ++s) {
+        for (int i = 0; i < 2; ++i) {
+            vst1q_f32(filter.state[s][i], z[s][i][0]);
+            vst1q_f32(filter.state[s][i] + 4, z[s][i][1]);
+        }
+    }
+
+    filterPowerScalar(in + f * channels, frames - f, channels, filter, power, peak);
+}
+#endif
+
+struct Kernels {
+    const char* name;
+    float (*dotProduct)(const float*, const float*, int);
+    void (*int16ToFloat)(const int16_t*, float*, size_t);
+    void (*int24In32ToFloat)(const int32_t*, float*, size_t);
+    void (*int32ToFloat)(const int32_t*, float*, size_t);
+    void (*floatToInt16)(const float*, int16_t*, size_t);
+    void (*floatToInt32)(const float*, int32_t*, size_t, int);
+    void (*quantize)(float*, size_t, int, Dsp::DitherState*);
+    void (*mixChannels)(const float*, float*, int64_t, int, int, const float*);
+    void (*filterPower)(const float*, int64_t, int, Dsp::BiquadCascade&, double*, float*);
+};
+
+Kernels selectKernels()
+{
+#ifdef DSP_X86
+    Kernels kernels{
+        .name = "SSE2",
+        .dotProduct = dotSse,
+        .int16ToFloat = int16ToFloatSse,
+        .int24In32ToFloat = int24In32ToFloatSse,
+        .int32ToFloat = int32ToFloatSse,
+        .floatToInt16 = floatToInt16Sse,
+        .floatToInt32 = floatToInt32Sse,
+        .quantize = quantizeSse,
+        .mixChannels = mixSse,
+        .filterPower = filterPowerSse,
+    };
+#ifdef DSP_AVX2
+    // Only the filter, mix and loudness loops gain from the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        kernels.name = "AVX2";
+        kernels.dotProduct = dotAvx2;
+        kernels.mixChannels = mixAvx2;
+        kernels.filterPower = filterPowerAvx2;
+    }
+#endif
+    return kernels;
+#elif defined(DSP_NEON)
+    return Kernels{
+        .name = "NEON",
+        .dotProduct = dotNeon,
+        .int16ToFloat = int16ToFloatNeon,
+        .int24In32ToFloat = int24In32ToFloatNeon,
+        .int32ToFloat = int32ToFloatNeon,
+        .floatToInt16 = floatToInt16Neon,
+        .floatToInt32 = floatToInt32Neon,
+        .quantize = quantizeNeon,
+        .mixChannels = mixNeon,
+        .filterPower = filterPowerNeon,
+    };
+#else
+    return Kernels{
+        .name = "scalar",
+        .dotProduct = dotScalar,
+        .int16ToFloat = int16ToFloatScalar,
+        .int24In32ToFloat = int24In32ToFloatScalar,
+        .int32ToFloat = int32ToFloatScalar,
+        .floatToInt16 = floatToInt16Scalar,
+        .floatToInt32 = floatToInt32Scalar,
+        .quantize = quantizeScalar,
+        .mixChannels = mixScalar,
+        .filterPower = filterPowerScalar,
+    };
+#endif
+}
+
+const Kernels& kernels()
+{
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+} // namespace
+
+namespace Dsp {
+float dotProduct(const float* a, const float* b, int count)
+{
+    return kernels().dotProduct(a, b, count);
+}
+
+void int16ToFloat(const int16_t* in, float* out, size_t count)
+{
+    kernels().int16ToFloat(in, out, count);
+}
+
+void int24In32ToFloat(const int32_t* in, float* out, size_t count)
+{
+    kernels().int24In32ToFloat(in, out, count);
+}
+
+void int32ToFloat(const int32_t* in, float* out, size_t count)
+{
+    kernels().int32ToFloat(in, out, count);
+}
+
+void floatToInt16(const float* in, int16_t* out, size_t count)
+{
+    kernels().floatToInt16(in, out, count);
+}
+
+void floatToInt32(const float* in, int32_t* out, size_t count, int bits)
+{
+    kernels().floatToInt32(in, out, count, bits);
+}
+
+void quantize(float* samples, size_t count, int bits, DitherState* dither)
+{
+    // Floats already hold 24 bits of precision, finer grids are a no-op
+    if (bits > 24) {
+        return;
+    }
+    kernels().quantize(samples, count, bits, dither);
+}
+
+void mixChannels(const float* in, float* out, int64_t frames, int inChannels, int outChannels, const float* matrix)
+{
+    kernels().mixChannels(in, out, frames, inChannels, outChannels, matrix);
+}
+
+void filterPower(const float* in, int64_t frames, int channels, BiquadCascade& filter, double* power, float* peak)
+{
+    kernels().filterPower(in, frames, channels, filter, power, peak);
+}
+
+const char* instructionSet()
+{
+    return kernels().name;
+}
+} // namespace Dsp
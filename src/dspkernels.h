@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Vectorised inner loops of the PCM stages. The best implementation for the CPU
+// (AVX2+FMA, SSE2 or NEON, with a scalar fallback) is picked once at first use.
+namespace Dsp {
+// Per-lane xorshift state for TPDF dither, must not be all zero
+struct DitherState {
+    uint32_t lanes[4]{0x9E3779B9U, 0x85EBCA6BU, 0xC2B2AE35U, 0x27D4EB2FU};
+};
+
+// Sum of a[i] * b[i] for i < count
+float dotProduct(const float* a, const float* b, int count);
+
+// Integer PCM to float in [-1, 1)
+void int16ToFloat(const int16_t* in, float* out, size_t count);
+void int24In32ToFloat(const int32_t* in, float* out, size_t count); // 24-bit values in the low bits
+void int32ToFloat(const int32_t* in, float* out, size_t count);
+
+// Float to integer PCM, rounded and clipped. bits is 24 or 32 for the int32 variant.
+void floatToInt16(const float* in, int16_t* out, size_t count);
+void floatToInt32(const float* in, int32_t* out, size_t count, int bits);
+
+// Rounds samples in place to the grid of a bits-wide integer format, with
+// triangular (TPDF) dither of +-1 LSB when dither is set
+void quantize(float* samples, size_t count, int bits, DitherState* dither);
+
+// Interleaved channel matrix: out[f * outChannels + o] = sum over c of
+// matrix[o * inChannels + c] * in[f * inChannels + c]. Up to 8 input channels.
+void mixChannels(const float* in, float* out, int64_t frames, int inChannels, int outChannels, const float* matrix);
+
+// Two cascaded biquads (transposed direct form II) run independently on each of up to
+// 8 interleaved channels, e.g. the K-weighting filter of ITU-R BS.1770
+struct BiquadCascade {
+    float coeffs[2][5]{};   // b0 b1 b2 a1 a2 of each stage
+    float state[2][2][8]{}; // [stage][z1, z2][channel]
+};
+
+// Filters frames through filter, adding the squared output of each channel to power[channel]
+// and raising peak[channel] to the largest absolute input sample
+void filterPower(const float* in, int64_t frames, int channels, BiquadCascade& filter, double* power, float* peak);
+
+// Name of the instruction set in use, for logging
+const char* instructionSet();
+} // namespace Dsp
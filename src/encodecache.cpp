@@ -0,0 +1,315 @@
+#include "encodecache.h"
+#include "contenthash.h"
+#include "encodertags.h"
+#include "filecopy.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include <cstdio>
+
+#include <unistd.h>
+
+namespace {
+constexpr quint32 IndexMagic = 0x46594543; // "FYEC"
+constexpr quint32 IndexVersion = 1;
+constexpr auto IndexName = "index";
+
+// Remembered source fingerprints; the least recently used beyond this are dropped on save
+constexpr qsizetype MaxSources = 200000;
+// Eviction goes a bit below the limit, so it doesn't run again on the next insert
+constexpr double EvictTarget = 0.9;
+
+qint64 now()
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+} // namespace
+
+EncodeCache::EncodeCache(QString directory, qint64 maxBytes)
+    : m_directory{std::move(directory)}
+    , m_maxBytes{maxBytes}
+{
+    load();
+}
+
+void EncodeCache::setMaxBytes(qint64 maxBytes)
+{
+    const QMutexLocker locker{&m_lock};
+    m_maxBytes = maxBytes;
+    evict();
+}
+
+uint64_t EncodeCache::sourceHash(const QString& path)
+{
+    const QFileInfo info{path};
+    const qint64 size = info.size();
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+
+    {
+        const QMutexLocker locker{&m_lock};
+        if (auto it = m_sources.find(path); it != m_sources.end() && it->size == size && it->modified == modified) {
+            it->lastUsed = now();
+            m_changed = true;
+            return it->hash;
+        }
+    }
+
+    // Reads the whole file, so not under the lock
+    const uint64_t hash = audioFingerprint(path);
+    if (hash != 0) {
+        const QMutexLocker locker{&m_lock};
+        m_sources.insert(path, {size, modified, hash, now()});
+        m_changed = true;
+    }
+    return hash;
+}
+
+uint64_t EncodeCache::key(uint64_t sourceHash, const ConversionTarget& target, const Fooyin::Track& tagTrack,
+                          const QString& encoder)
+{
+    const ConversionOptions& options = target.options;
+
+    // Only what changes the output: options that don't apply to the format are left out
+    QByteArray data;
+    QDataStream stream{&data, QIODevice::WriteOnly};
+    stream << static_cast<quint64>(sourceHash) << encoder << options.format << options.sampleRate
+           << options.channels << options.replayGain;
+    if (options.format == "flac") {
+        stream << options.compressionLevel << options.bitDepth;
+    } else if (options.format == "opus" || options.quality < 0) {
+        stream << options.bitrate;
+    } else {
+        stream << options.quality;
+    }
+    if (target.range) {
+        stream << static_cast<qint64>(target.range->start) << static_cast<qint64>(target.range->end);
+    }
+    for (const EncoderTag& tag : encoderTags(tagTrack)) {
+        stream << tag.key << tag.value;
+    }
+
+    const uint64_t key = hashBytes(data.constData(), static_cast<size_t>(data.size()));
+    return key != 0 ? key : 1;
+}
+
+QString EncodeCache::entryPath(uint64_t key, const QString& suffix) const
+{
+    // Spread over 256 folders, directories of 100k files are slow on some file systems
+    const QString name = QString::number(key, 16).rightJustified(16, '0');
+    return m_directory + "/" + name.left(2) + "/" + name + "." + suffix;
+}
+
+QString EncodeCache::lookup(uint64_t key)
+{
+    const QMutexLocker locker{&m_lock};
+
+    if (auto it = m_entries.find(key); it != m_entries.end()) {
+        const QString path = entryPath(key, it->suffix);
+        const QFileInfo info{path};
+        if (info.size() == it->size && info.lastModified().toMSecsSinceEpoch() == it->modified) {
+            it->lastUsed = now();
+            ++m_stats.hits;
+            m_changed = true;
+            return path;
+        }
+
+        // Deleted, or edited through one of its links
+        QFile::remove(path);
+        m_stats.bytes -= it->size;
+        m_entries.erase(it);
+        m_changed = true;
+    }
+
+    ++m_stats.misses;
+    return {};
+}
+
+void EncodeCache::insert(uint64_t key, const QString& outputPath)
+{
+    const QString suffix = QFileInfo{outputPath}.suffix();
+    const QString path = entryPath(key, suffix);
+    QDir{}.mkpath(QFileInfo{path}.absolutePath());
+
+    // Built under a temp name, so a crash never leaves a partial entry
+    const QString tempPath = path + "." + QString::number(QRandomGenerator::global()->generate(), 36) + ".part";
+    const QByteArray tempName = QFile::encodeName(tempPath);
+
+    if (::link(QFile::encodeName(outputPath).constData(), tempName.constData()) != 0) {
+        const std::atomic<bool> cancelled{false};
+        if (QString error; !cloneFile(outputPath, tempPath, cancelled, error)) {
+            qWarning() << "Audio Converter - Cannot add" << outputPath << "to the encode cache:" << error;
+            QFile::remove(tempPath);
+            return;
+        }
+    }
+    if (std::rename(tempName.constData(), QFile::encodeName(path).constData()) != 0) {
+        qWarning() << "Audio Converter - Cannot add" << outputPath << "to the encode cache";
+        QFile::remove(tempPath);
+        return;
+    }
+
+    const QFileInfo info{path};
+
+    const QMutexLocker locker{&m_lock};
+    if (const auto old = m_entries.constFind(key); old != m_entries.cend()) {
+        m_stats.bytes -= old->size;
+    }
+    m_entries.insert(key, {suffix, info.size(), info.lastModified().toMSecsSinceEpoch(), now()});
+    m_stats.bytes += info.size();
+    ++m_stats.stored;
+    m_changed = true;
+
+    evict();
+}
+
+void EncodeCache::evict()
+{
+    if (m_stats.bytes <= m_maxBytes) {
+        return;
+    }
+
+    std::vector<std::pair<qint64, uint64_t>> byAge;
+    byAge.reserve(static_cast<size_t>(m_entries.size()));
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        byAge.emplace_back(it->lastUsed, it.key());
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    const auto target = static_cast<qint64>(static_cast<double>(m_maxBytes) * EvictTarget);
+    for (const auto& [lastUsed, key] : byAge) {
+        if (m_stats.bytes <= target) {
+            break;
+        }
+        // Outputs linked to the entry keep their data
+        const Entry entry = m_entries.take(key);
+        QFile::remove(entryPath(key, entry.suffix));
+        m_stats.bytes -= entry.size;
+        ++m_stats.evicted;
+    }
+}
+
+void EncodeCache::load()
+{
+    QFile file{m_directory + "/" + IndexName};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream{&file};
+    quint32 magic{0};
+    quint32 version{0};
+    stream >> magic >> version;
+    if (magic != IndexMagic || version != IndexVersion) {
+        qWarning() << "Audio Converter - Encode cache index is damaged or from another version, starting empty";
+        return;
+    }
+
+    qint64 count{0};
+    stream >> count;
+    for (qint64 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint64 key{0};
+        Entry entry;
+        stream >> key >> entry.suffix >> entry.size >> entry.modified >> entry.lastUsed;
+        m_entries.insert(key, entry);
+        m_stats.bytes += entry.size;
+    }
+
+    stream >> count;
+    for (qint64 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString path;
+        quint64 hash{0};
+        Source source;
+        stream >> path >> source.size >> source.modified >> hash >> source.lastUsed;
+        source.hash = hash;
+        m_sources.insert(path, source);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Audio Converter - Encode cache index is truncated, starting empty";
+        m_entries.clear();
+        m_sources.clear();
+        m_stats.bytes = 0;
+    }
+}
+
+void EncodeCache::save()
+{
+    QByteArray data;
+    {
+        const QMutexLocker locker{&m_lock};
+        if (!m_changed) {
+            return;
+        }
+
+        if (m_sources.size() > MaxSources) {
+            std::vector<std::pair<qint64, QString>> byAge;
+            byAge.reserve(static_cast<size_t>(m_sources.size()));
+            for (auto it = m_sources.cbegin(); it != m_sources.cend(); ++it) {
+                byAge.emplace_back(it->lastUsed, it.key());
+            }
+            std::sort(byAge.begin(), byAge.end());
+            for (size_t i = 0; i < byAge.size() - static_cast<size_t>(MaxSources); ++i) {
+                m_sources.remove(byAge.at(i).second);
+            }
+        }
+
+        QDataStream stream{&data, QIODevice::WriteOnly};
+        stream << IndexMagic << IndexVersion << static_cast<qint64>(m_entries.size());
+        for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+            stream << static_cast<quint64>(it.key()) << it->suffix << it->size << it->modified << it->lastUsed;
+        }
+        stream << static_cast<qint64>(m_sources.size());
+        for (auto it = m_sources.cbegin(); it != m_sources.cend(); ++it) {
+            stream << it.key() << it->size << it->modified << static_cast<quint64>(it->hash) << it->lastUsed;
+        }
+
+        m_changed = false;
+    }
+
+    QDir{}.mkpath(m_directory);
+    QSaveFile file{m_directory + "/" + IndexName};
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "Audio Converter - Cannot write the encode cache index:" << file.errorString();
+    }
+}
+
+EncodeCache::Stats EncodeCache::stats() const
+{
+    const QMutexLocker locker{&m_lock};
+    return m_stats;
+}
+
+void EncodeCache::resetStats()
+{
+    const QMutexLocker locker{&m_lock};
+    m_stats = {0, 0, 0, 0, m_stats.bytes};
+}
+
+QString defaultEncodeCacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/fooyin/converter";
+}
+
+QThreadPool* encodeCacheThreadPool()
+{
+    static QThreadPool* pool = [] {
+        auto* cachePool = new QThreadPool();
+        cachePool->setMaxThreadCount(1);
+        return cachePool;
+    }();
+    return pool;
+}
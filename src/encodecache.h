@@ -0,0 +1,90 @@
+#pragma once
+
+#include "conversionjob.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+class QThreadPool;
+
+// Content-addressed store of encoded outputs, so the same source encoded with the same
+// settings (e.g. exported to several device folders) is only encoded once. Entries are
+// keyed by the audio fingerprint of the source, the options that affect the output, the
+// encoder and the tags it writes; repeated jobs get a hard link to the entry, or a copy
+// (reflinked where possible) on other file systems. The least recently used entries are
+// evicted once the cache grows past its size limit. Thread-safe.
+class EncodeCache
+{
+public:
+    struct Stats {
+        int hits{0};
+        int misses{0};
+        int stored{0};
+        int evicted{0};
+        qint64 bytes{0}; // Size of all entries
+    };
+
+    EncodeCache(QString directory, qint64 maxBytes);
+
+    QString directory() const { return m_directory; }
+    // Evicts right away if the cache is larger than maxBytes
+    void setMaxBytes(qint64 maxBytes);
+
+    // audioFingerprint() of the file, remembered by path, size and timestamp so repeated
+    // exports don't read sources again. Reads the whole file otherwise.
+    uint64_t sourceHash(const QString& path);
+
+    // Identifies the output of target for the source with sourceHash, encoded by encoder
+    // (name and version) and tagged with the library metadata of tagTrack
+    static uint64_t key(uint64_t sourceHash, const ConversionTarget& target, const Fooyin::Track& tagTrack,
+                        const QString& encoder);
+
+    // Path of the entry for key, empty on a miss. Entries changed since they were
+    // stored (a linked output edited in place) are dropped.
+    QString lookup(uint64_t key);
+    // Adds the finished output as the entry for key; a hard link where the file system
+    // allows it, a copy otherwise. Evicts old entries as needed. Blocks on I/O.
+    void insert(uint64_t key, const QString& outputPath);
+
+    // Writes the index to the cache folder. Blocks on I/O.
+    void save();
+
+    Stats stats() const;
+    void resetStats();
+
+private:
+    struct Entry {
+        QString suffix;
+        qint64 size{0};
+        qint64 modified{0}; // File timestamp when stored, in ms
+        qint64 lastUsed{0};
+    };
+
+    struct Source {
+        qint64 size{0};
+        qint64 modified{0};
+        uint64_t hash{0};
+        qint64 lastUsed{0};
+    };
+
+    QString entryPath(uint64_t key, const QString& suffix) const;
+    void load();
+    void evict();
+
+    const QString m_directory;
+
+    mutable QMutex m_lock;
+    qint64 m_maxBytes;
+    QHash<uint64_t, Entry> m_entries;
+    QHash<QString, Source> m_sources;
+    Stats m_stats;
+    bool m_changed{false};
+};
+
+// Used when no cache folder is set
+QString defaultEncodeCacheDirectory();
+
+// Single worker for hashing sources and filling the cache, so it never competes with
+// itself for the disk
+QThreadPool* encodeCacheThreadPool();
@@ -0,0 +1,54 @@
+#include "encodertags.h"
+
+#include <core/track.h>
+
+namespace {
+void addTag(QList<EncoderTag>& tags, const QString& key, const QString& value)
+{
+    if (!value.isEmpty()) {
+        tags.append({key, value});
+    }
+}
+
+void addTags(QList<EncoderTag>& tags, const QString& key, const QStringList& values)
+{
+    for (const QString& value : values) {
+        addTag(tags, key, value);
+    }
+}
+} // namespace
+
+QList<EncoderTag> encoderTags(const Fooyin::Track& track)
+{
+    QList<EncoderTag> tags;
+
+    addTag(tags, "TITLE", track.title());
+    addTags(tags, "ARTIST", track.artists());
+    addTag(tags, "ALBUM", track.album());
+    addTags(tags, "ALBUMARTIST", track.albumArtists());
+    addTag(tags, "TRACKNUMBER", track.trackNumber());
+    addTag(tags, "TRACKTOTAL", track.trackTotal());
+    addTag(tags, "DISCNUMBER", track.discNumber());
+    addTag(tags, "DISCTOTAL", track.discTotal());
+    addTags(tags, "GENRE", track.genres());
+    addTag(tags, "DATE", track.date());
+    addTag(tags, "COMPOSER", track.composer());
+    addTag(tags, "PERFORMER", track.performer());
+    addTag(tags, "COMMENT", track.comment());
+
+    const auto extraTags = track.extraTags();
+    for (auto it = extraTags.cbegin(); it != extraTags.cend(); ++it) {
+        addTags(tags, it.key().toUpper(), it.value());
+    }
+
+    return tags;
+}
+
+QStringList encoderTagArguments(const QString& option, const Fooyin::Track& track)
+{
+    QStringList args;
+    for (const EncoderTag& tag : encoderTags(track)) {
+        args << option << tag.key + "=" + tag.value;
+    }
+    return args;
+}
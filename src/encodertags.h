@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+namespace Fooyin {
+class Track;
+}
+
+// A single tag in Vorbis comment naming (TITLE, ARTIST, ...)
+struct EncoderTag {
+    QString key;
+    QString value;
+};
+
+// Tags of a library track for encoders that write metadata themselves.
+// Returns an empty list if the track carries no metadata.
+QList<EncoderTag> encoderTags(const Fooyin::Track& track);
+
+// The same tags as command line arguments of a CLI encoder that takes Vorbis comments,
+// option followed by "KEY=value" for every tag (e.g. "-T" for flac, "-c" for oggenc)
+QStringList encoderTagArguments(const QString& option, const Fooyin::Track& track);
@@ -0,0 +1,133 @@
+#include "filecopy.h"
+#include "localstaging.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace {
+// copy_file_range() calls are split so a cancel doesn't wait for a whole file
+constexpr size_t CopyRangeBytes = 64 * 1024 * 1024;
+
+enum class CopyResult
+{
+    Done,
+    Unsupported, // Nothing written yet, another method may be tried
+    Failed,
+};
+
+#ifdef Q_OS_LINUX
+CopyResult copyRange(int in, int out, off_t size, const std::atomic<bool>& cancelled, QString& error)
+{
+    off_t copied{0};
+    while (copied < size) {
+        if (cancelled.load(std::memory_order_relaxed)) {
+            error = "Canceled";
+            return CopyResult::Failed;
+        }
+
+        const ssize_t count = ::copy_file_range(in, nullptr, out, nullptr, CopyRangeBytes, 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Old kernels, and file systems that can't copy between each other
+            if (copied == 0
+                && (errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP || errno == EINVAL || errno == EBADF)) {
+                return CopyResult::Unsupported;
+            }
+            error = "Cannot copy file: " + QString::fromLocal8Bit(std::strerror(errno));
+            return CopyResult::Failed;
+        }
+        if (count == 0) {
+            break;
+        }
+        copied += count;
+    }
+    return CopyResult::Done;
+}
+#endif
+} // namespace
+
+bool cloneFile(const QString& source, const QString& destination, const std::atomic<bool>& cancelled,
+               QString& error)
+{
+#ifdef Q_OS_LINUX
+    const int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        error = "Cannot open input file: " + QString::fromLocal8Bit(std::strerror(errno));
+        return false;
+    }
+
+    const int out = ::open(QFile::encodeName(destination).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (out < 0) {
+        error = "Cannot write output: " + QString::fromLocal8Bit(std::strerror(errno));
+        ::close(in);
+        return false;
+    }
+
+    struct stat info{};
+    CopyResult result{CopyResult::Unsupported};
+
+    if (::fstat(in, &info) == 0) {
+        // A reflink shares the extents, nothing is copied until one side is modified
+        if (::ioctl(out, FICLONE, in) == 0) {
+            result = CopyResult::Done;
+        } else {
+            result = copyRange(in, out, info.st_size, cancelled, error);
+        }
+    }
+
+    const bool closed = ::close(out) == 0;
+    ::close(in);
+
+    if (result == CopyResult::Done && !closed) {
+        error = "Cannot write output: " + QString::fromLocal8Bit(std::strerror(errno));
+        return false;
+    }
+    if (result != CopyResult::Unsupported) {
+        return result == CopyResult::Done;
+    }
+#endif
+
+    return copyOutFile(source, destination, cancelled, error);
+}
+
+bool unshareFile(const QString& path, QString& error)
+{
+    const QByteArray name = QFile::encodeName(path);
+    struct stat info{};
+    if (::stat(name.constData(), &info) != 0) {
+        error = QString::fromLocal8Bit(std::strerror(errno));
+        return false;
+    }
+    if (info.st_nlink <= 1) {
+        return true;
+    }
+
+    const QFileInfo fileInfo{path};
+    const QString tempPath = fileInfo.absolutePath() + "/." + fileInfo.fileName() + "."
+                           + QString::number(QRandomGenerator::global()->generate(), 36) + ".part";
+    const std::atomic<bool> cancelled{false};
+    if (!cloneFile(path, tempPath, cancelled, error)) {
+        QFile::remove(tempPath);
+        return false;
+    }
+    if (::rename(QFile::encodeName(tempPath).constData(), name.constData()) != 0) {
+        error = QString::fromLocal8Bit(std::strerror(errno));
+        QFile::remove(tempPath);
+        return false;
+    }
+    return true;
+}
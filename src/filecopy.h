@@ -0,0 +1,16 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+
+// Copies source to destination (truncated first), sharing the data where the file
+// system allows it: a reflink (FICLONE) on Btrfs, XFS and bcachefs, copy_file_range()
+// for in-kernel and server-side (NFS 4.2, SMB) copies, plain reads and writes otherwise.
+// Gives up between chunks once cancelled is set.
+bool cloneFile(const QString& source, const QString& destination, const std::atomic<bool>& cancelled,
+               QString& error);
+
+// Gives path a data copy of its own if it is hard linked elsewhere (e.g. to the encode
+// cache), so writing to it in place doesn't change the other links. Atomic.
+bool unshareFile(const QString& path, QString& error);
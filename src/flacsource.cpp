@@ -0,0 +1,124 @@
+#include "flacsource.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+
+FlacSource::FlacSource()
+    : m_decoder{FLAC__stream_decoder_new()}
+{ }
+
+FlacSource::~FlacSource()
+{
+    if (m_decoder) {
+        FLAC__stream_decoder_finish(m_decoder);
+        FLAC__stream_decoder_delete(m_decoder);
+    }
+}
+
+bool FlacSource::open(const QString& path)
+{
+    if (!m_decoder) {
+        m_error = "Failed to create FLAC decoder";
+        return false;
+    }
+
+    const QByteArray filename = QFile::encodeName(path);
+    const auto status = FLAC__stream_decoder_init_file(m_decoder, filename.constData(), &FlacSource::writeCallback,
+                                                       &FlacSource::metadataCallback, &FlacSource::errorCallback,
+                                                       this);
+    if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+        m_error = QString("Cannot open FLAC file: %1").arg(FLAC__StreamDecoderInitStatusString[status]);
+        return false;
+    }
+
+    // STREAMINFO carries the format and length
+    if (!FLAC__stream_decoder_process_until_end_of_metadata(m_decoder) || !m_format.isValid()) {
+        m_error = "Invalid FLAC stream";
+        return false;
+    }
+
+    return true;
+}
+
+int64_t FlacSource::read(float* buffer, int64_t maxFrames)
+{
+    const int channels = m_format.channels;
+    int64_t framesCopied{0};
+
+    while (framesCopied < maxFrames) {
+        if (m_pendingPos >= m_pending.size()) {
+            m_pending.clear();
+            m_pendingPos = 0;
+
+            if (FLAC__stream_decoder_get_state(m_decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) {
+                break;
+            }
+            if (!FLAC__stream_decoder_process_single(m_decoder)) {
+                m_error = QString("FLAC decoding error: %1")
+                              .arg(FLAC__stream_decoder_get_resolved_state_string(m_decoder));
+                return -1;
+            }
+            continue;
+        }
+
+        const auto available = static_cast<int64_t>((m_pending.size() - m_pendingPos) / channels);
+        const int64_t frames = std::min(available, maxFrames - framesCopied);
+
+        std::memcpy(buffer + framesCopied * channels, m_pending.data() + m_pendingPos,
+                    static_cast<size_t>(frames * channels) * sizeof(float));
+
+        m_pendingPos += static_cast<size_t>(frames * channels);
+        framesCopied += frames;
+    }
+
+    return framesCopied;
+}
+
+FLAC__StreamDecoderWriteStatus FlacSource::writeCallback(const FLAC__StreamDecoder* /*decoder*/,
+                                                         const FLAC__Frame* frame,
+                                                         const FLAC__int32* const buffer[], void* clientData)
+{
+    auto* self = static_cast<FlacSource*>(clientData);
+
+    const unsigned channels = frame->header.channels;
+    const unsigned blocksize = frame->header.blocksize;
+    const float scale = 1.0F / static_cast<float>(1U << (frame->header.bits_per_sample - 1));
+
+    // Interleave the per-channel planes
+    const size_t offset = self->m_pending.size();
+    self->m_pending.resize(offset + static_cast<size_t>(blocksize) * channels);
+    float* out = self->m_pending.data() + offset;
+
+    for (unsigned i = 0; i < blocksize; ++i) {
+        for (unsigned ch = 0; ch < channels; ++ch) {
+            *out++ = static_cast<float>(buffer[ch][i]) * scale;
+        }
+    }
+
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void FlacSource::metadataCallback(const FLAC__StreamDecoder* /*decoder*/, const FLAC__StreamMetadata* metadata,
+                                  void* clientData)
+{
+    if (metadata->type != FLAC__METADATA_TYPE_STREAMINFO) {
+        return;
+    }
+
+    auto* self = static_cast<FlacSource*>(clientData);
+    const auto& info = metadata->data.stream_info;
+
+    self->m_format.sampleRate = static_cast<int>(info.sample_rate);
+    self->m_format.channels = static_cast<int>(info.channels);
+    self->m_format.bitsPerSample = static_cast<int>(info.bits_per_sample);
+    self->m_totalFrames = info.total_samples;
+}
+
+void FlacSource::errorCallback(const FLAC__StreamDecoder* /*decoder*/, FLAC__StreamDecoderErrorStatus status,
+                               void* clientData)
+{
+    auto* self = static_cast<FlacSource*>(clientData);
+    self->m_error = QString("FLAC decoding error: %1").arg(FLAC__StreamDecoderErrorStatusString[status]);
+}
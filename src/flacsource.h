@@ -0,0 +1,37 @@
+#pragma once
+
+#include "pcmsource.h"
+
+#include <FLAC/stream_decoder.h>
+
+#include <vector>
+
+// Decodes FLAC files with libFLAC
+class FlacSource : public PcmSource
+{
+public:
+    FlacSource();
+    ~FlacSource() override;
+
+    bool open(const QString& path) override;
+    PcmFormat format() const override { return m_format; }
+    uint64_t totalFrames() const override { return m_totalFrames; }
+    int64_t read(float* buffer, int64_t maxFrames) override;
+
+private:
+    static FLAC__StreamDecoderWriteStatus writeCallback(const FLAC__StreamDecoder* decoder,
+                                                        const FLAC__Frame* frame,
+                                                        const FLAC__int32* const buffer[], void* clientData);
+    static void metadataCallback(const FLAC__StreamDecoder* decoder, const FLAC__StreamMetadata* metadata,
+                                 void* clientData);
+    static void errorCallback(const FLAC__StreamDecoder* decoder, FLAC__StreamDecoderErrorStatus status,
+                              void* clientData);
+
+    FLAC__StreamDecoder* m_decoder;
+    PcmFormat m_format;
+    uint64_t m_totalFrames{0};
+
+    // Decoded frames not yet handed out by read()
+    std::vector<float> m_pending;
+    size_t m_pendingPos{0};
+};
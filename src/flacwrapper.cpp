@@ -1,7 +1,10 @@
 #include "flacwrapper.h"
+#include "encodertags.h"
+#include "pcmstream.h"
 #include <QDebug>
 #include <QRegularExpression>
 #include <QFile>
+#include <QThread>
 
 FlacWrapper::FlacWrapper(QObject* parent)
     : CodecWrapper(parent)
@@ -10,6 +13,8 @@ FlacWrapper::FlacWrapper(QObject* parent)
 
     if (m_execPath.isEmpty()) {
         qWarning() << "FLAC encoder not found in PATH";
+    } else {
+        m_capabilities = codecCapabilities(m_execPath, {"flac ([0-9.]+)", {"--threads"}});
     }
 }
 
@@ -24,19 +29,7 @@ QString FlacWrapper::version() const
         return "Not found";
     }
 
-    QProcess process;
-    process.start(m_execPath, {"--version"});
-    process.waitForFinished();
-
-    QString output = process.readAllStandardOutput();
-    QRegularExpression versionRegex("flac ([0-9.]+)");
-    QRegularExpressionMatch match = versionRegex.match(output);
-
-    if (match.hasMatch()) {
-        return match.captured(1);
-    }
-
-    return "Unknown";
+    return m_capabilities.version;
 }
 
 QStringList FlacWrapper::buildArguments(
@@ -70,6 +63,36 @@ QStringList FlacWrapper::buildArguments(
     return args;
 }
 
+QStringList FlacWrapper::buildStreamArguments(
+    const PcmFormat& format,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    QStringList args;
+
+    // Compression level (0-8, default 8)
+    args << QString("-%1").arg(options.compressionLevel);
+
+    args << "--force" << "--verify";
+
+    // Raw input layout, must match CodecWrapper's stdin feeder
+    args << "--force-raw-format" << "--endian=little" << "--sign=signed";
+    args << QString("--channels=%1").arg(format.channels);
+    args << QString("--bps=%1").arg(streamBitsPerSample(format));
+    args << QString("--sample-rate=%1").arg(format.sampleRate);
+
+    // Raw input has no tags to carry over, they come from the library
+    args << encoderTagArguments("-T", m_sourceTrack);
+
+    // Output file
+    args << "-o" << outputPath;
+
+    // Read from stdin
+    args << "-";
+
+    return args;
+}
+
 bool FlacWrapper::convert(
     const QString& inputPath,
     const QString& outputPath,
@@ -82,6 +105,11 @@ bool FlacWrapper::convert(
 
     QStringList args = buildArguments(inputPath, outputPath, options);
 
+    // A blocking conversion runs on its own, so flac 1.5+ may use every core for it
+    if (m_capabilities.supports("--threads")) {
+        args.prepend(QString("--threads=%1").arg(qMin(QThread::idealThreadCount(), 64)));
+    }
+
     QProcess process;
     process.start(m_execPath, args);
 
@@ -114,13 +142,38 @@ void FlacWrapper::convertAsync(
         return;
     }
 
+    startProcess(buildArguments(inputPath, outputPath, options), outputPath, nullptr);
+}
+
+void FlacWrapper::convertStreamAsync(
+    std::shared_ptr<PcmStream> stream,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    if (m_process) {
+        qWarning() << "Conversion already in progress";
+        return;
+    }
+
+    const QStringList args = buildStreamArguments(stream->format(), outputPath, options);
+    startProcess(args, outputPath, std::move(stream));
+}
+
+void FlacWrapper::startProcess(const QStringList& args, const QString& outputPath, std::shared_ptr<PcmStream> stream)
+{
     m_outputPath = outputPath;
     m_process = new QProcess(this);
+    measureProcess();
+
+    // Streams report progress from the frames fed instead
+    const bool streaming = stream != nullptr;
 
     // Connect progress monitoring (FLAC outputs progress to stderr)
-    connect(m_process, &QProcess::readyReadStandardError, this, [this]() {
+    connect(m_process, &QProcess::readyReadStandardError, this, [this, streaming]() {
         QString output = m_process->readAllStandardError();
-        parseProgress(output);
+        if (!streaming) {
+            parseProgress(output);
+        }
     });
 
     // Connect completion
@@ -133,6 +186,14 @@ void FlacWrapper::convertAsync(
             error = m_process->readAllStandardError();
         }
 
+        // A failed decode stops the encoder early, so report the decoder's error instead
+        detachStream();
+        if (const QString streamError = takeStreamError(); !streamError.isEmpty()) {
+            success = false;
+            error = streamError;
+            QFile::remove(m_outputPath);
+        }
+
         m_process->deleteLater();
         m_process = nullptr;
         m_outputPath.clear();
@@ -140,13 +201,36 @@ void FlacWrapper::convertAsync(
         emit conversionFinished(success, error);
     });
 
+    // A process that fails to start never emits finished(), which would hold its job slot forever
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError processError) {
+        if (processError != QProcess::FailedToStart) {
+            return;
+        }
+
+        QString error = m_process->errorString();
+
+        detachStream();
+        m_process->deleteLater();
+        m_process = nullptr;
+        m_outputPath.clear();
+
+        emit conversionFinished(false, error);
+    });
+
+    if (stream) {
+        const int bitsPerSample = streamBitsPerSample(stream->format());
+        attachStream(std::move(stream), bitsPerSample);
+    }
+
     // Start conversion
-    QStringList args = buildArguments(inputPath, outputPath, options);
     m_process->start(m_execPath, args);
 }
 
 void FlacWrapper::cancel()
 {
+    // Unblocks the decoder thread feeding a stream
+    detachStream();
+
     if (m_process && m_process->state() != QProcess::NotRunning) {
         // Disconnect signals to avoid spurious callbacks
         m_process->disconnect();
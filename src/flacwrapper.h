@@ -1,5 +1,6 @@
 #pragma once
 
+#include "codeccapabilities.h"
 #include "codecwrapper.h"
 
 class FlacWrapper : public CodecWrapper
@@ -25,6 +26,12 @@ public:
         const ConversionOptions& options
     ) override;
 
+    void convertStreamAsync(
+        std::shared_ptr<PcmStream> stream,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) override;
+
     void cancel() override;
 
 private:
@@ -34,7 +41,16 @@ private:
         const ConversionOptions& options
     );
 
+    // Raw PCM on stdin instead of an input file
+    QStringList buildStreamArguments(
+        const PcmFormat& format,
+        const QString& outputPath,
+        const ConversionOptions& options
+    );
+
+    void startProcess(const QStringList& args, const QString& outputPath, std::shared_ptr<PcmStream> stream);
     void parseProgress(const QString& output);
 
     QString m_execPath;
+    CodecCapabilities m_capabilities;
 };
@@ -0,0 +1,163 @@
+#include "inprocessencoder.h"
+#include "pcmsource.h"
+#include "pcmstream.h"
+#include "tracing.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+InProcessEncoder::InProcessEncoder(QObject* parent)
+    : CodecWrapper(parent)
+{ }
+
+InProcessEncoder::~InProcessEncoder()
+{
+    // The worker still references this object
+    m_canceled = true;
+    if (m_inputStream) {
+        m_inputStream->abort();
+    }
+    m_future.waitForFinished();
+}
+
+QThreadPool* InProcessEncoder::encoderThreadPool()
+{
+    static QThreadPool* pool = [] {
+        auto* encoderPool = new QThreadPool();
+        // Every started encoder needs its thread right away: the targets of one job share a decoder,
+        // so an encoder left queued stalls the others. The manager's slots bound how many run.
+        encoderPool->setMaxThreadCount(256);
+        return encoderPool;
+    }();
+    return pool;
+}
+
+bool InProcessEncoder::canConvert(const QString& inputPath, const ConversionOptions& options) const
+{
+    Q_UNUSED(options);
+    return PcmSource::canOpen(inputPath);
+}
+
+bool InProcessEncoder::run(
+    std::unique_ptr<PcmSource> source,
+    const QString& outputPath,
+    const ConversionOptions& options,
+    QString& error)
+{
+    if (!source) {
+        return false;
+    }
+
+    m_lastPercent = -1;
+    const Trace::Scope scope{"encoder"};
+    const EncoderUsage start = threadUsage();
+    const bool success = encode(*source, outputPath, options, error);
+    m_usage = threadUsageSince(start);
+
+    // Never leave a partial file behind
+    if (!success || isCanceled()) {
+        QFile::remove(outputPath);
+    }
+
+    return success && !isCanceled();
+}
+
+bool InProcessEncoder::convert(
+    const QString& inputPath,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    QString error;
+    if (!run(PcmSource::create(inputPath, &error), outputPath, options, error)) {
+        qWarning() << executableName() << "encoding failed:" << error;
+        return false;
+    }
+    return true;
+}
+
+void InProcessEncoder::convertAsync(
+    const QString& inputPath,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    startWorker(outputPath, [this, inputPath, outputPath, options](QString& error) {
+        return run(PcmSource::create(inputPath, &error), outputPath, options, error);
+    });
+}
+
+void InProcessEncoder::convertStreamAsync(
+    std::shared_ptr<PcmStream> stream,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    if (m_future.isRunning()) {
+        qWarning() << "Conversion already in progress";
+        return;
+    }
+
+    m_inputStream = stream;
+    const QString inputPath = m_sourceTrack.filepath();
+
+    startWorker(outputPath, [this, stream, inputPath, outputPath, options](QString& error) {
+        auto source = std::make_unique<PcmStreamSource>(stream);
+        source->open(inputPath);
+
+        const bool success = run(std::move(source), outputPath, options, error);
+
+        // Releases the decoder thread if the encoder gave up early
+        stream->abort();
+        return success;
+    });
+}
+
+void InProcessEncoder::startWorker(const QString& outputPath, std::function<bool(QString&)> job)
+{
+    if (m_future.isRunning()) {
+        qWarning() << "Conversion already in progress";
+        return;
+    }
+
+    m_canceled = false;
+    m_outputPath = outputPath;
+
+    m_future = QtConcurrent::run(encoderThreadPool(), [this, job = std::move(job)]() {
+        QString error;
+        const bool success = job(error);
+
+        // A canceled job reports nothing, same as the CLI wrappers
+        if (!isCanceled()) {
+            emit conversionFinished(success, error);
+        }
+    });
+}
+
+void InProcessEncoder::cancel()
+{
+    m_canceled = true;
+    if (m_inputStream) {
+        // Wakes an encoder waiting for decoded data
+        m_inputStream->abort();
+        m_inputStream.reset();
+    }
+    m_future.waitForFinished();
+
+    // Delete partially converted file if it exists
+    if (!m_outputPath.isEmpty()) {
+        QFile::remove(m_outputPath);
+        m_outputPath.clear();
+    }
+}
+
+void InProcessEncoder::reportProgress(uint64_t framesDone, uint64_t totalFrames)
+{
+    if (totalFrames == 0) {
+        return;
+    }
+
+    const int percent = static_cast<int>(qMin<uint64_t>(100, framesDone * 100 / totalFrames));
+    if (m_lastPercent.exchange(percent) != percent) {
+        emit progressChanged(percent);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "codecwrapper.h"
+
+#include <QFuture>
+
+#include <atomic>
+#include <functional>
+
+class PcmSource;
+class QThreadPool;
+
+// Base for encoders that link the codec library directly instead of running a CLI tool.
+// Encoding runs on a shared worker pool with a thread for every started encoder; progress comes
+// from the number of frames encoded.
+class InProcessEncoder : public CodecWrapper
+{
+    Q_OBJECT
+
+public:
+    explicit InProcessEncoder(QObject* parent = nullptr);
+    ~InProcessEncoder() override;
+
+    bool isAvailable() const override { return true; }
+    bool canConvert(const QString& inputPath, const ConversionOptions& options) const override;
+
+    bool convert(
+        const QString& inputPath,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) override;
+
+    void convertAsync(
+        const QString& inputPath,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) override;
+
+    void convertStreamAsync(
+        std::shared_ptr<PcmStream> stream,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) override;
+
+    void cancel() override;
+
+    // Pool shared by all in-process encoders
+    static QThreadPool* encoderThreadPool();
+
+protected:
+    // Encodes all of source to outputPath on the calling (worker) thread.
+    // Implementations should poll isCanceled() between blocks.
+    virtual bool encode(
+        PcmSource& source,
+        const QString& outputPath,
+        const ConversionOptions& options,
+        QString& error
+    ) = 0;
+
+    bool isCanceled() const { return m_canceled.load(std::memory_order_relaxed); }
+
+    // Thread-safe, only emits when the percentage changes
+    void reportProgress(uint64_t framesDone, uint64_t totalFrames);
+
+    // Frames handed to the encoder per call
+    static constexpr int64_t BlockFrames = 4096;
+
+private:
+    bool run(std::unique_ptr<PcmSource> source, const QString& outputPath, const ConversionOptions& options,
+             QString& error);
+    void startWorker(const QString& outputPath, std::function<bool(QString&)> job);
+
+    QFuture<void> m_future;
+    std::shared_ptr<PcmStream> m_inputStream;
+    std::atomic<bool> m_canceled{false};
+    std::atomic<int> m_lastPercent{-1};
+};
@@ -0,0 +1,234 @@
+#include "inputprefetcher.h"
+
+#include <QFile>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// How far ahead of the encoders the cache is warmed, in seconds of their input rate
+constexpr double LeadSeconds = 20.0;
+// Look-ahead until the first job has finished and the rate is known
+constexpr qint64 InitialWindowBytes = 128 * 1024 * 1024;
+constexpr qint64 MaxMemoryBudget = 1024LL * 1024 * 1024;
+// Share of an input that must be cached for its job to count as a hit
+constexpr double HitResidency = 0.9;
+
+// Element type of the mincore() vector
+#ifdef Q_OS_LINUX
+using PageFlags = unsigned char;
+#else
+using PageFlags = char; // macOS and the BSDs
+#endif
+
+// Hints the first length bytes of path, returns the bytes hinted
+qint64 hintFile(const QString& path, qint64 length)
+{
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat info{};
+    qint64 hinted{0};
+    if (::fstat(fd, &info) == 0) {
+        hinted = std::min<qint64>(length, info.st_size);
+#ifdef POSIX_FADV_WILLNEED
+        // Queues asynchronous reads, the pages land in the cache in the background
+        ::posix_fadvise(fd, 0, hinted, POSIX_FADV_WILLNEED);
+#endif
+    }
+
+    ::close(fd);
+    return hinted;
+}
+
+// Size of path and how much of it is in the page cache
+std::pair<qint64, qint64> residency(const QString& path)
+{
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return {0, 0};
+    }
+
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return {0, 0};
+    }
+
+    const auto size = static_cast<size_t>(info.st_size);
+    qint64 resident{0};
+
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map != MAP_FAILED) {
+        const auto pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        std::vector<PageFlags> pages((size + pageSize - 1) / pageSize);
+        if (::mincore(map, size, pages.data()) == 0) {
+            const auto cached = std::count_if(pages.cbegin(), pages.cend(), [](PageFlags page) { return page & 1; });
+            resident = std::min<qint64>(static_cast<qint64>(cached * pageSize), info.st_size);
+        }
+        ::munmap(map, size);
+    }
+
+    ::close(fd);
+    return {info.st_size, resident};
+}
+} // namespace
+
+InputPrefetcher::InputPrefetcher(QObject* parent)
+    : QObject{parent}
+    , m_stallMs{std::make_shared<std::atomic<int64_t>>(0)}
+    , m_batchStart{std::chrono::steady_clock::now()}
+{
+    // A sixteenth of the RAM, so warming the cache never pushes out much else
+    const auto physicalBytes = static_cast<qint64>(::sysconf(_SC_PHYS_PAGES)) * ::sysconf(_SC_PAGESIZE);
+    m_memoryBudget = physicalBytes > 0 ? std::min(physicalBytes / 16, MaxMemoryBudget) : InitialWindowBytes;
+}
+
+InputPrefetcher::~InputPrefetcher()
+{
+    // Pending tasks post back to this object
+    prefetchThreadPool()->clear();
+    prefetchThreadPool()->waitForDone();
+}
+
+QThreadPool* InputPrefetcher::prefetchThreadPool()
+{
+    static QThreadPool* pool = [] {
+        auto* prefetchPool = new QThreadPool();
+        // Hints and residency checks are served in order
+        prefetchPool->setMaxThreadCount(1);
+        return prefetchPool;
+    }();
+    return pool;
+}
+
+void InputPrefetcher::reset()
+{
+    ++m_generation;
+    m_stats = {};
+    m_stallMs->store(0);
+    m_hinted.clear();
+    m_inputSizes.clear();
+    m_consumedBytes = 0;
+    m_batchStart = std::chrono::steady_clock::now();
+}
+
+qint64 InputPrefetcher::windowBytes() const
+{
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_batchStart).count();
+    if (m_consumedBytes == 0 || elapsed <= 0.0) {
+        return std::min(m_memoryBudget, InitialWindowBytes);
+    }
+
+    const double bytesPerSecond = static_cast<double>(m_consumedBytes) / elapsed;
+    return std::min(m_memoryBudget, static_cast<qint64>(bytesPerSecond * LeadSeconds));
+}
+
+void InputPrefetcher::update(const QList<Input>& upcoming)
+{
+    // Walk the queue until the window is used up; the next input is always warmed
+    const qint64 window = windowBytes();
+    qint64 planned{0};
+    int depth{0};
+    QList<Input> hints;
+
+    for (const Input& input : upcoming) {
+        if (depth > 0 && planned >= window) {
+            break;
+        }
+        ++depth;
+
+        // Sizes of loose files may be unknown, count them as a full window.
+        // The last input is only warmed as far as the window reaches.
+        const qint64 size = input.size > 0 ? input.size : window;
+        const qint64 length = std::min(size, window - planned);
+        planned += size;
+
+        if (!m_hinted.contains(input.path)) {
+            m_hinted.insert(input.path);
+            hints.append({input.path, length});
+        }
+    }
+
+    m_stats.depth = depth;
+    if (hints.isEmpty()) {
+        return;
+    }
+
+    // Input::size is the length to warm here
+    prefetchThreadPool()->start([this, hints, generation = m_generation] {
+        qint64 bytes{0};
+        for (const Input& hint : hints) {
+            bytes += hintFile(hint.path, hint.size);
+        }
+        QMetaObject::invokeMethod(
+            this,
+            [this, count = hints.size(), bytes, generation] {
+                if (generation == m_generation) {
+                    m_stats.hinted += static_cast<int>(count);
+                    m_stats.hintedBytes += bytes;
+                }
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void InputPrefetcher::jobStarted(const QString& path)
+{
+    // Filled in by the check; a job that finishes first is counted by it
+    m_inputSizes.insert(path, 0);
+
+    // open() and mmap() may block on a slow disk, so the check runs on the worker as well.
+    // mincore() does no I/O; the check is queued ahead of the hints that follow.
+    prefetchThreadPool()->start([this, path, generation = m_generation] {
+        const auto [size, resident] = residency(path);
+        QMetaObject::invokeMethod(
+            this,
+            [this, path, size, resident, generation] {
+                if (generation != m_generation || size <= 0) {
+                    return;
+                }
+
+                if (const auto input = m_inputSizes.find(path); input != m_inputSizes.end()) {
+                    input.value() = size;
+                } else {
+                    m_consumedBytes += size;
+                }
+                if (static_cast<double>(resident) >= HitResidency * static_cast<double>(size)) {
+                    ++m_stats.hits;
+                } else {
+                    ++m_stats.misses;
+                }
+                m_stats.coldBytes += size - resident;
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void InputPrefetcher::jobFinished(const QString& path)
+{
+    m_consumedBytes += m_inputSizes.take(path);
+}
+
+std::function<void()> InputPrefetcher::stallTimer() const
+{
+    return [stallMs = m_stallMs, start = std::chrono::steady_clock::now()] {
+        const auto stall = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        stallMs->fetch_add(stall.count(), std::memory_order_relaxed);
+    };
+}
+
+InputPrefetcher::Stats InputPrefetcher::stats() const
+{
+    Stats stats{m_stats};
+    stats.stallMs = m_stallMs->load(std::memory_order_relaxed);
+    return stats;
+}
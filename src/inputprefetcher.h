@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+class QThreadPool;
+
+// Warms the page cache for the inputs of the next queued jobs, so on spinning disks
+// the decoder of a new job doesn't stall on cold reads while the running jobs finish.
+// The look-ahead covers as much input as the jobs consume in a few seconds, measured
+// over the batch, capped by a memory budget. Hints and cache checks run on a worker thread.
+class InputPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Input {
+        QString path;
+        qint64 size{0}; // 0 = unknown
+    };
+
+    struct Stats {
+        int hinted{0};         // Inputs passed to posix_fadvise(WILLNEED)
+        qint64 hintedBytes{0};
+        int hits{0};           // Jobs whose input was (almost) fully cached when they started
+        int misses{0};
+        qint64 coldBytes{0};   // Input that was not cached when its job started
+        int64_t stallMs{0};    // Job start to first decoded block, summed over all jobs
+        int depth{0};          // Current look-ahead in inputs
+    };
+
+    explicit InputPrefetcher(QObject* parent = nullptr);
+    ~InputPrefetcher() override;
+
+    // Clears the statistics and throughput for a new batch
+    void reset();
+
+    // Upcoming inputs, in the order their jobs will start
+    void update(const QList<Input>& upcoming);
+
+    // Records how much of the input is cached as its job starts, call before opening it.
+    // Checked on the worker thread, the result shows up in stats() a moment later.
+    void jobStarted(const QString& path);
+    // Feeds the throughput estimate
+    void jobFinished(const QString& path);
+
+    // Returns a callback for the decoder thread, reporting the stall of a job started now
+    std::function<void()> stallTimer() const;
+
+    Stats stats() const;
+
+private:
+    static QThreadPool* prefetchThreadPool();
+    qint64 windowBytes() const;
+
+    qint64 m_memoryBudget;
+    Stats m_stats;
+    std::shared_ptr<std::atomic<int64_t>> m_stallMs; // Written by decoder threads
+    QSet<QString> m_hinted;
+    QHash<QString, qint64> m_inputSizes; // Of started jobs, for the throughput
+    std::chrono::steady_clock::time_point m_batchStart;
+    qint64 m_consumedBytes{0};
+    uint64_t m_generation{0}; // Results of a previous batch are dropped
+};
@@ -0,0 +1,202 @@
+#include "jobstats.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+
+#include <sys/resource.h>
+
+namespace {
+qint64 microseconds(const timeval& time)
+{
+    return static_cast<qint64>(time.tv_sec) * 1000000 + time.tv_usec;
+}
+
+// RUSAGE_CHILDREN as of the last finished child, shared by all meters
+struct ChildTotals {
+    QMutex lock;
+    bool initialized{false};
+    qint64 userCpuUs{0};
+    qint64 systemCpuUs{0};
+    qint64 maxRssKiB{0};
+};
+
+ChildTotals& childTotals()
+{
+    static ChildTotals totals;
+    return totals;
+}
+
+// Children reaped before the first encoder (e.g. the codec probes) aren't anyone's
+void initChildTotals()
+{
+    ChildTotals& totals = childTotals();
+    const QMutexLocker locker{&totals.lock};
+    if (totals.initialized) {
+        return;
+    }
+
+    rusage usage{};
+    getrusage(RUSAGE_CHILDREN, &usage);
+    totals.userCpuUs = microseconds(usage.ru_utime);
+    totals.systemCpuUs = microseconds(usage.ru_stime);
+    totals.maxRssKiB = usage.ru_maxrss;
+    totals.initialized = true;
+}
+
+QString csvField(const QString& value)
+{
+    if (!value.contains(QLatin1Char(',')) && !value.contains(QLatin1Char('"')) && !value.contains(QLatin1Char('\n'))) {
+        return value;
+    }
+    QString quoted = value;
+    quoted.replace(QLatin1String("\""), QLatin1String("\"\""));
+    return QLatin1Char('"') + quoted + QLatin1Char('"');
+}
+
+bool writeFile(const QString& path, const QByteArray& data, QString& error)
+{
+    QSaveFile file{path};
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        error = "Cannot write " + path + ": " + file.errorString();
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+double JobStats::realtimeFactor() const
+{
+    if (wallMs <= 0 || inputDurationMs == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(inputDurationMs) / static_cast<double>(wallMs);
+}
+
+void ChildUsageMeter::start(qint64 pid)
+{
+    initChildTotals();
+    m_pid = pid;
+    m_peakRssKiB = -1;
+}
+
+void ChildUsageMeter::sample()
+{
+    if (m_pid <= 0) {
+        return;
+    }
+
+    QFile status{QString("/proc/%1/status").arg(m_pid)};
+    if (!status.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    // "VmHWM:     12345 kB", the high water mark only grows
+    const QList<QByteArray> lines = status.readAll().split('\n');
+    for (const QByteArray& line : lines) {
+        if (line.startsWith("VmHWM:")) {
+            bool ok{false};
+            const qint64 peak = line.mid(6).trimmed().split(' ').constFirst().toLongLong(&ok);
+            if (ok) {
+                m_peakRssKiB = qMax(m_peakRssKiB, peak);
+            }
+            return;
+        }
+    }
+}
+
+EncoderUsage ChildUsageMeter::finish()
+{
+    EncoderUsage result;
+    result.peakRssKiB = m_peakRssKiB;
+    if (m_pid <= 0) {
+        return result;
+    }
+    m_pid = 0;
+
+    rusage usage{};
+    getrusage(RUSAGE_CHILDREN, &usage);
+
+    ChildTotals& totals = childTotals();
+    const QMutexLocker locker{&totals.lock};
+    result.userCpuUs = microseconds(usage.ru_utime) - totals.userCpuUs;
+    result.systemCpuUs = microseconds(usage.ru_stime) - totals.systemCpuUs;
+    // The maximum over all children only grows if this one was the largest yet, then it is exact
+    if (usage.ru_maxrss > totals.maxRssKiB) {
+        result.peakRssKiB = qMax<qint64>(result.peakRssKiB, usage.ru_maxrss);
+    }
+    totals.userCpuUs = microseconds(usage.ru_utime);
+    totals.systemCpuUs = microseconds(usage.ru_stime);
+    totals.maxRssKiB = usage.ru_maxrss;
+    return result;
+}
+
+EncoderUsage threadUsage()
+{
+#ifdef RUSAGE_THREAD
+    rusage usage{};
+    getrusage(RUSAGE_THREAD, &usage);
+    return {microseconds(usage.ru_utime), microseconds(usage.ru_stime), -1};
+#else
+    return {-1, -1, -1};
+#endif
+}
+
+EncoderUsage threadUsageSince(const EncoderUsage& start)
+{
+    if (start.userCpuUs < 0) {
+        return start;
+    }
+    const EncoderUsage now = threadUsage();
+    return {now.userCpuUs - start.userCpuUs, now.systemCpuUs - start.systemCpuUs, -1};
+}
+
+bool writeJobStats(const QList<JobStats>& stats, const QString& jsonPath, const QString& csvPath, QString& error)
+{
+    QJsonArray jobs;
+    QByteArray csv{"job,input,outputs,formats,success,wall_ms,user_cpu_ms,system_cpu_ms,peak_rss_kib,"
+                   "bytes_read,bytes_written,input_duration_ms,realtime_factor\n"};
+
+    for (const JobStats& job : stats) {
+        const bool cpuKnown = job.userCpuUs >= 0;
+        const double userMs = static_cast<double>(job.userCpuUs) / 1000.0;
+        const double systemMs = static_cast<double>(job.systemCpuUs) / 1000.0;
+
+        QJsonObject object{{"job", job.jobId},
+                           {"input", job.inputPath},
+                           {"outputs", QJsonArray::fromStringList(job.outputPaths)},
+                           {"formats", QJsonArray::fromStringList(job.formats)},
+                           {"success", job.success},
+                           {"wallMs", job.wallMs},
+                           {"bytesRead", job.bytesRead},
+                           {"bytesWritten", job.bytesWritten},
+                           {"inputDurationMs", static_cast<qint64>(job.inputDurationMs)},
+                           {"realtimeFactor", job.realtimeFactor()}};
+        // Unknown is null rather than a bogus 0
+        object.insert("userCpuMs", cpuKnown ? QJsonValue{userMs} : QJsonValue{});
+        object.insert("systemCpuMs", cpuKnown ? QJsonValue{systemMs} : QJsonValue{});
+        object.insert("peakRssKiB", job.peakRssKiB >= 0 ? QJsonValue{job.peakRssKiB} : QJsonValue{});
+        jobs.append(object);
+
+        const QStringList fields{QString::number(job.jobId),
+                                 csvField(job.inputPath),
+                                 csvField(job.outputPaths.join(QLatin1Char(';'))),
+                                 csvField(job.formats.join(QLatin1Char(';'))),
+                                 job.success ? QStringLiteral("1") : QStringLiteral("0"),
+                                 QString::number(job.wallMs),
+                                 cpuKnown ? QString::number(userMs, 'f', 3) : QString{},
+                                 cpuKnown ? QString::number(systemMs, 'f', 3) : QString{},
+                                 job.peakRssKiB >= 0 ? QString::number(job.peakRssKiB) : QString{},
+                                 QString::number(job.bytesRead),
+                                 QString::number(job.bytesWritten),
+                                 QString::number(job.inputDurationMs),
+                                 QString::number(job.realtimeFactor(), 'f', 2)};
+        csv += fields.join(QLatin1Char(',')).toUtf8() + '\n';
+    }
+
+    return writeFile(jsonPath, QJsonDocument{jobs}.toJson(QJsonDocument::Indented), error)
+        && writeFile(csvPath, csv, error);
+}
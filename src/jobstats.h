@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <cstdint>
+
+// CPU and memory an encoder used for one output. CLI encoders are measured on their child
+// process, in-process encoders and copies on the worker thread that ran them.
+struct EncoderUsage {
+    qint64 userCpuUs{0};   // -1 = not known, e.g. no per-thread CPU time on this OS
+    qint64 systemCpuUs{0};
+    qint64 peakRssKiB{-1}; // -1 = not known; in-process encoders share fooyin's memory
+};
+
+// Resources of one finished job, exported per batch
+struct JobStats {
+    int jobId{-1};
+    QString inputPath;
+    QStringList outputPaths;
+    QStringList formats;
+    bool success{false};
+    qint64 wallMs{0}; // From start to the last output published
+    qint64 userCpuUs{0};   // -1 = not known for one of the job's encoders
+    qint64 systemCpuUs{0};
+    qint64 peakRssKiB{-1}; // Largest of the job's encoders
+    qint64 bytesRead{0};   // Input, once however many outputs it was encoded to
+    qint64 bytesWritten{0};
+    uint64_t inputDurationMs{0};
+
+    // Seconds of audio converted per second of wall time, 0 if unknown
+    double realtimeFactor() const;
+};
+
+// Measures a child process: CPU from its rusage when reaped, peak RSS from /proc while it runs.
+// QProcess reaps its children itself, so CPU is the growth of RUSAGE_CHILDREN since the previous
+// finish(); call it directly from QProcess::finished, before anything else can reap a child.
+class ChildUsageMeter
+{
+public:
+    // Call once the child is running
+    void start(qint64 pid);
+    // Reads VmHWM of the child, call now and then while it runs
+    void sample();
+    EncoderUsage finish();
+
+private:
+    qint64 m_pid{0};
+    qint64 m_peakRssKiB{-1};
+};
+
+// CPU used by the calling thread so far, for in-process encoders. Unknown (-1) where
+// getrusage() has no RUSAGE_THREAD (it is Linux only).
+EncoderUsage threadUsage();
+// Usage of the calling thread since start, a value from threadUsage()
+EncoderUsage threadUsageSince(const EncoderUsage& start);
+
+// Writes stats as a JSON array to jsonPath and as CSV with a header line to csvPath
+bool writeJobStats(const QList<JobStats>& stats, const QString& jsonPath, const QString& csvPath, QString& error);
@@ -1,7 +1,54 @@
 #include "lamewrapper.h"
+#include "encodertags.h"
+#include "pcmstream.h"
 #include <QDebug>
 #include <QRegularExpression>
 #include <QFile>
+#include <QHash>
+#include <QVersionNumber>
+
+namespace {
+// Library tags as --tv frames, mapped like the in-process encoder does
+QStringList id3TagArguments(const Fooyin::Track& track)
+{
+    static const QHash<QString, QString> frameIds = {
+        {"TITLE", "TIT2"},    {"ARTIST", "TPE1"}, {"ALBUM", "TALB"},    {"ALBUMARTIST", "TPE2"},
+        {"DISCNUMBER", "TPOS"}, {"GENRE", "TCON"}, {"DATE", "TYER"},     {"COMPOSER", "TCOM"},
+        {"PERFORMER", "TPE3"},
+    };
+
+    QStringList args;
+    QString trackNumber;
+    QString trackTotal;
+
+    for (const EncoderTag& tag : encoderTags(track)) {
+        if (tag.key == "TRACKNUMBER") {
+            trackNumber = tag.value;
+        }
+        else if (tag.key == "TRACKTOTAL") {
+            trackTotal = tag.value;
+        }
+        else if (tag.key == "DISCTOTAL") {
+            continue;
+        }
+        else if (tag.key == "COMMENT") {
+            args << "--tc" << tag.value;
+        }
+        else if (const QString frameId = frameIds.value(tag.key); !frameId.isEmpty()) {
+            args << "--tv" << frameId + "=" + tag.value;
+        }
+        else {
+            // Anything else goes into a user-defined text frame
+            args << "--tv" << "TXXX=" + tag.key + "=" + tag.value;
+        }
+    }
+
+    if (!trackNumber.isEmpty()) {
+        args << "--tn" << (trackTotal.isEmpty() ? trackNumber : trackNumber + "/" + trackTotal);
+    }
+    return args;
+}
+} // namespace
 
 LameWrapper::LameWrapper(QObject* parent)
     : CodecWrapper(parent)
@@ -10,6 +57,8 @@ LameWrapper::LameWrapper(QObject* parent)
 
     if (m_execPath.isEmpty()) {
         qWarning() << "LAME MP3 encoder not found in PATH";
+    } else {
+        m_capabilities = codecCapabilities(m_execPath, {"LAME.*version ([0-9.]+)", {}});
     }
 }
 
@@ -24,19 +73,14 @@ QString LameWrapper::version() const
         return "Not found";
     }
 
-    QProcess process;
-    process.start(m_execPath, {"--version"});
-    process.waitForFinished();
-
-    QString output = process.readAllStandardError(); // LAME outputs version to stderr
-    QRegularExpression versionRegex("LAME.*version ([0-9.]+)");
-    QRegularExpressionMatch match = versionRegex.match(output);
-
-    if (match.hasMatch()) {
-        return match.captured(1);
-    }
+    return m_capabilities.version;
+}
 
-    return "Unknown";
+bool LameWrapper::canConvertStream(const PcmFormat& format, const ConversionOptions& options) const
+{
+    Q_UNUSED(options);
+    // Raw input is limited to mono and stereo
+    return isAvailable() && format.channels <= 2;
 }
 
 QStringList LameWrapper::buildArguments(
@@ -84,6 +128,54 @@ QStringList LameWrapper::buildArguments(
     return args;
 }
 
+QStringList LameWrapper::buildStreamArguments(
+    const PcmFormat& format,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    QStringList args;
+
+    // Raw input layout, must match CodecWrapper's stdin feeder
+    args << "-r" << "--signed" << "--little-endian";
+    args << "-s" << QString::number(format.sampleRate / 1000.0);
+    args << "--bitwidth" << QString::number(streamBitsPerSample(format));
+
+    // Quality/Bitrate
+    if (options.quality >= 0) {
+        args << "-V" << QString::number(options.quality);
+    } else {
+        args << "-b" << QString::number(options.bitrate);
+    }
+
+    // No --resample, the decode pipeline already delivers the target rate
+
+    // For raw input -m also sets the input channel count, -a downmixes stereo input
+    if (format.channels == 1) {
+        args << "-m" << "m";
+    } else if (options.channels == 1) {
+        args << "-a" << "-m" << "m";
+    } else {
+        args << "-m" << "s";
+    }
+
+    args << "-q" << "0";
+    args << "--id3v2-only";
+    args << "--nohist";
+
+    // Raw input has no tags to carry over, they come from the library
+    args << id3TagArguments(m_sourceTrack);
+    // Earlier versions write Latin-1 only
+    if (QVersionNumber::fromString(m_capabilities.version) >= QVersionNumber{3, 99}) {
+        args << "--id3v2-utf16";
+    }
+
+    // Read from stdin
+    args << "-";
+    args << outputPath;
+
+    return args;
+}
+
 bool LameWrapper::convert(
     const QString& inputPath,
     const QString& outputPath,
@@ -128,13 +220,38 @@ void LameWrapper::convertAsync(
         return;
     }
 
+    startProcess(buildArguments(inputPath, outputPath, options), outputPath, nullptr);
+}
+
+void LameWrapper::convertStreamAsync(
+    std::shared_ptr<PcmStream> stream,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    if (m_process) {
+        qWarning() << "Conversion already in progress";
+        return;
+    }
+
+    const QStringList args = buildStreamArguments(stream->format(), outputPath, options);
+    startProcess(args, outputPath, std::move(stream));
+}
+
+void LameWrapper::startProcess(const QStringList& args, const QString& outputPath, std::shared_ptr<PcmStream> stream)
+{
     m_outputPath = outputPath;
     m_process = new QProcess(this);
+    measureProcess();
+
+    // Streams report progress from the frames fed instead
+    const bool streaming = stream != nullptr;
 
     // Connect progress monitoring (LAME outputs to stderr)
-    connect(m_process, &QProcess::readyReadStandardError, this, [this]() {
+    connect(m_process, &QProcess::readyReadStandardError, this, [this, streaming]() {
         QString output = m_process->readAllStandardError();
-        parseProgress(output);
+        if (!streaming) {
+            parseProgress(output);
+        }
     });
 
     // Connect completion
@@ -147,6 +264,14 @@ void LameWrapper::convertAsync(
             error = m_process->readAllStandardError();
         }
 
+        // A failed decode stops the encoder early, so report the decoder's error instead
+        detachStream();
+        if (const QString streamError = takeStreamError(); !streamError.isEmpty()) {
+            success = false;
+            error = streamError;
+            QFile::remove(m_outputPath);
+        }
+
         m_process->deleteLater();
         m_process = nullptr;
         m_outputPath.clear();
@@ -154,13 +279,36 @@ void LameWrapper::convertAsync(
         emit conversionFinished(success, error);
     });
 
+    // A process that fails to start never emits finished(), which would hold its job slot forever
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError processError) {
+        if (processError != QProcess::FailedToStart) {
+            return;
+        }
+
+        QString error = m_process->errorString();
+
+        detachStream();
+        m_process->deleteLater();
+        m_process = nullptr;
+        m_outputPath.clear();
+
+        emit conversionFinished(false, error);
+    });
+
+    if (stream) {
+        const int bitsPerSample = streamBitsPerSample(stream->format());
+        attachStream(std::move(stream), bitsPerSample);
+    }
+
     // Start conversion
-    QStringList args = buildArguments(inputPath, outputPath, options);
     m_process->start(m_execPath, args);
 }
 
 void LameWrapper::cancel()
 {
+    // Unblocks the decoder thread feeding a stream
+    detachStream();
+
     if (m_process && m_process->state() != QProcess::NotRunning) {
         // Disconnect signals to avoid spurious callbacks
         m_process->disconnect();
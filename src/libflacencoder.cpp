@@ -0,0 +1,153 @@
+#include "libflacencoder.h"
+#include "encodertags.h"
+#include "pcmsource.h"
+
+#include <FLAC/metadata.h>
+#include <FLAC/stream_encoder.h>
+
+#include <QFile>
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+namespace {
+struct EncoderContext {
+    std::function<void(uint64_t)> progress;
+};
+
+void progressCallback(const FLAC__StreamEncoder* /*encoder*/, FLAC__uint64 /*bytesWritten*/,
+                      FLAC__uint64 samplesWritten, unsigned /*framesWritten*/, unsigned /*totalFramesEstimate*/,
+                      void* clientData)
+{
+    static_cast<EncoderContext*>(clientData)->progress(samplesWritten);
+}
+
+FLAC__StreamMetadata* buildVorbisComment(const Fooyin::Track& track, const QString& inputPath)
+{
+    const QList<EncoderTag> tags = encoderTags(track);
+
+    // Without library metadata, carry over the tags of a FLAC input like the flac CLI does
+    if (tags.isEmpty()) {
+        FLAC__StreamMetadata* existing{nullptr};
+        if (FLAC__metadata_get_tags(QFile::encodeName(inputPath).constData(), &existing)) {
+            return existing;
+        }
+        return nullptr;
+    }
+
+    FLAC__StreamMetadata* comment = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+    if (!comment) {
+        return nullptr;
+    }
+
+    for (const EncoderTag& tag : tags) {
+        FLAC__StreamMetadata_VorbisComment_Entry entry;
+        const QByteArray key = tag.key.toUtf8();
+        const QByteArray value = tag.value.toUtf8();
+        if (FLAC__metadata_object_vorbiscomment_entry_from_name_value_pair(&entry, key.constData(),
+                                                                           value.constData())) {
+            FLAC__metadata_object_vorbiscomment_append_comment(comment, entry, false);
+        }
+    }
+
+    return comment;
+}
+} // namespace
+
+LibFlacEncoder::LibFlacEncoder(QObject* parent)
+    : InProcessEncoder(parent)
+{ }
+
+QString LibFlacEncoder::version() const
+{
+    return QString::fromLatin1(FLAC__VERSION_STRING);
+}
+
+bool LibFlacEncoder::encode(
+    PcmSource& source,
+    const QString& outputPath,
+    const ConversionOptions& options,
+    QString& error)
+{
+    const PcmFormat format = source.format();
+    const uint64_t totalFrames = source.totalFrames();
+
+    // FLAC stores integers; float sources are quantised to 24 bits
+    const int bitsPerSample = qBound(8, format.bitsPerSample, 24);
+
+    FLAC__StreamEncoder* encoder = FLAC__stream_encoder_new();
+    if (!encoder) {
+        error = "Failed to create FLAC encoder";
+        return false;
+    }
+
+    FLAC__stream_encoder_set_channels(encoder, static_cast<unsigned>(format.channels));
+    FLAC__stream_encoder_set_bits_per_sample(encoder, static_cast<unsigned>(bitsPerSample));
+    FLAC__stream_encoder_set_sample_rate(encoder, static_cast<unsigned>(format.sampleRate));
+    FLAC__stream_encoder_set_compression_level(encoder, static_cast<unsigned>(qBound(0, options.compressionLevel, 8)));
+    FLAC__stream_encoder_set_total_samples_estimate(encoder, totalFrames);
+
+    FLAC__StreamMetadata* comment = buildVorbisComment(m_sourceTrack, source.path());
+    FLAC__StreamMetadata* metadata[] = {comment};
+    if (comment) {
+        FLAC__stream_encoder_set_metadata(encoder, metadata, 1);
+    }
+
+    // Progress follows the encoder's own sample count
+    EncoderContext context{[this, totalFrames](uint64_t samplesWritten) {
+        reportProgress(samplesWritten, totalFrames);
+    }};
+
+    const QByteArray filename = QFile::encodeName(outputPath);
+    const auto status
+        = FLAC__stream_encoder_init_file(encoder, filename.constData(), &progressCallback, &context);
+
+    bool success = status == FLAC__STREAM_ENCODER_INIT_STATUS_OK;
+    if (!success) {
+        error = QString("Cannot initialise FLAC encoder: %1").arg(FLAC__StreamEncoderInitStatusString[status]);
+    }
+
+    const int channels = format.channels;
+    const float scale = static_cast<float>(1 << (bitsPerSample - 1));
+    const auto maxValue = static_cast<FLAC__int32>((1 << (bitsPerSample - 1)) - 1);
+    const auto minValue = static_cast<FLAC__int32>(-(1 << (bitsPerSample - 1)));
+
+    std::vector<float> block(static_cast<size_t>(BlockFrames * channels));
+    std::vector<FLAC__int32> samples(block.size());
+
+    while (success && !isCanceled()) {
+        const int64_t frames = source.read(block.data(), BlockFrames);
+        if (frames < 0) {
+            error = source.errorString();
+            success = false;
+            break;
+        }
+        if (frames == 0) {
+            break;
+        }
+
+        const int64_t count = frames * channels;
+        for (int64_t i = 0; i < count; ++i) {
+            const auto value = static_cast<FLAC__int32>(std::lrintf(block[i] * scale));
+            samples[i] = qBound(minValue, value, maxValue);
+        }
+
+        if (!FLAC__stream_encoder_process_interleaved(encoder, samples.data(), static_cast<unsigned>(frames))) {
+            error = QString("FLAC encoding error: %1").arg(FLAC__stream_encoder_get_resolved_state_string(encoder));
+            success = false;
+        }
+    }
+
+    if (status == FLAC__STREAM_ENCODER_INIT_STATUS_OK && !FLAC__stream_encoder_finish(encoder) && success) {
+        error = QString("FLAC encoding error: %1").arg(FLAC__stream_encoder_get_resolved_state_string(encoder));
+        success = false;
+    }
+
+    FLAC__stream_encoder_delete(encoder);
+    if (comment) {
+        FLAC__metadata_object_delete(comment);
+    }
+
+    return success;
+}
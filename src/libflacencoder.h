@@ -0,0 +1,23 @@
+#pragma once
+
+#include "inprocessencoder.h"
+
+// FLAC encoder built on libFLAC's stream encoder
+class LibFlacEncoder : public InProcessEncoder
+{
+    Q_OBJECT
+
+public:
+    explicit LibFlacEncoder(QObject* parent = nullptr);
+
+    QString version() const override;
+    QString executableName() const override { return "libFLAC"; }
+
+protected:
+    bool encode(
+        PcmSource& source,
+        const QString& outputPath,
+        const ConversionOptions& options,
+        QString& error
+    ) override;
+};
@@ -0,0 +1,221 @@
+#include "liblameencoder.h"
+#include "encodertags.h"
+#include "pcmsource.h"
+
+#include <lame/lame.h>
+
+#include <QFile>
+#include <QHash>
+
+#include <vector>
+
+namespace {
+// UTF-16 with BOM, as LAME's *_utf16 tag functions expect
+std::vector<unsigned short> toLameUtf16(const QString& text)
+{
+    std::vector<unsigned short> buffer;
+    buffer.reserve(static_cast<size_t>(text.size()) + 2);
+    buffer.push_back(0xFEFF);
+    for (const QChar c : text) {
+        buffer.push_back(c.unicode());
+    }
+    buffer.push_back(0);
+    return buffer;
+}
+
+void setTextFrame(lame_global_flags* lame, const char* frameId, const QString& text)
+{
+    const auto value = toLameUtf16(text);
+    id3tag_set_textinfo_utf16(lame, frameId, value.data());
+}
+
+void writeId3Tags(lame_global_flags* lame, const Fooyin::Track& track)
+{
+    static const QHash<QString, const char*> frameIds = {
+        {"TITLE", "TIT2"},    {"ARTIST", "TPE1"}, {"ALBUM", "TALB"},    {"ALBUMARTIST", "TPE2"},
+        {"DISCNUMBER", "TPOS"}, {"GENRE", "TCON"}, {"DATE", "TYER"},     {"COMPOSER", "TCOM"},
+        {"PERFORMER", "TPE3"},
+    };
+
+    const QList<EncoderTag> tags = encoderTags(track);
+
+    QString trackNumber;
+    QString trackTotal;
+
+    for (const EncoderTag& tag : tags) {
+        if (tag.key == "TRACKNUMBER") {
+            trackNumber = tag.value;
+        }
+        else if (tag.key == "TRACKTOTAL") {
+            trackTotal = tag.value;
+        }
+        else if (tag.key == "DISCTOTAL") {
+            continue;
+        }
+        else if (tag.key == "COMMENT") {
+            const auto description = toLameUtf16({});
+            const auto text = toLameUtf16(tag.value);
+            id3tag_set_comment_utf16(lame, "eng", description.data(), text.data());
+        }
+        else if (const char* frameId = frameIds.value(tag.key)) {
+            setTextFrame(lame, frameId, tag.value);
+        }
+        else {
+            // Anything else goes into a user-defined text frame
+            setTextFrame(lame, "TXXX", tag.key + "=" + tag.value);
+        }
+    }
+
+    if (!trackNumber.isEmpty()) {
+        setTextFrame(lame, "TRCK", trackTotal.isEmpty() ? trackNumber : trackNumber + "/" + trackTotal);
+    }
+}
+} // namespace
+
+LibLameEncoder::LibLameEncoder(QObject* parent)
+    : InProcessEncoder(parent)
+{ }
+
+QString LibLameEncoder::version() const
+{
+    return QString::fromLatin1(get_lame_version());
+}
+
+bool LibLameEncoder::canConvertStream(const PcmFormat& format, const ConversionOptions& options) const
+{
+    Q_UNUSED(options);
+    // libmp3lame only encodes mono and stereo
+    return format.channels <= 2;
+}
+
+bool LibLameEncoder::encode(
+    PcmSource& source,
+    const QString& outputPath,
+    const ConversionOptions& options,
+    QString& error)
+{
+    const PcmFormat format = source.format();
+    const uint64_t totalFrames = source.totalFrames();
+
+    if (format.channels > 2) {
+        error = "LAME only encodes mono and stereo audio";
+        return false;
+    }
+
+    lame_global_flags* lame = lame_init();
+    if (!lame) {
+        error = "Failed to create LAME encoder";
+        return false;
+    }
+
+    lame_set_num_channels(lame, format.channels);
+    lame_set_in_samplerate(lame, format.sampleRate);
+
+    // Same mapping as LameWrapper::buildArguments()
+    if (options.quality >= 0) {
+        lame_set_VBR(lame, vbr_default);
+        lame_set_VBR_quality(lame, static_cast<float>(options.quality));
+    } else {
+        lame_set_VBR(lame, vbr_off);
+        lame_set_brate(lame, options.bitrate);
+    }
+
+    if (options.sampleRate > 0) {
+        lame_set_out_samplerate(lame, options.sampleRate);
+    }
+
+    if (options.channels == 1) {
+        lame_set_mode(lame, MONO);
+    } else if (options.channels == 2) {
+        lame_set_mode(lame, STEREO);
+    }
+
+    lame_set_quality(lame, 0);
+
+    // ID3v2 only, written by hand ahead of the audio
+    id3tag_init(lame);
+    id3tag_v2_only(lame);
+    lame_set_write_id3tag_automatic(lame, 0);
+    writeId3Tags(lame, m_sourceTrack);
+
+    if (lame_init_params(lame) < 0) {
+        lame_close(lame);
+        error = "Invalid LAME encoder parameters";
+        return false;
+    }
+
+    QFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        lame_close(lame);
+        error = "Cannot open output file: " + file.errorString();
+        return false;
+    }
+
+    std::vector<unsigned char> mp3Buffer(static_cast<size_t>(BlockFrames * 5 / 4 + 7200));
+
+    const size_t id3Size = lame_get_id3v2_tag(lame, mp3Buffer.data(), mp3Buffer.size());
+    if (id3Size > mp3Buffer.size()) {
+        mp3Buffer.resize(id3Size);
+        lame_get_id3v2_tag(lame, mp3Buffer.data(), mp3Buffer.size());
+    }
+    file.write(reinterpret_cast<const char*>(mp3Buffer.data()), static_cast<qint64>(id3Size));
+
+    std::vector<float> block(static_cast<size_t>(BlockFrames * format.channels));
+    uint64_t framesDone{0};
+    bool success{true};
+
+    while (!isCanceled()) {
+        const int64_t frames = source.read(block.data(), BlockFrames);
+        if (frames < 0) {
+            error = source.errorString();
+            success = false;
+            break;
+        }
+        if (frames == 0) {
+            break;
+        }
+
+        int bytes{0};
+        if (format.channels == 1) {
+            bytes = lame_encode_buffer_ieee_float(lame, block.data(), block.data(), static_cast<int>(frames),
+                                                  mp3Buffer.data(), static_cast<int>(mp3Buffer.size()));
+        } else {
+            bytes = lame_encode_buffer_interleaved_ieee_float(lame, block.data(), static_cast<int>(frames),
+                                                              mp3Buffer.data(), static_cast<int>(mp3Buffer.size()));
+        }
+
+        if (bytes < 0) {
+            error = QString("LAME encoding error (%1)").arg(bytes);
+            success = false;
+            break;
+        }
+
+        file.write(reinterpret_cast<const char*>(mp3Buffer.data()), bytes);
+
+        framesDone += static_cast<uint64_t>(frames);
+        reportProgress(framesDone, totalFrames);
+    }
+
+    if (success && !isCanceled()) {
+        const int bytes = lame_encode_flush(lame, mp3Buffer.data(), static_cast<int>(mp3Buffer.size()));
+        if (bytes > 0) {
+            file.write(reinterpret_cast<const char*>(mp3Buffer.data()), bytes);
+        }
+
+        // The LAME/Xing frame replaces the placeholder frame right after the ID3v2 tag
+        const size_t tagSize = lame_get_lametag_frame(lame, mp3Buffer.data(), mp3Buffer.size());
+        if (tagSize > 0 && tagSize <= mp3Buffer.size() && file.seek(static_cast<qint64>(id3Size))) {
+            file.write(reinterpret_cast<const char*>(mp3Buffer.data()), static_cast<qint64>(tagSize));
+        }
+    }
+
+    if (success && file.error() != QFileDevice::NoError) {
+        error = "Write error: " + file.errorString();
+        success = false;
+    }
+
+    file.close();
+    lame_close(lame);
+
+    return success;
+}
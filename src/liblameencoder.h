@@ -0,0 +1,24 @@
+#pragma once
+
+#include "inprocessencoder.h"
+
+// MP3 encoder built on libmp3lame, writes the ID3v2 tag and LAME/Xing header itself
+class LibLameEncoder : public InProcessEncoder
+{
+    Q_OBJECT
+
+public:
+    explicit LibLameEncoder(QObject* parent = nullptr);
+
+    QString version() const override;
+    QString executableName() const override { return "libmp3lame"; }
+    bool canConvertStream(const PcmFormat& format, const ConversionOptions& options) const override;
+
+protected:
+    bool encode(
+        PcmSource& source,
+        const QString& outputPath,
+        const ConversionOptions& options,
+        QString& error
+    ) override;
+};
@@ -0,0 +1,107 @@
+#include "libopusencoder.h"
+#include "encodertags.h"
+#include "opuswrapper.h"
+#include "pcmsource.h"
+
+#include <opusenc.h>
+
+#include <QFile>
+
+#include <vector>
+
+LibOpusEncoder::LibOpusEncoder(QObject* parent)
+    : InProcessEncoder(parent)
+{ }
+
+QString LibOpusEncoder::version() const
+{
+    return QString::fromLatin1(ope_get_version_string());
+}
+
+bool LibOpusEncoder::encode(
+    PcmSource& source,
+    const QString& outputPath,
+    const ConversionOptions& options,
+    QString& error)
+{
+    const PcmFormat format = source.format();
+    const uint64_t totalFrames = source.totalFrames();
+
+    const bool downmix = options.channels == 1 && format.channels > 1;
+    const int channels = downmix ? 1 : format.channels;
+    const std::vector<int> channelOrder = vorbisChannelOrder(channels);
+
+    OggOpusComments* comments = ope_comments_create();
+    if (!comments) {
+        error = "Failed to create Opus comments";
+        return false;
+    }
+
+    for (const EncoderTag& tag : encoderTags(m_sourceTrack)) {
+        ope_comments_add(comments, tag.key.toUtf8().constData(), tag.value.toUtf8().constData());
+    }
+
+    // Mapping family 1 handles the Vorbis channel layouts beyond stereo
+    int result{OPE_OK};
+    OggOpusEnc* encoder = ope_encoder_create_file(QFile::encodeName(outputPath).constData(), comments,
+                                                  format.sampleRate, channels, channels > 2 ? 1 : 0, &result);
+    ope_comments_destroy(comments);
+
+    if (!encoder) {
+        error = QString("Cannot create Opus encoder: %1").arg(QString::fromLatin1(ope_strerror(result)));
+        return false;
+    }
+
+    // Same settings as OpusWrapper::buildArguments()
+    ope_encoder_ctl(encoder, OPUS_SET_BITRATE(options.bitrate * 1000));
+    ope_encoder_ctl(encoder, OPUS_SET_VBR(1));
+    ope_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(10));
+
+    if (const int bandwidth = OpusWrapper::maxBandwidthForRate(options.sampleRate)) {
+        ope_encoder_ctl(encoder, OPUS_SET_MAX_BANDWIDTH(bandwidth));
+    }
+
+    std::vector<float> block(static_cast<size_t>(BlockFrames * format.channels));
+    uint64_t framesDone{0};
+    bool success{true};
+
+    while (!isCanceled()) {
+        const int64_t frames = source.read(block.data(), BlockFrames);
+        if (frames < 0) {
+            error = source.errorString();
+            success = false;
+            break;
+        }
+        if (frames == 0) {
+            break;
+        }
+
+        if (downmix) {
+            downmixToMono(block.data(), block.data(), frames, format.channels);
+        } else if (!channelOrder.empty()) {
+            reorderChannels(block.data(), frames, channelOrder);
+        }
+
+        result = ope_encoder_write_float(encoder, block.data(), static_cast<int>(frames));
+        if (result != OPE_OK) {
+            error = QString("Opus encoding error: %1").arg(QString::fromLatin1(ope_strerror(result)));
+            success = false;
+            break;
+        }
+
+        framesDone += static_cast<uint64_t>(frames);
+        reportProgress(framesDone, totalFrames);
+    }
+
+    if (success && !isCanceled()) {
+        result = ope_encoder_drain(encoder);
+        if (result != OPE_OK) {
+            error = QString("Opus encoding error: %1").arg(QString::fromLatin1(ope_strerror(result)));
+            success = false;
+        }
+    }
+
+    ope_encoder_destroy(encoder);
+
+    return success;
+}
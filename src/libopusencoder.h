@@ -0,0 +1,23 @@
+#pragma once
+
+#include "inprocessencoder.h"
+
+// Opus encoder built on libopusenc
+class LibOpusEncoder : public InProcessEncoder
+{
+    Q_OBJECT
+
+public:
+    explicit LibOpusEncoder(QObject* parent = nullptr);
+
+    QString version() const override;
+    QString executableName() const override { return "libopusenc"; }
+
+protected:
+    bool encode(
+        PcmSource& source,
+        const QString& outputPath,
+        const ConversionOptions& options,
+        QString& error
+    ) override;
+};
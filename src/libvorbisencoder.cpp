@@ -0,0 +1,173 @@
+#include "libvorbisencoder.h"
+#include "encodertags.h"
+#include "pcmsource.h"
+
+#include <vorbis/vorbisenc.h>
+
+#include <QFile>
+#include <QRandomGenerator>
+
+#include <vector>
+
+namespace {
+bool writePages(ogg_stream_state& stream, QFile& file, bool flush)
+{
+    ogg_page page;
+    while (flush ? ogg_stream_flush(&stream, &page) : ogg_stream_pageout(&stream, &page)) {
+        if (file.write(reinterpret_cast<const char*>(page.header), page.header_len) != page.header_len
+            || file.write(reinterpret_cast<const char*>(page.body), page.body_len) != page.body_len) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+LibVorbisEncoder::LibVorbisEncoder(QObject* parent)
+    : InProcessEncoder(parent)
+{ }
+
+QString LibVorbisEncoder::version() const
+{
+    return QString::fromLatin1(vorbis_version_string());
+}
+
+bool LibVorbisEncoder::canConvert(const QString& inputPath, const ConversionOptions& options) const
+{
+    // libvorbisenc does not resample, leave that to oggenc
+    return options.sampleRate <= 0 && InProcessEncoder::canConvert(inputPath, options);
+}
+
+bool LibVorbisEncoder::canConvertStream(const PcmFormat& format, const ConversionOptions& options) const
+{
+    // Streams arrive already resampled by the decode pipeline
+    return options.sampleRate <= 0 || options.sampleRate == format.sampleRate;
+}
+
+bool LibVorbisEncoder::encode(
+    PcmSource& source,
+    const QString& outputPath,
+    const ConversionOptions& options,
+    QString& error)
+{
+    const PcmFormat format = source.format();
+    const uint64_t totalFrames = source.totalFrames();
+
+    const bool downmix = options.channels == 1 && format.channels > 1;
+    const int channels = downmix ? 1 : format.channels;
+    const std::vector<int> channelOrder = vorbisChannelOrder(channels);
+
+    vorbis_info info;
+    vorbis_info_init(&info);
+
+    // Same mapping as OggWrapper::buildArguments(): VBR quality or average bitrate
+    const int initResult = options.quality >= 0
+                             ? vorbis_encode_init_vbr(&info, channels, format.sampleRate, options.quality / 10.0F)
+                             : vorbis_encode_init(&info, channels, format.sampleRate, -1, options.bitrate * 1000, -1);
+    if (initResult != 0) {
+        vorbis_info_clear(&info);
+        error = "Unsupported Vorbis encoder settings";
+        return false;
+    }
+
+    QFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        vorbis_info_clear(&info);
+        error = "Cannot open output file: " + file.errorString();
+        return false;
+    }
+
+    vorbis_comment comment;
+    vorbis_comment_init(&comment);
+    for (const EncoderTag& tag : encoderTags(m_sourceTrack)) {
+        vorbis_comment_add_tag(&comment, tag.key.toUtf8().constData(), tag.value.toUtf8().constData());
+    }
+
+    vorbis_dsp_state dsp;
+    vorbis_block block;
+    vorbis_analysis_init(&dsp, &info);
+    vorbis_block_init(&dsp, &block);
+
+    ogg_stream_state stream;
+    ogg_stream_init(&stream, static_cast<int>(QRandomGenerator::global()->generate()));
+
+    // Identification, comment and setup headers each start on their own page
+    ogg_packet header;
+    ogg_packet headerComment;
+    ogg_packet headerCode;
+    vorbis_analysis_headerout(&dsp, &comment, &header, &headerComment, &headerCode);
+    ogg_stream_packetin(&stream, &header);
+    ogg_stream_packetin(&stream, &headerComment);
+    ogg_stream_packetin(&stream, &headerCode);
+
+    bool success = writePages(stream, file, true);
+    if (!success) {
+        error = "Write error: " + file.errorString();
+    }
+
+    std::vector<float> interleaved(static_cast<size_t>(BlockFrames * format.channels));
+    uint64_t framesDone{0};
+    bool endOfStream{false};
+
+    while (success && !endOfStream && !isCanceled()) {
+        const int64_t frames = source.read(interleaved.data(), BlockFrames);
+        if (frames < 0) {
+            error = source.errorString();
+            success = false;
+            break;
+        }
+
+        if (frames == 0) {
+            // Tells the encoder to finish the stream
+            vorbis_analysis_wrote(&dsp, 0);
+            endOfStream = true;
+        } else {
+            if (downmix) {
+                downmixToMono(interleaved.data(), interleaved.data(), frames, format.channels);
+            } else if (!channelOrder.empty()) {
+                reorderChannels(interleaved.data(), frames, channelOrder);
+            }
+
+            // libvorbis takes planar buffers
+            float** planes = vorbis_analysis_buffer(&dsp, static_cast<int>(frames));
+            for (int64_t i = 0; i < frames; ++i) {
+                for (int ch = 0; ch < channels; ++ch) {
+                    planes[ch][i] = interleaved[i * channels + ch];
+                }
+            }
+            vorbis_analysis_wrote(&dsp, static_cast<int>(frames));
+        }
+
+        while (success && vorbis_analysis_blockout(&dsp, &block) == 1) {
+            vorbis_analysis(&block, nullptr);
+            vorbis_bitrate_addblock(&block);
+
+            ogg_packet packet;
+            while (vorbis_bitrate_flushpacket(&dsp, &packet)) {
+                ogg_stream_packetin(&stream, &packet);
+                if (!writePages(stream, file, false)) {
+                    error = "Write error: " + file.errorString();
+                    success = false;
+                    break;
+                }
+            }
+        }
+
+        framesDone += static_cast<uint64_t>(frames);
+        reportProgress(framesDone, totalFrames);
+    }
+
+    if (success && endOfStream && !writePages(stream, file, true)) {
+        error = "Write error: " + file.errorString();
+        success = false;
+    }
+
+    ogg_stream_clear(&stream);
+    vorbis_block_clear(&block);
+    vorbis_dsp_clear(&dsp);
+    vorbis_comment_clear(&comment);
+    vorbis_info_clear(&info);
+    file.close();
+
+    return success;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "inprocessencoder.h"
+
+// Ogg Vorbis encoder built on libvorbisenc and libogg
+class LibVorbisEncoder : public InProcessEncoder
+{
+    Q_OBJECT
+
+public:
+    explicit LibVorbisEncoder(QObject* parent = nullptr);
+
+    QString version() const override;
+    QString executableName() const override { return "libvorbisenc"; }
+
+    bool canConvert(const QString& inputPath, const ConversionOptions& options) const override;
+    bool canConvertStream(const PcmFormat& format, const ConversionOptions& options) const override;
+
+protected:
+    bool encode(
+        PcmSource& source,
+        const QString& outputPath,
+        const ConversionOptions& options,
+        QString& error
+    ) override;
+};
@@ -0,0 +1,153 @@
+#include "localstaging.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <sys/vfs.h>
+#endif
+
+namespace {
+// Large enough that network file systems send full-size requests
+constexpr size_t CopyChunkBytes = 8 * 1024 * 1024;
+
+QString errnoString()
+{
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+bool writeAll(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+} // namespace
+
+bool isNetworkPath(const QString& path)
+{
+#ifdef Q_OS_LINUX
+    // Outputs may go to folders that don't exist yet
+    QFileInfo info{path};
+    while (!info.exists() && !info.isRoot()) {
+        info.setFile(info.absolutePath());
+    }
+
+    struct statfs fs{};
+    if (::statfs(QFile::encodeName(info.absoluteFilePath()).constData(), &fs) != 0) {
+        return false;
+    }
+
+    switch (static_cast<uint32_t>(fs.f_type)) {
+        case 0x6969:     // NFS
+        case 0x517B:     // SMB
+        case 0xFF534D42: // CIFS
+        case 0xFE534D42: // SMB2
+        case 0x65735546: // FUSE (sshfs, rclone...)
+        case 0x01021997: // 9P
+        case 0x00C36400: // Ceph
+        case 0x5346414F: // AFS
+            return true;
+        default:
+            return false;
+    }
+#else
+    Q_UNUSED(path)
+    return false;
+#endif
+}
+
+QString defaultStagingDirectory()
+{
+    const QFileInfo shm{QStringLiteral("/dev/shm")};
+    if (shm.isDir() && shm.isWritable()) {
+        return shm.absoluteFilePath();
+    }
+    return QDir::tempPath();
+}
+
+bool copyOutFile(const QString& source, const QString& destination, const std::atomic<bool>& cancelled,
+                 QString& error)
+{
+    const int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        error = "Cannot read staged output: " + errnoString();
+        return false;
+    }
+
+    const int out = ::open(QFile::encodeName(destination).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (out < 0) {
+        error = "Cannot write output: " + errnoString();
+        ::close(in);
+        return false;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    const auto buffer = std::make_unique<char[]>(CopyChunkBytes);
+    bool success{true};
+
+    while (true) {
+        if (cancelled.load(std::memory_order_relaxed)) {
+            error = "Canceled";
+            success = false;
+            break;
+        }
+
+        const ssize_t got = ::read(in, buffer.get(), CopyChunkBytes);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            error = "Cannot read staged output: " + errnoString();
+            success = false;
+            break;
+        }
+        if (got == 0) {
+            break;
+        }
+        if (!writeAll(out, buffer.get(), static_cast<size_t>(got))) {
+            error = "Cannot write output: " + errnoString();
+            success = false;
+            break;
+        }
+    }
+
+    // Network file systems may only report write errors on close
+    if (::close(out) != 0 && success) {
+        error = "Cannot write output: " + errnoString();
+        success = false;
+    }
+    ::close(in);
+
+    return success;
+}
+
+QThreadPool* copyOutThreadPool()
+{
+    static QThreadPool* pool = [] {
+        auto* copyPool = new QThreadPool();
+        copyPool->setMaxThreadCount(1);
+        return copyPool;
+    }();
+    return pool;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+
+class QThreadPool;
+
+// Where encoders write when the destination is slow
+enum class StagingMode : int
+{
+    Off = 0,
+    NetworkDestinations = 1, // Only outputs on NFS, SMB and other network/FUSE file systems
+    Always = 2,
+};
+
+// True if path (or its closest existing parent) is on a network or FUSE file system
+bool isNetworkPath(const QString& path);
+
+// tmpfs (/dev/shm) where available, the system temp directory otherwise
+QString defaultStagingDirectory();
+
+// Copies source to destination (truncated first) in large sequential chunks.
+// Gives up between chunks once cancelled is set.
+bool copyOutFile(const QString& source, const QString& destination, const std::atomic<bool>& cancelled,
+                 QString& error);
+
+// A single thread, so a slow destination gets one sequential stream at a time
+QThreadPool* copyOutThreadPool();
@@ -0,0 +1,195 @@
+#include "loudnessmeter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr int MaxChannels = 8;
+constexpr double Pi = 3.14159265358979323846;
+constexpr double AbsoluteGate = -70.0; // LUFS
+constexpr double RelativeGate = -10.0; // LU below the absolutely gated loudness
+constexpr double ReferenceLoudness = -18.0;
+
+double toLoudness(double power)
+{
+    return -0.691 + 10.0 * std::log10(power);
+}
+
+// BS.1770 stage 1 (high shelf, head effects) and stage 2 (RLB high-pass), redesigned for the rate
+void designKWeighting(Dsp::BiquadCascade& filter, int sampleRate)
+{
+    const double rate = sampleRate;
+
+    {
+        const double f0 = 1681.974450955533;
+        const double gain = 3.999843853973347;
+        const double q = 0.7071752369554196;
+
+        const double k = std::tan(Pi * f0 / rate);
+        const double vh = std::pow(10.0, gain / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+
+        float* c = filter.coeffs[0];
+        c[0] = static_cast<float>((vh + vb * k / q + k * k) / a0);
+        c[1] = static_cast<float>(2.0 * (k * k - vh) / a0);
+        c[2] = static_cast<float>((vh - vb * k / q + k * k) / a0);
+        c[3] = static_cast<float>(2.0 * (k * k - 1.0) / a0);
+        c[4] = static_cast<float>((1.0 - k / q + k * k) / a0);
+    }
+
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+
+        const double k = std::tan(Pi * f0 / rate);
+        const double a0 = 1.0 + k / q + k * k;
+
+        float* c = filter.coeffs[1];
+        c[0] = 1.0F;
+        c[1] = -2.0F;
+        c[2] = 1.0F;
+        c[3] = static_cast<float>(2.0 * (k * k - 1.0) / a0);
+        c[4] = static_cast<float>((1.0 - k / q + k * k) / a0);
+    }
+}
+
+// BS.1770 channel weights: surrounds count 1.41x, the LFE of 5.1/6.1/7.1 not at all
+float channelWeight(int channels, int channel)
+{
+    switch (channels) {
+        case 4: // FL FR BL BR
+            return channel >= 2 ? 1.41F : 1.0F;
+        case 5: // FL FR FC BL BR
+            return channel >= 3 ? 1.41F : 1.0F;
+        case 6:
+        case 7:
+        case 8:
+            if (channel == 3) {
+                return 0.0F;
+            }
+            return channel >= 4 ? 1.41F : 1.0F;
+        default:
+            return 1.0F;
+    }
+}
+
+double gatedLoudness(const std::vector<const std::vector<double>*>& blockLists)
+{
+    const double absoluteThreshold = std::pow(10.0, (AbsoluteGate + 0.691) / 10.0);
+
+    double sum{0.0};
+    size_t count{0};
+    for (const auto* blocks : blockLists) {
+        for (const double block : *blocks) {
+            if (block > absoluteThreshold) {
+                sum += block;
+                ++count;
+            }
+        }
+    }
+    if (count == 0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    const double relativeThreshold = sum / static_cast<double>(count) * std::pow(10.0, RelativeGate / 10.0);
+
+    sum   = 0.0;
+    count = 0;
+    for (const auto* blocks : blockLists) {
+        for (const double block : *blocks) {
+            if (block > absoluteThreshold && block > relativeThreshold) {
+                sum += block;
+                ++count;
+            }
+        }
+    }
+
+    return toLoudness(sum / static_cast<double>(count));
+}
+} // namespace
+
+LoudnessMeter::LoudnessMeter(const PcmFormat& format)
+    : m_channels{format.channels <= MaxChannels ? format.channels : 0}
+    , m_segmentFrames{std::max<int64_t>(1, std::llround(format.sampleRate / 10.0))}
+{
+    designKWeighting(m_filter, format.sampleRate);
+
+    m_weights.resize(m_channels);
+    for (int c = 0; c < m_channels; ++c) {
+        m_weights[c] = channelWeight(format.channels, c);
+    }
+}
+
+void LoudnessMeter::process(const float* samples, int64_t frames)
+{
+    // The filter kernel handles up to 8 channels, wider layouts are not measured
+    if (m_channels == 0) {
+        return;
+    }
+
+    while (frames > 0) {
+        const int64_t chunk = std::min(frames, m_segmentFrames - m_framesInSegment);
+        Dsp::filterPower(samples, chunk, m_channels, m_filter, m_power, m_peaks);
+
+        samples += chunk * m_channels;
+        frames -= chunk;
+        m_framesInSegment += chunk;
+
+        if (m_framesInSegment == m_segmentFrames) {
+            finishSegment();
+        }
+    }
+}
+
+void LoudnessMeter::finishSegment()
+{
+    double power{0.0};
+    for (int c = 0; c < m_channels; ++c) {
+        power += m_weights[c] * m_power[c];
+        m_power[c] = 0.0;
+    }
+
+    std::rotate(m_segments, m_segments + 1, m_segments + 4);
+    m_segments[3] = power / static_cast<double>(m_segmentFrames);
+    m_framesInSegment = 0;
+
+    // Every 100 ms completes a 400 ms block once the first four segments are in
+    if (++m_segmentCount >= 4) {
+        m_blocks.push_back((m_segments[0] + m_segments[1] + m_segments[2] + m_segments[3]) / 4.0);
+    }
+}
+
+float LoudnessMeter::peak() const
+{
+    return *std::max_element(std::begin(m_peaks), std::end(m_peaks));
+}
+
+double LoudnessMeter::integratedLoudness() const
+{
+    return gatedLoudness({&m_blocks});
+}
+
+double LoudnessMeter::integratedLoudness(const std::vector<std::shared_ptr<LoudnessMeter>>& meters)
+{
+    std::vector<const std::vector<double>*> blockLists;
+    for (const auto& meter : meters) {
+        blockLists.push_back(&meter->m_blocks);
+    }
+    return gatedLoudness(blockLists);
+}
+
+float LoudnessMeter::peak(const std::vector<std::shared_ptr<LoudnessMeter>>& meters)
+{
+    float albumPeak{0.0F};
+    for (const auto& meter : meters) {
+        albumPeak = std::max(albumPeak, meter->peak());
+    }
+    return albumPeak;
+}
+
+float LoudnessMeter::replayGain(double loudness)
+{
+    return static_cast<float>(ReferenceLoudness - loudness);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "dspkernels.h"
+#include "pcmsource.h"
+
+#include <memory>
+#include <vector>
+
+// Integrated loudness (ITU-R BS.1770 / EBU R128) and sample peak of a stream, for
+// ReplayGain 2.0 tags. Fed on the decoder thread; read once the stream has finished.
+class LoudnessMeter
+{
+public:
+    explicit LoudnessMeter(const PcmFormat& format);
+
+    void process(const float* samples, int64_t frames);
+
+    // Gated loudness in LUFS, -inf when nothing passes the gates (silence, < 400 ms)
+    double integratedLoudness() const;
+    float peak() const;
+
+    // Loudness and peak of several streams measured as one, e.g. the tracks of an album
+    static double integratedLoudness(const std::vector<std::shared_ptr<LoudnessMeter>>& meters);
+    static float peak(const std::vector<std::shared_ptr<LoudnessMeter>>& meters);
+
+    // ReplayGain 2.0 gain in dB for a loudness, relative to the -18 LUFS reference
+    static float replayGain(double loudness);
+
+private:
+    void finishSegment();
+
+    int m_channels; // 0 when the layout is too wide to measure
+    int64_t m_segmentFrames; // 100 ms, a quarter of a gating block
+    int64_t m_framesInSegment{0};
+    std::vector<float> m_weights;
+    Dsp::BiquadCascade m_filter;
+    double m_power[8]{};
+    float m_peaks[8]{};
+    double m_segments[4]{};
+    int m_segmentCount{0};
+    std::vector<double> m_blocks; // Weighted mean square of every 400 ms block, 75% overlap
+};
@@ -0,0 +1,15 @@
+#include "loudnessstage.h"
+#include "loudnessmeter.h"
+
+LoudnessStage::LoudnessStage(const PcmFormat& inputFormat, std::shared_ptr<LoudnessMeter> meter)
+    : m_format{inputFormat}
+    , m_meter{std::move(meter)}
+{ }
+
+const float* LoudnessStage::process(const float* input, int64_t frames, int64_t& outputFrames)
+{
+    m_meter->process(input, frames);
+
+    outputFrames = frames;
+    return input;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "pcmstage.h"
+
+#include <memory>
+
+class LoudnessMeter;
+
+// Feeds the samples on their way to the encoder through a loudness meter, unchanged.
+// Sits last in a pipeline so it measures exactly what gets encoded.
+class LoudnessStage : public PcmStage
+{
+public:
+    LoudnessStage(const PcmFormat& inputFormat, std::shared_ptr<LoudnessMeter> meter);
+
+    PcmFormat outputFormat() const override { return m_format; }
+    const float* process(const float* input, int64_t frames, int64_t& outputFrames) override;
+
+private:
+    PcmFormat m_format;
+    std::shared_ptr<LoudnessMeter> m_meter;
+};
@@ -0,0 +1,308 @@
+#include "mirrormanifest.h"
+#include "contenthash.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr char Magic[8] = {'F', 'Y', 'M', 'I', 'R', 'R', 'O', 'R'};
+constexpr uint32_t FormatVersion = 1;
+
+// Host byte order; a manifest belongs to the machine that wrote it
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t hashKind; // audioFingerprintKind() of the content hashes
+    uint64_t count;
+    uint64_t stringsOffset;
+};
+static_assert(sizeof(Header) == 32);
+
+uint64_t keyHash(const QString& key)
+{
+    const QByteArray utf8 = key.toUtf8();
+    return hashBytes(utf8.constData(), static_cast<size_t>(utf8.size()));
+}
+} // namespace
+
+struct MirrorManifest::Record {
+    uint64_t keyHash;
+    uint64_t size;
+    int64_t modified;
+    uint64_t contentHash;
+    uint64_t optionsHash;
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t outputOffset;
+    uint32_t outputLength;
+};
+static_assert(sizeof(MirrorManifest::Record) == 56);
+
+MirrorManifest::MirrorManifest(QString path)
+    : m_path{std::move(path)}
+{ }
+
+MirrorManifest::~MirrorManifest()
+{
+    unmap();
+}
+
+void MirrorManifest::unmap()
+{
+    if (m_map) {
+        m_file.unmap(const_cast<uchar*>(m_map));
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_mapSize = 0;
+    m_count = 0;
+    m_stringsOffset = 0;
+    m_hashKind = 0;
+}
+
+bool MirrorManifest::load(QString& error)
+{
+    unmap();
+
+    m_file.setFileName(m_path);
+    if (!m_file.exists()) {
+        return true;
+    }
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        error = "Cannot open mirror manifest: " + m_file.errorString();
+        return false;
+    }
+
+    m_mapSize = m_file.size();
+    if (m_mapSize < static_cast<qint64>(sizeof(Header))) {
+        error = "Mirror manifest is truncated";
+        m_file.close();
+        return false;
+    }
+
+    m_map = m_file.map(0, m_mapSize);
+    if (!m_map) {
+        error = "Cannot map mirror manifest: " + m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(&header, m_map, sizeof(header));
+
+    const uint64_t recordsEnd = sizeof(Header) + header.count * sizeof(Record);
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != FormatVersion
+        || recordsEnd > header.stringsOffset || header.stringsOffset > static_cast<uint64_t>(m_mapSize)) {
+        error = "Mirror manifest is damaged or from another version";
+        unmap();
+        return false;
+    }
+
+    m_count = header.count;
+    m_stringsOffset = header.stringsOffset;
+    m_hashKind = header.hashKind;
+    return true;
+}
+
+MirrorManifest::Record MirrorManifest::recordAt(qsizetype index) const
+{
+    Record record{};
+    std::memcpy(&record, m_map + sizeof(Header) + static_cast<size_t>(index) * sizeof(Record), sizeof(Record));
+    return record;
+}
+
+QString MirrorManifest::stringAt(uint32_t offset, uint32_t length) const
+{
+    // Bounds are checked here rather than trusted from the file
+    if (m_stringsOffset + offset + length > static_cast<uint64_t>(m_mapSize)) {
+        return {};
+    }
+    return QString::fromUtf8(reinterpret_cast<const char*>(m_map + m_stringsOffset + offset),
+                             static_cast<qsizetype>(length));
+}
+
+MirrorManifest::Entry MirrorManifest::entryAt(qsizetype index) const
+{
+    const Record record = recordAt(index);
+    // Hashes from a build with another hash function, or from before fingerprints, count as not computed
+    const uint64_t contentHash = m_hashKind == audioFingerprintKind() ? record.contentHash : 0;
+    return {stringAt(record.keyOffset, record.keyLength), stringAt(record.outputOffset, record.outputLength),
+            record.size, record.modified, contentHash, record.optionsHash};
+}
+
+std::optional<MirrorManifest::Entry> MirrorManifest::find(const QString& sourceKey) const
+{
+    if (const auto change = m_changes.constFind(sourceKey); change != m_changes.cend()) {
+        return change.value();
+    }
+
+    const uint64_t hash = keyHash(sourceKey);
+
+    // Records are sorted by key hash; equal hashes are told apart by the key itself
+    qsizetype low{0};
+    qsizetype high{recordCount()};
+    while (low < high) {
+        const qsizetype mid = low + (high - low) / 2;
+        if (recordAt(mid).keyHash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (qsizetype index = low; index < recordCount(); ++index) {
+        const Record record = recordAt(index);
+        if (record.keyHash != hash) {
+            break;
+        }
+        if (stringAt(record.keyOffset, record.keyLength) == sourceKey) {
+            return entryAt(index);
+        }
+    }
+
+    return {};
+}
+
+void MirrorManifest::insert(const Entry& entry)
+{
+    m_changes.insert(entry.sourceKey, entry);
+}
+
+QString MirrorManifest::relativePath(const QString& outputPath) const
+{
+    return QFileInfo(m_path).absoluteDir().relativeFilePath(outputPath);
+}
+
+bool MirrorManifest::save(QString& error)
+{
+    if (m_changes.isEmpty()) {
+        return true;
+    }
+
+    struct Pending {
+        uint64_t hash;
+        Entry entry;
+    };
+
+    // Unchanged records plus everything changed, sorted the way find() searches them
+    std::vector<Pending> entries;
+    entries.reserve(static_cast<size_t>(recordCount() + m_changes.size()));
+    for (qsizetype index = 0; index < recordCount(); ++index) {
+        Entry entry = entryAt(index);
+        if (!m_changes.contains(entry.sourceKey)) {
+            entries.push_back({recordAt(index).keyHash, std::move(entry)});
+        }
+    }
+    for (const Entry& entry : std::as_const(m_changes)) {
+        entries.push_back({keyHash(entry.sourceKey), entry});
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Pending& a, const Pending& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.entry.sourceKey < b.entry.sourceKey;
+    });
+
+    std::vector<Record> records;
+    records.reserve(entries.size());
+    QByteArray strings;
+
+    const auto addString = [&strings](const QString& string, uint32_t& offset, uint32_t& length) {
+        const QByteArray utf8 = string.toUtf8();
+        offset = static_cast<uint32_t>(strings.size());
+        length = static_cast<uint32_t>(utf8.size());
+        strings.append(utf8);
+    };
+
+    for (const Pending& pending : entries) {
+        Record record{};
+        record.keyHash = pending.hash;
+        record.size = pending.entry.size;
+        record.modified = pending.entry.modified;
+        record.contentHash = pending.entry.contentHash;
+        record.optionsHash = pending.entry.optionsHash;
+        addString(pending.entry.sourceKey, record.keyOffset, record.keyLength);
+        addString(pending.entry.outputPath, record.outputOffset, record.outputLength);
+        records.push_back(record);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.hashKind = audioFingerprintKind();
+    header.count = records.size();
+    header.stringsOffset = sizeof(Header) + records.size() * sizeof(Record);
+
+    QSaveFile file{m_path};
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = "Cannot write mirror manifest: " + file.errorString();
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(records.data()), static_cast<qint64>(records.size() * sizeof(Record)));
+    file.write(strings);
+    if (!file.commit()) {
+        error = "Cannot write mirror manifest: " + file.errorString();
+        return false;
+    }
+
+    m_changes.clear();
+    return load(error);
+}
+
+uint64_t MirrorManifest::optionsHash(const ConversionOptions& options, const QString& encoderVersion)
+{
+    // Everything that changes the encoded audio
+    QByteArray key;
+    QDataStream stream{&key, QIODevice::WriteOnly};
+    stream << options.format << options.bitrate << options.quality << options.sampleRate << options.channels
+           << options.compressionLevel << options.bitDepth << options.replayGain << encoderVersion;
+    return hashBytes(key.constData(), static_cast<size_t>(key.size()));
+}
+
+MirrorPlan planMirror(const MirrorManifest& manifest, const QList<MirrorSource>& sources, uint64_t optionsHash,
+                      bool fingerprint)
+{
+    MirrorPlan plan;
+
+    for (qsizetype index = 0; index < sources.size(); ++index) {
+        const MirrorSource& source = sources.at(index);
+
+        MirrorManifest::Entry entry{source.key, manifest.relativePath(source.outputPath), source.size,
+                                    source.modified, 0, optionsHash};
+        if (entry.size == 0 || entry.modified == 0) {
+            const QFileInfo info{source.path};
+            entry.size = static_cast<uint64_t>(info.size());
+            entry.modified = info.lastModified().toMSecsSinceEpoch();
+        }
+
+        const std::optional<MirrorManifest::Entry> known = manifest.find(source.key);
+
+        const bool outputValid = known && known->optionsHash == optionsHash && known->outputPath == entry.outputPath
+                              && QFileInfo::exists(source.outputPath);
+        if (outputValid && known->size == entry.size && known->modified == entry.modified) {
+            continue;
+        }
+
+        if (fingerprint) {
+            entry.contentHash = audioFingerprint(source.path);
+        }
+
+        // Same audio with a new size or timestamp: tags edited, or the file touched or copied
+        if (outputValid && entry.contentHash != 0 && entry.contentHash == known->contentHash) {
+            plan.retag.append(index);
+            plan.retagged.append(entry);
+            continue;
+        }
+
+        plan.stale.append(index);
+        plan.pending.append(entry);
+    }
+
+    return plan;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "codecwrapper.h"
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <optional>
+
+// Persistent record of what a mirror folder was built from, so later runs only
+// convert new or changed sources. Stored next to the outputs as a sorted array of
+// fixed-size records (by hash of the source key) plus a string table; the file is
+// memory-mapped and searched in place, so opening and querying a manifest of
+// 500k entries costs a few page faults. Changes are kept in memory until save().
+class MirrorManifest
+{
+public:
+    struct Entry {
+        QString sourceKey;  // Source path, with "#<offset>" appended for CUE tracks
+        QString outputPath; // Relative to the manifest's folder
+        uint64_t size{0};
+        int64_t modified{0};     // Milliseconds since the epoch
+        uint64_t contentHash{0}; // audioFingerprint() of the source, 0 = not computed
+        uint64_t optionsHash{0}; // Conversion options and encoder version
+    };
+
+    explicit MirrorManifest(QString path);
+    ~MirrorManifest();
+
+    MirrorManifest(const MirrorManifest&) = delete;
+    MirrorManifest& operator=(const MirrorManifest&) = delete;
+
+    // Maps the manifest file; a missing file is an empty manifest
+    bool load(QString& error);
+    // Writes all entries to a new file that atomically replaces the old one
+    bool save(QString& error);
+
+    std::optional<Entry> find(const QString& sourceKey) const;
+    void insert(const Entry& entry);
+
+    QString path() const { return m_path; }
+    // Output path as stored in entries
+    QString relativePath(const QString& outputPath) const;
+
+    static uint64_t optionsHash(const ConversionOptions& options, const QString& encoderVersion);
+
+private:
+    struct Record;
+
+    qsizetype recordCount() const { return static_cast<qsizetype>(m_count); }
+    Record recordAt(qsizetype index) const;
+    QString stringAt(uint32_t offset, uint32_t length) const;
+    Entry entryAt(qsizetype index) const;
+    void unmap();
+
+    QString m_path;
+    QFile m_file;
+    const uchar* m_map{nullptr};
+    qint64 m_mapSize{0};
+    uint64_t m_count{0};
+    uint64_t m_stringsOffset{0};
+    uint32_t m_hashKind{0};
+    QHash<QString, Entry> m_changes; // Not saved yet, take precedence over the file
+};
+
+// A source of a mirror run, checked against the manifest
+struct MirrorSource {
+    QString key;
+    QString path;
+    QString outputPath; // Absolute
+    uint64_t size{0};   // 0 = unknown, read from the file
+    int64_t modified{0};
+};
+
+struct MirrorPlan {
+    QList<qsizetype> stale;                // Indexes of the sources to convert
+    QList<MirrorManifest::Entry> pending;  // Their entries, to insert once converted
+    QList<qsizetype> retag;                // Indexes of the sources whose audio is unchanged
+    QList<MirrorManifest::Entry> retagged; // Their entries, to insert once the output is retagged
+};
+
+// Finds the sources that are new, changed, converted with other options or whose
+// output is gone. With fingerprint, sources that are converted or whose size or
+// timestamp changed get an audio fingerprint; changed sources with the same audio
+// as before only need their output retagged. Safe to run on a worker thread as long
+// as the manifest isn't modified meanwhile.
+MirrorPlan planMirror(const MirrorManifest& manifest, const QList<MirrorSource>& sources, uint64_t optionsHash,
+                      bool fingerprint);
@@ -1,4 +1,6 @@
 #include "oggwrapper.h"
+#include "encodertags.h"
+#include "pcmstream.h"
 #include <QDebug>
 #include <QRegularExpression>
 #include <QFile>
@@ -10,6 +12,8 @@ OggWrapper::OggWrapper(QObject* parent)
 
     if (m_execPath.isEmpty()) {
         qWarning() << "Ogg Vorbis encoder not found in PATH";
+    } else {
+        m_capabilities = codecCapabilities(m_execPath, {"oggenc.*vorbis-tools ([0-9.]+)", {}});
     }
 }
 
@@ -24,19 +28,7 @@ QString OggWrapper::version() const
         return "Not found";
     }
 
-    QProcess process;
-    process.start(m_execPath, {"--version"});
-    process.waitForFinished();
-
-    QString output = process.readAllStandardOutput();
-    QRegularExpression versionRegex("oggenc.*vorbis-tools ([0-9.]+)");
-    QRegularExpressionMatch match = versionRegex.match(output);
-
-    if (match.hasMatch()) {
-        return match.captured(1);
-    }
-
-    return "Unknown";
+    return m_capabilities.version;
 }
 
 QStringList OggWrapper::buildArguments(
@@ -77,6 +69,43 @@ QStringList OggWrapper::buildArguments(
     return args;
 }
 
+QStringList OggWrapper::buildStreamArguments(
+    const PcmFormat& format,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    QStringList args;
+
+    // Raw input layout, must match CodecWrapper's stdin feeder
+    args << "-r" << "--raw-endianness" << "0";
+    args << "-B" << "16";
+    args << "-C" << QString::number(format.channels);
+    args << "-R" << QString::number(format.sampleRate);
+
+    if (options.quality >= 0) {
+        args << "-q" << QString::number(options.quality);
+    } else {
+        args << "-b" << QString::number(options.bitrate);
+    }
+
+    // No --resample, the decode pipeline already delivers the target rate
+
+    if (options.channels == 1 && format.channels > 1) {
+        args << "--downmix";
+    }
+
+    // Raw input has no tags to carry over, they come from the library
+    args << encoderTagArguments("-c", m_sourceTrack);
+
+    // Output file
+    args << "-o" << outputPath;
+
+    // Read from stdin
+    args << "-";
+
+    return args;
+}
+
 bool OggWrapper::convert(
     const QString& inputPath,
     const QString& outputPath,
@@ -121,18 +150,45 @@ void OggWrapper::convertAsync(
         return;
     }
 
+    startProcess(buildArguments(inputPath, outputPath, options), outputPath, nullptr);
+}
+
+void OggWrapper::convertStreamAsync(
+    std::shared_ptr<PcmStream> stream,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    if (m_process) {
+        qWarning() << "Conversion already in progress";
+        return;
+    }
+
+    const QStringList args = buildStreamArguments(stream->format(), outputPath, options);
+    startProcess(args, outputPath, std::move(stream));
+}
+
+void OggWrapper::startProcess(const QStringList& args, const QString& outputPath, std::shared_ptr<PcmStream> stream)
+{
     m_outputPath = outputPath;
     m_process = new QProcess(this);
+    measureProcess();
+
+    // Streams report progress from the frames fed instead
+    const bool streaming = stream != nullptr;
 
     // Connect progress monitoring
-    connect(m_process, &QProcess::readyReadStandardError, this, [this]() {
+    connect(m_process, &QProcess::readyReadStandardError, this, [this, streaming]() {
         QString output = m_process->readAllStandardError();
-        parseProgress(output);
+        if (!streaming) {
+            parseProgress(output);
+        }
     });
 
-    connect(m_process, &QProcess::readyReadStandardOutput, this, [this]() {
+    connect(m_process, &QProcess::readyReadStandardOutput, this, [this, streaming]() {
         QString output = m_process->readAllStandardOutput();
-        parseProgress(output);
+        if (!streaming) {
+            parseProgress(output);
+        }
     });
 
     // Connect completion
@@ -145,6 +201,14 @@ void OggWrapper::convertAsync(
             error = m_process->readAllStandardError();
         }
 
+        // A failed decode stops the encoder early, so report the decoder's error instead
+        detachStream();
+        if (const QString streamError = takeStreamError(); !streamError.isEmpty()) {
+            success = false;
+            error = streamError;
+            QFile::remove(m_outputPath);
+        }
+
         m_process->deleteLater();
         m_process = nullptr;
         m_outputPath.clear();
@@ -152,13 +216,37 @@ void OggWrapper::convertAsync(
         emit conversionFinished(success, error);
     });
 
+    // A process that fails to start never emits finished(), which would hold its job slot forever
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError processError) {
+        if (processError != QProcess::FailedToStart) {
+            return;
+        }
+
+        QString error = m_process->errorString();
+
+        detachStream();
+        m_process->deleteLater();
+        m_process = nullptr;
+        m_outputPath.clear();
+
+        emit conversionFinished(false, error);
+    });
+
+    if (stream) {
+        // oggenc only reads 8 and 16 bit raw input, in the Vorbis channel order
+        const int channels = stream->format().channels;
+        attachStream(std::move(stream), 16, vorbisChannelOrder(channels));
+    }
+
     // Start conversion
-    QStringList args = buildArguments(inputPath, outputPath, options);
     m_process->start(m_execPath, args);
 }
 
 void OggWrapper::cancel()
 {
+    // Unblocks the decoder thread feeding a stream
+    detachStream();
+
     if (m_process && m_process->state() != QProcess::NotRunning) {
         // Disconnect signals to avoid spurious callbacks
         m_process->disconnect();
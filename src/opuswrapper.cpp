@@ -1,4 +1,6 @@
 #include "opuswrapper.h"
+#include "encodertags.h"
+#include "pcmstream.h"
 #include <QDebug>
 #include <QRegularExpression>
 #include <QFile>
@@ -10,6 +12,8 @@ OpusWrapper::OpusWrapper(QObject* parent)
 
     if (m_execPath.isEmpty()) {
         qWarning() << "Opus encoder not found in PATH";
+    } else {
+        m_capabilities = codecCapabilities(m_execPath, {"opusenc.*opus-tools ([0-9.]+)", {"--set-ctl-int"}});
     }
 }
 
@@ -24,19 +28,7 @@ QString OpusWrapper::version() const
         return "Not found";
     }
 
-    QProcess process;
-    process.start(m_execPath, {"--version"});
-    process.waitForFinished();
-
-    QString output = process.readAllStandardError();
-    QRegularExpression versionRegex("opusenc.*opus-tools ([0-9.]+)");
-    QRegularExpressionMatch match = versionRegex.match(output);
-
-    if (match.hasMatch()) {
-        return match.captured(1);
-    }
-
-    return "Unknown";
+    return m_capabilities.version;
 }
 
 QStringList OpusWrapper::buildArguments(
@@ -56,7 +48,11 @@ QStringList OpusWrapper::buildArguments(
     args << "--comp" << "10";
 
     // Sample rate (Opus internally uses 48kHz but can accept different inputs)
-    // opusenc handles resampling automatically
+    // opusenc handles resampling automatically, a lower target rate caps the bandwidth
+    // (older opus-tools without --set-ctl-int simply encode the full band)
+    if (const int bandwidth = m_capabilities.supports("--set-ctl-int") ? maxBandwidthForRate(options.sampleRate) : 0) {
+        args << "--set-ctl-int" << QString("4004=%1").arg(bandwidth); // OPUS_SET_MAX_BANDWIDTH
+    }
 
     // Downmix to mono if requested
     if (options.channels == 1) {
@@ -73,6 +69,61 @@ QStringList OpusWrapper::buildArguments(
     return args;
 }
 
+QStringList OpusWrapper::buildStreamArguments(
+    const PcmFormat& format,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    QStringList args;
+
+    // Raw input layout, must match CodecWrapper's stdin feeder
+    args << "--raw" << "--raw-endianness" << "0";
+    args << "--raw-bits" << QString::number(streamBitsPerSample(format));
+    args << "--raw-rate" << QString::number(format.sampleRate);
+    args << "--raw-chan" << QString::number(format.channels);
+
+    args << "--bitrate" << QString::number(options.bitrate);
+    args << "--vbr";
+    args << "--comp" << "10";
+
+    if (const int bandwidth = m_capabilities.supports("--set-ctl-int") ? maxBandwidthForRate(options.sampleRate) : 0) {
+        args << "--set-ctl-int" << QString("4004=%1").arg(bandwidth); // OPUS_SET_MAX_BANDWIDTH
+    }
+
+    if (options.channels == 1 && format.channels > 1) {
+        args << "--downmix-mono";
+    }
+
+    // Raw input has no tags to carry over, they come from the library
+    args << encoderTagArguments("--comment", m_sourceTrack);
+
+    // Read from stdin
+    args << "-";
+    args << outputPath;
+
+    return args;
+}
+
+int OpusWrapper::maxBandwidthForRate(int sampleRate)
+{
+    // Full band already covers everything above 24 kHz
+    if (sampleRate <= 0 || sampleRate > 24000) {
+        return 0;
+    }
+
+    // Nyquist of the target rate decides the widest band worth coding
+    if (sampleRate <= 8000) {
+        return 1101; // OPUS_BANDWIDTH_NARROWBAND (4 kHz)
+    }
+    if (sampleRate <= 12000) {
+        return 1102; // OPUS_BANDWIDTH_MEDIUMBAND (6 kHz)
+    }
+    if (sampleRate <= 16000) {
+        return 1103; // OPUS_BANDWIDTH_WIDEBAND (8 kHz)
+    }
+    return 1104; // OPUS_BANDWIDTH_SUPERWIDEBAND (12 kHz)
+}
+
 bool OpusWrapper::convert(
     const QString& inputPath,
     const QString& outputPath,
@@ -117,13 +168,38 @@ void OpusWrapper::convertAsync(
         return;
     }
 
+    startProcess(buildArguments(inputPath, outputPath, options), outputPath, nullptr);
+}
+
+void OpusWrapper::convertStreamAsync(
+    std::shared_ptr<PcmStream> stream,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    if (m_process) {
+        qWarning() << "Conversion already in progress";
+        return;
+    }
+
+    const QStringList args = buildStreamArguments(stream->format(), outputPath, options);
+    startProcess(args, outputPath, std::move(stream));
+}
+
+void OpusWrapper::startProcess(const QStringList& args, const QString& outputPath, std::shared_ptr<PcmStream> stream)
+{
     m_outputPath = outputPath;
     m_process = new QProcess(this);
+    measureProcess();
+
+    // Streams report progress from the frames fed instead
+    const bool streaming = stream != nullptr;
 
     // Connect progress monitoring
-    connect(m_process, &QProcess::readyReadStandardError, this, [this]() {
+    connect(m_process, &QProcess::readyReadStandardError, this, [this, streaming]() {
         QString output = m_process->readAllStandardError();
-        parseProgress(output);
+        if (!streaming) {
+            parseProgress(output);
+        }
     });
 
     // Connect completion
@@ -136,6 +212,14 @@ void OpusWrapper::convertAsync(
             error = m_process->readAllStandardError();
         }
 
+        // A failed decode stops the encoder early, so report the decoder's error instead
+        detachStream();
+        if (const QString streamError = takeStreamError(); !streamError.isEmpty()) {
+            success = false;
+            error = streamError;
+            QFile::remove(m_outputPath);
+        }
+
         m_process->deleteLater();
         m_process = nullptr;
         m_outputPath.clear();
@@ -143,13 +227,37 @@ void OpusWrapper::convertAsync(
         emit conversionFinished(success, error);
     });
 
+    // A process that fails to start never emits finished(), which would hold its job slot forever
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError processError) {
+        if (processError != QProcess::FailedToStart) {
+            return;
+        }
+
+        QString error = m_process->errorString();
+
+        detachStream();
+        m_process->deleteLater();
+        m_process = nullptr;
+        m_outputPath.clear();
+
+        emit conversionFinished(false, error);
+    });
+
+    if (stream) {
+        // Raw input is taken in the Vorbis channel order (mapping family 1)
+        const PcmFormat format = stream->format();
+        attachStream(std::move(stream), streamBitsPerSample(format), vorbisChannelOrder(format.channels));
+    }
+
     // Start conversion
-    QStringList args = buildArguments(inputPath, outputPath, options);
     m_process->start(m_execPath, args);
 }
 
 void OpusWrapper::cancel()
 {
+    // Unblocks the decoder thread feeding a stream
+    detachStream();
+
     if (m_process && m_process->state() != QProcess::NotRunning) {
         // Disconnect signals to avoid spurious callbacks
         m_process->disconnect();
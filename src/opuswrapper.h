@@ -1,5 +1,6 @@
 #pragma once
 
+#include "codeccapabilities.h"
 #include "codecwrapper.h"
 
 class OpusWrapper : public CodecWrapper
@@ -25,8 +26,18 @@ public:
         const ConversionOptions& options
     ) override;
 
+    void convertStreamAsync(
+        std::shared_ptr<PcmStream> stream,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) override;
+
     void cancel() override;
 
+    // Opus always decodes at 48 kHz, so a target sample rate limits the coded bandwidth instead.
+    // Returns an OPUS_BANDWIDTH_* value, or 0 to leave the bandwidth unrestricted.
+    static int maxBandwidthForRate(int sampleRate);
+
 private:
     QStringList buildArguments(
         const QString& inputPath,
@@ -34,7 +45,16 @@ private:
         const ConversionOptions& options
     );
 
+    // Raw PCM on stdin instead of an input file
+    QStringList buildStreamArguments(
+        const PcmFormat& format,
+        const QString& outputPath,
+        const ConversionOptions& options
+    );
+
+    void startProcess(const QStringList& args, const QString& outputPath, std::shared_ptr<PcmStream> stream);
     void parseProgress(const QString& output);
 
     QString m_execPath;
+    CodecCapabilities m_capabilities;
 };
@@ -0,0 +1,148 @@
+#include "passthroughcopier.h"
+#include "filecopy.h"
+#include "inprocessencoder.h"
+
+#include <core/track.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent>
+
+#include <cmath>
+
+namespace {
+bool bitrateMatches(int actual, int target, double tolerance)
+{
+    return actual > 0 && target > 0 && std::abs(actual - target) <= target * tolerance;
+}
+} // namespace
+
+PassthroughCopier::PassthroughCopier(QObject* parent)
+    : CodecWrapper(parent)
+{ }
+
+PassthroughCopier::~PassthroughCopier()
+{
+    m_canceled = true;
+    m_future.waitForFinished();
+}
+
+bool PassthroughCopier::canConvertStream(const PcmFormat& format, const ConversionOptions& options) const
+{
+    Q_UNUSED(format);
+    Q_UNUSED(options);
+    return false;
+}
+
+bool PassthroughCopier::matches(const Fooyin::Track& source, const ConversionOptions& options)
+{
+    // CUE tracks are slices of a larger file, archive members aren't files of their own
+    if (!options.passthrough || source.hasCue() || source.offset() > 0 || !QFileInfo(source.filepath()).isFile()) {
+        return false;
+    }
+    // Files picked from disk rather than the library carry no properties to compare
+    if (source.sampleRate() <= 0) {
+        return false;
+    }
+
+    const QString suffix = QFileInfo(source.filepath()).suffix().toLower();
+    const QString codec = source.codec().toLower();
+
+    // Parameters the target would change
+    if ((options.sampleRate > 0 && options.sampleRate != source.sampleRate())
+        || (options.channels > 0 && options.channels != source.channels())) {
+        return false;
+    }
+
+    if (options.format == "flac") {
+        // Lossless: the compression level doesn't change the audio
+        return suffix == "flac" && (options.bitDepth == 0 || options.bitDepth == source.bitDepth());
+    }
+    if (options.format == "mp3") {
+        // The VBR quality of a file is unknown, only constant bitrates can be matched
+        return suffix == "mp3" && options.quality < 0 && bitrateMatches(source.bitrate(), options.bitrate, 0.02);
+    }
+    if (options.format == "opus") {
+        return suffix == "opus" && bitrateMatches(source.bitrate(), options.bitrate, 0.1);
+    }
+    if (options.format == "ogg") {
+        // .ogg may also hold FLAC or Opus
+        const int quality = options.quality;
+        return suffix == "ogg" && codec.contains("vorbis") && quality >= 0 && quality <= 10
+            && bitrateMatches(source.bitrate(), nominalBitrate(options), 0.1);
+    }
+
+    return false;
+}
+
+bool PassthroughCopier::convert(
+    const QString& inputPath,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    Q_UNUSED(options);
+
+    QString error;
+    if (!cloneFile(inputPath, outputPath, m_canceled, error)) {
+        qWarning() << "Passthrough copy failed:" << error;
+        QFile::remove(outputPath);
+        return false;
+    }
+    return true;
+}
+
+void PassthroughCopier::convertAsync(
+    const QString& inputPath,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    Q_UNUSED(options);
+
+    if (m_future.isRunning()) {
+        qWarning() << "Conversion already in progress";
+        return;
+    }
+
+    m_canceled = false;
+    m_outputPath = outputPath;
+
+    // Takes an encoder slot like any other job, so it runs on the encoder pool
+    m_future = QtConcurrent::run(InProcessEncoder::encoderThreadPool(), [this, inputPath, outputPath]() {
+        QString error;
+        const EncoderUsage start = threadUsage();
+        const bool success = cloneFile(inputPath, outputPath, m_canceled, error);
+        m_usage = threadUsageSince(start);
+
+        // A canceled copy reports nothing, same as the encoders
+        if (!m_canceled) {
+            if (success) {
+                emit progressChanged(100);
+            }
+            emit conversionFinished(success, error);
+        }
+    });
+}
+
+void PassthroughCopier::convertStreamAsync(
+    std::shared_ptr<PcmStream> stream,
+    const QString& outputPath,
+    const ConversionOptions& options)
+{
+    Q_UNUSED(stream);
+    Q_UNUSED(outputPath);
+    Q_UNUSED(options);
+
+    emit conversionFinished(false, "Decoded input cannot be copied");
+}
+
+void PassthroughCopier::cancel()
+{
+    m_canceled = true;
+    m_future.waitForFinished();
+
+    if (!m_outputPath.isEmpty()) {
+        QFile::remove(m_outputPath);
+        m_outputPath.clear();
+    }
+}
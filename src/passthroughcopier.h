@@ -0,0 +1,54 @@
+#pragma once
+
+#include "codecwrapper.h"
+
+#include <QFuture>
+
+#include <atomic>
+
+// Stands in for the encoder when the source already is what the target asks for
+// (e.g. an MP3 320 converted to MP3 320): the file is copied, reflinked where
+// possible, instead of being re-encoded, which saves the CPU time and a lossy
+// generation. ConversionManager rewrites the tags from the library afterwards.
+class PassthroughCopier : public CodecWrapper
+{
+    Q_OBJECT
+
+public:
+    explicit PassthroughCopier(QObject* parent = nullptr);
+    ~PassthroughCopier() override;
+
+    bool isAvailable() const override { return true; }
+    QString version() const override { return {}; }
+    QString executableName() const override { return QStringLiteral("copy"); }
+
+    bool canConvertStream(const PcmFormat& format, const ConversionOptions& options) const override;
+
+    bool convert(
+        const QString& inputPath,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) override;
+
+    void convertAsync(
+        const QString& inputPath,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) override;
+
+    // Decoded input can't be copied; fails right away
+    void convertStreamAsync(
+        std::shared_ptr<PcmStream> stream,
+        const QString& outputPath,
+        const ConversionOptions& options
+    ) override;
+
+    void cancel() override;
+
+    // Preflight: whether source matches options closely enough to be copied as is
+    static bool matches(const Fooyin::Track& source, const ConversionOptions& options);
+
+private:
+    QFuture<void> m_future;
+    std::atomic<bool> m_canceled{false};
+};
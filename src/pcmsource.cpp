@@ -0,0 +1,108 @@
+#include "pcmsource.h"
+#include "wavsource.h"
+#ifdef HAVE_LIBFLAC
+#include "flacsource.h"
+#endif
+
+#include <QFileInfo>
+
+#include <algorithm>
+#include <array>
+
+bool PcmSource::canOpen(const QString& path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+
+    if (suffix == "wav") {
+        return true;
+    }
+#ifdef HAVE_LIBFLAC
+    if (suffix == "flac") {
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+std::unique_ptr<PcmSource> PcmSource::create(const QString& path, QString* error)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    std::unique_ptr<PcmSource> source;
+
+    if (suffix == "wav") {
+        source = std::make_unique<WavSource>();
+    }
+#ifdef HAVE_LIBFLAC
+    else if (suffix == "flac") {
+        source = std::make_unique<FlacSource>();
+    }
+#endif
+
+    if (!source) {
+        if (error) {
+            *error = "Unsupported input format: " + suffix;
+        }
+        return nullptr;
+    }
+
+    source->m_path = path;
+    if (!source->open(path)) {
+        if (error) {
+            *error = source->errorString();
+        }
+        return nullptr;
+    }
+
+    return source;
+}
+
+void downmixToMono(const float* in, float* out, int64_t frames, int channels)
+{
+    const float scale = 1.0F / static_cast<float>(channels);
+
+    for (int64_t i = 0; i < frames; ++i) {
+        float sum{0.0F};
+        for (int ch = 0; ch < channels; ++ch) {
+            sum += in[i * channels + ch];
+        }
+        out[i] = sum * scale;
+    }
+}
+
+std::vector<int> vorbisChannelOrder(int channels)
+{
+    switch (channels) {
+        case 3:
+            return {0, 2, 1};
+        case 5:
+            return {0, 2, 1, 3, 4};
+        case 6:
+            return {0, 2, 1, 4, 5, 3};
+        case 7:
+            // FL FR FC LFE BC SL SR
+            return {0, 2, 1, 5, 6, 4, 3};
+        case 8:
+            return {0, 2, 1, 6, 7, 4, 5, 3};
+        default:
+            return {};
+    }
+}
+
+void reorderChannels(float* samples, int64_t frames, const std::vector<int>& order)
+{
+    // Orders come from vorbisChannelOrder(), so a frame fits on the stack
+    std::array<float, 8> frame{};
+    const auto channels = order.size();
+    if (channels == 0 || channels > frame.size()) {
+        return;
+    }
+
+    for (int64_t i = 0; i < frames; ++i) {
+        float* frameSamples = samples + i * static_cast<int64_t>(channels);
+        std::copy_n(frameSamples, channels, frame.begin());
+        for (size_t ch = 0; ch < channels; ++ch) {
+            frameSamples[ch] = frame[static_cast<size_t>(order[ch])];
+        }
+    }
+}
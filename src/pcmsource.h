@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QString>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct PcmFormat {
+    int sampleRate{0};
+    int channels{0};
+    int bitsPerSample{0}; // Precision of the original samples
+
+    bool isValid() const { return sampleRate > 0 && channels > 0 && bitsPerSample > 0; }
+};
+
+// Pull-based source of decoded audio shared by the in-process encoders.
+// Samples are delivered interleaved as float in [-1, 1).
+class PcmSource
+{
+public:
+    virtual ~PcmSource() = default;
+
+    virtual bool open(const QString& path) = 0;
+    virtual PcmFormat format() const = 0;
+    virtual uint64_t totalFrames() const = 0; // 0 = unknown
+
+    // Reads up to maxFrames frames into buffer (maxFrames * channels floats).
+    // Returns the number of frames read, 0 at the end of the stream and -1 on error.
+    virtual int64_t read(float* buffer, int64_t maxFrames) = 0;
+
+    QString path() const { return m_path; }
+    QString errorString() const { return m_error; }
+
+    // Opens the best built-in reader for path, or returns nullptr with error set
+    static bool canOpen(const QString& path);
+    static std::unique_ptr<PcmSource> create(const QString& path, QString* error = nullptr);
+
+protected:
+    QString m_path;
+    QString m_error;
+};
+
+// Averages all channels of frames interleaved frames into out (may alias in)
+void downmixToMono(const float* in, float* out, int64_t frames, int channels);
+
+// Decoders deliver the WAVE channel order (FL FR FC LFE BL BR SL SR); Vorbis and Opus
+// (mapping family 1) expect FL FC FR, surrounds, then LFE. For each channel of the Vorbis
+// order its index in the WAVE order, empty where both agree (mono, stereo, quad, >8 channels).
+std::vector<int> vorbisChannelOrder(int channels);
+// Reorders frames interleaved frames in place, channel i taking input channel order[i]
+void reorderChannels(float* samples, int64_t frames, const std::vector<int>& order);
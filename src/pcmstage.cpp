@@ -0,0 +1,79 @@
+#include "pcmstage.h"
+#include "channelmixstage.h"
+#include "quantizestage.h"
+#include "resamplestage.h"
+
+PcmPipeline::PcmPipeline(const PcmFormat& inputFormat)
+    : m_inputFormat{inputFormat}
+{ }
+
+std::unique_ptr<PcmPipeline> PcmPipeline::create(const PcmFormat& inputFormat, const ConversionOptions& options)
+{
+    auto pipeline = std::make_unique<PcmPipeline>(inputFormat);
+
+    // Mix first so the resampler runs on as few channels as possible
+    if (options.channels > 0 && options.channels != inputFormat.channels) {
+        pipeline->append(std::make_unique<ChannelMixStage>(pipeline->outputFormat(), options.channels));
+    }
+
+    const int outputRate = targetSampleRate(inputFormat.sampleRate, options);
+    if (outputRate != inputFormat.sampleRate) {
+        pipeline->append(std::make_unique<ResampleStage>(pipeline->outputFormat(), outputRate));
+    }
+
+    // Lossless targets store integers: dither when reducing the bit depth, and
+    // when earlier stages moved the samples off the source's integer grid
+    const bool lossless = options.format.compare(QLatin1String("flac"), Qt::CaseInsensitive) == 0;
+    const int bitDepth = options.bitDepth > 0 ? qMin(options.bitDepth, inputFormat.bitsPerSample)
+                                              : inputFormat.bitsPerSample;
+    if (bitDepth < inputFormat.bitsPerSample || (lossless && !pipeline->isEmpty())) {
+        pipeline->append(std::make_unique<QuantizeStage>(pipeline->outputFormat(), bitDepth));
+    }
+
+    return pipeline;
+}
+
+void PcmPipeline::append(std::unique_ptr<PcmStage> stage)
+{
+    m_stages.push_back(std::move(stage));
+}
+
+PcmFormat PcmPipeline::outputFormat() const
+{
+    return m_stages.empty() ? m_inputFormat : m_stages.back()->outputFormat();
+}
+
+uint64_t PcmPipeline::outputFrames(uint64_t inputFrames) const
+{
+    for (const auto& stage : m_stages) {
+        inputFrames = stage->outputFrames(inputFrames);
+    }
+    return inputFrames;
+}
+
+const float* PcmPipeline::process(const float* input, int64_t frames, int64_t& outputFrames)
+{
+    return processFrom(0, input, frames, outputFrames);
+}
+
+const float* PcmPipeline::processFrom(size_t first, const float* input, int64_t frames, int64_t& outputFrames)
+{
+    for (size_t i = first; i < m_stages.size() && frames > 0; ++i) {
+        int64_t produced{0};
+        input = m_stages[i]->process(input, frames, produced);
+        frames = produced;
+    }
+
+    outputFrames = frames;
+    return input;
+}
+
+int targetSampleRate(int inputRate, const ConversionOptions& options)
+{
+    // Opus always codes at 48 kHz; a lower target rate only caps its bandwidth
+    if (options.format.compare(QLatin1String("opus"), Qt::CaseInsensitive) == 0) {
+        return 48000;
+    }
+
+    return options.sampleRate > 0 ? options.sampleRate : inputRate;
+}
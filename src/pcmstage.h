@@ -0,0 +1,76 @@
+#pragma once
+
+#include "codecwrapper.h"
+#include "pcmsource.h"
+
+#include <memory>
+#include <vector>
+
+// Push-based processing step between the decoder and an encoder's stream (resampling,
+// format conversion...). Stages run on the decoder thread and reuse their output
+// buffers, so steady-state processing does not allocate.
+class PcmStage
+{
+public:
+    virtual ~PcmStage() = default;
+
+    virtual PcmFormat outputFormat() const = 0;
+    // Number of frames produced for inputFrames frames of input, 0 if unknown
+    virtual uint64_t outputFrames(uint64_t inputFrames) const { return inputFrames; }
+
+    // Processes frames interleaved frames. The result stays valid until the next call.
+    virtual const float* process(const float* input, int64_t frames, int64_t& outputFrames) = 0;
+    // Drains anything still buffered once the input has ended
+    virtual const float* flush(int64_t& outputFrames)
+    {
+        outputFrames = 0;
+        return nullptr;
+    }
+};
+
+// The chain of stages that turns decoded PCM into what one target's encoder expects
+class PcmPipeline
+{
+public:
+    explicit PcmPipeline(const PcmFormat& inputFormat);
+
+    // Builds the stages needed to go from inputFormat to the target described by options
+    static std::unique_ptr<PcmPipeline> create(const PcmFormat& inputFormat, const ConversionOptions& options);
+
+    void append(std::unique_ptr<PcmStage> stage);
+    bool isEmpty() const { return m_stages.empty(); }
+
+    PcmFormat outputFormat() const;
+    uint64_t outputFrames(uint64_t inputFrames) const;
+
+    const float* process(const float* input, int64_t frames, int64_t& outputFrames);
+    // Flushes every stage in order, feeding each one's tail through the rest of the chain.
+    // Calls write for every chunk produced.
+    template <typename Write>
+    void flush(Write&& write);
+
+private:
+    const float* processFrom(size_t first, const float* input, int64_t frames, int64_t& outputFrames);
+
+    PcmFormat m_inputFormat;
+    std::vector<std::unique_ptr<PcmStage>> m_stages;
+};
+
+template <typename Write>
+void PcmPipeline::flush(Write&& write)
+{
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        int64_t tailFrames{0};
+        const float* tail = m_stages[i]->flush(tailFrames);
+        if (tailFrames > 0) {
+            int64_t frames{0};
+            const float* output = processFrom(i + 1, tail, tailFrames, frames);
+            if (frames > 0) {
+                write(output, frames);
+            }
+        }
+    }
+}
+
+// Sample rate the encoder for options should receive from a source at inputRate
+int targetSampleRate(int inputRate, const ConversionOptions& options);
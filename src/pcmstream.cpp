@@ -0,0 +1,328 @@
+#include "pcmstream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace {
+// Yields before sleeping, the other side usually catches up within a few time slices
+constexpr int SpinCount = 16;
+} // namespace
+
+PcmStream::PcmStream(const PcmFormat& format, uint64_t totalFrames, int capacityBlocks)
+    : m_format{format}
+    , m_totalFrames{totalFrames}
+    , m_capacity{static_cast<uint64_t>(std::max(1, capacityBlocks))}
+    , m_slotSamples{[&format] {
+        constexpr size_t floatsPerLine = CacheLineSize / sizeof(float);
+        const auto samples = static_cast<size_t>(BlockFrames * std::max(1, format.channels));
+        return (samples + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+    }()}
+{
+    // Default-sized rings are allocated up front, steady-state streaming never touches the heap
+    const uint64_t preallocated = std::min<uint64_t>(m_capacity, PreallocatedBlocks);
+    const size_t bytes = m_slotSamples * preallocated * sizeof(float);
+    m_storage.reset(static_cast<float*>(::operator new[](bytes, std::align_val_t{CacheLineSize})));
+
+    m_slots = std::make_unique<float*[]>(m_capacity);
+    for (uint64_t slot = 0; slot < preallocated; ++slot) {
+        m_slots[slot] = m_storage.get() + slot * m_slotSamples;
+    }
+    m_slotFrames = std::make_unique<int64_t[]>(m_capacity);
+    if (m_capacity > PreallocatedBlocks) {
+        m_spares = std::make_unique<float*[]>(m_capacity);
+    }
+}
+
+PcmStream::~PcmStream()
+{
+    const auto freeSlot = [](float* data) {
+        ::operator delete[](data, std::align_val_t{CacheLineSize});
+    };
+
+    for (uint64_t slot = PreallocatedBlocks; slot < m_capacity; ++slot) {
+        if (m_slots[slot]) {
+            freeSlot(m_slots[slot]);
+        }
+    }
+    for (uint64_t spare = m_sparesTaken; spare < m_sparesReleased.load(); ++spare) {
+        freeSlot(m_spares[spare % m_capacity]);
+    }
+}
+
+void PcmStream::AlignedDelete::operator()(float* storage) const
+{
+    ::operator delete[](storage, std::align_val_t{CacheLineSize});
+}
+
+float* PcmStream::slotData(uint64_t slot)
+{
+    // Only the producer fills empty slots, and only slots the consumer is done with
+    if (!m_slots[slot]) {
+        if (m_sparesTaken != m_sparesReleased.load(std::memory_order_acquire)) {
+            m_slots[slot] = m_spares[m_sparesTaken++ % m_capacity];
+        } else {
+            m_slots[slot] = static_cast<float*>(
+                ::operator new[](m_slotSamples * sizeof(float), std::align_val_t{CacheLineSize}));
+        }
+    }
+    return m_slots[slot];
+}
+
+void PcmStream::releaseSlot(uint64_t slot)
+{
+    if (slot < PreallocatedBlocks || !m_slots[slot]) {
+        return;
+    }
+
+    // Kept for the producer: the next slot it fills beyond the preallocated ones reuses it
+    const uint64_t released = m_sparesReleased.load(std::memory_order_relaxed);
+    m_spares[released % m_capacity] = std::exchange(m_slots[slot], nullptr);
+    m_sparesReleased.store(released + 1, std::memory_order_release);
+}
+
+bool PcmStream::write(const float* samples, int64_t frames)
+{
+    const int channels = m_format.channels;
+
+    while (frames > 0) {
+        if (!waitForSpace(m_capacity)) {
+            return false;
+        }
+
+        const int64_t chunk = std::min(frames, BlockFrames);
+        const uint64_t index = m_writeIndex.load(std::memory_order_relaxed);
+        const uint64_t slot = index % m_capacity;
+
+        std::memcpy(slotData(slot), samples,
+                    static_cast<size_t>(chunk * channels) * sizeof(float));
+        m_slotFrames[slot] = chunk;
+
+        // Publishes the slot; sequentially consistent to pair with the consumer's waiting flag
+        m_writeIndex.store(index + 1);
+        if (m_consumerWaiting.load()) {
+            wakeConsumer();
+        }
+
+        samples += chunk * channels;
+        frames -= chunk;
+    }
+
+    return true;
+}
+
+uint64_t PcmStream::queuedBlocks() const
+{
+    return m_writeIndex.load() - m_readIndex.load();
+}
+
+bool PcmStream::waitUntilQueuedBelow(uint64_t blocks)
+{
+    return waitForSpace(std::max<uint64_t>(1, blocks));
+}
+
+bool PcmStream::waitForSpace(uint64_t limit)
+{
+    const auto hasSpace = [this, limit] {
+        return m_writeIndex.load(std::memory_order_relaxed) - m_readIndex.load() < limit;
+    };
+
+    for (int spin{0}; !hasSpace(); ++spin) {
+        if (m_aborted.load()) {
+            return false;
+        }
+
+        if (spin < SpinCount) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // The encoder is behind, sleep until it frees a slot
+        std::unique_lock lock{m_mutex};
+        m_producerWaiting.store(true);
+        m_notFull.wait(lock, [&] { return m_aborted.load() || hasSpace(); });
+        m_producerWaiting.store(false);
+    }
+
+    return !m_aborted.load();
+}
+
+void PcmStream::wakeConsumer()
+{
+    {
+        const std::scoped_lock lock{m_mutex};
+        m_consumerWaiting.store(false);
+
+        // Called under the lock so clearing the callback guarantees no later calls
+        if (m_readyCallback) {
+            m_readyCallback();
+        }
+    }
+
+    m_notEmpty.notify_all();
+}
+
+void PcmStream::wakeProducer()
+{
+    if (!m_producerWaiting.load()) {
+        return;
+    }
+
+    {
+        // Orders the wake-up after the producer's predicate check
+        const std::scoped_lock lock{m_mutex};
+    }
+    m_notFull.notify_one();
+}
+
+void PcmStream::finish()
+{
+    m_finished.store(true);
+    wakeConsumer();
+}
+
+void PcmStream::fail(const QString& error)
+{
+    {
+        const std::scoped_lock lock{m_mutex};
+        m_error = error;
+    }
+
+    m_failed.store(true);
+    finish();
+}
+
+int64_t PcmStream::poll(float* buffer, int64_t maxFrames)
+{
+    if (m_aborted.load()) {
+        return -1;
+    }
+
+    const int channels = m_format.channels;
+    uint64_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+
+    // Checked before the write index, so a finished stream never hides its last blocks
+    const bool finished = m_finished.load();
+    const uint64_t writeIndex = m_writeIndex.load();
+
+    if (readIndex == writeIndex) {
+        if (!finished) {
+            return WouldBlock;
+        }
+        return m_failed.load() ? -1 : 0;
+    }
+
+    int64_t framesCopied{0};
+
+    while (framesCopied < maxFrames && readIndex != writeIndex) {
+        const uint64_t slot = readIndex % m_capacity;
+        const int64_t frames = std::min(m_slotFrames[slot] - m_readPosition, maxFrames - framesCopied);
+
+        std::memcpy(buffer + framesCopied * channels, m_slots[slot] + m_readPosition * channels,
+                    static_cast<size_t>(frames * channels) * sizeof(float));
+
+        m_readPosition += frames;
+        framesCopied += frames;
+
+        if (m_readPosition >= m_slotFrames[slot]) {
+            // Hands the slot back to the producer
+            releaseSlot(slot);
+            m_readPosition = 0;
+            m_readIndex.store(++readIndex);
+        }
+    }
+
+    return framesCopied;
+}
+
+int64_t PcmStream::read(float* buffer, int64_t maxFrames)
+{
+    int64_t frames = poll(buffer, maxFrames);
+
+    for (int spin{0}; frames == WouldBlock && spin < SpinCount; ++spin) {
+        std::this_thread::yield();
+        frames = poll(buffer, maxFrames);
+    }
+
+    if (frames == WouldBlock) {
+        // The decoder is behind, sleep until it publishes a block
+        std::unique_lock lock{m_mutex};
+        while (true) {
+            m_consumerWaiting.store(true);
+            frames = poll(buffer, maxFrames);
+            if (frames != WouldBlock) {
+                break;
+            }
+            m_notEmpty.wait(lock);
+        }
+        m_consumerWaiting.store(false);
+    }
+
+    if (frames > 0) {
+        wakeProducer();
+    }
+    return frames;
+}
+
+int64_t PcmStream::tryRead(float* buffer, int64_t maxFrames)
+{
+    int64_t frames = poll(buffer, maxFrames);
+
+    if (frames == WouldBlock) {
+        // Ask for the ready callback, then check again in case data arrived meanwhile
+        m_consumerWaiting.store(true);
+        frames = poll(buffer, maxFrames);
+    }
+
+    if (frames > 0) {
+        wakeProducer();
+    }
+    return frames;
+}
+
+void PcmStream::setReadyCallback(std::function<void()> callback)
+{
+    const std::scoped_lock lock{m_mutex};
+    m_readyCallback = std::move(callback);
+}
+
+QString PcmStream::errorString() const
+{
+    const std::scoped_lock lock{m_mutex};
+    return m_aborted.load() && m_error.isEmpty() ? QStringLiteral("Conversion aborted") : m_error;
+}
+
+void PcmStream::abort()
+{
+    m_aborted.store(true);
+
+    {
+        const std::scoped_lock lock{m_mutex};
+        m_readyCallback = {};
+    }
+
+    m_notFull.notify_all();
+    m_notEmpty.notify_all();
+}
+
+PcmStreamSource::PcmStreamSource(std::shared_ptr<PcmStream> stream)
+    : m_stream{std::move(stream)}
+{ }
+
+bool PcmStreamSource::open(const QString& path)
+{
+    // Only informational, the data comes from the stream
+    m_path = path;
+    return true;
+}
+
+int64_t PcmStreamSource::read(float* buffer, int64_t maxFrames)
+{
+    const int64_t frames = m_stream->read(buffer, maxFrames);
+    if (frames < 0) {
+        m_error = m_stream->errorString();
+    }
+    return frames;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "pcmsource.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Bounded single-producer/single-consumer ring of decoded PCM blocks between a decoder
+// thread and one encoder. Slots are preallocated and cache-line aligned, and the hand-off
+// itself is lock-free. A full ring makes the producer sleep, which throttles decoding to
+// the encoder's pace; the mutex is only taken when one side has to sleep or be woken.
+// Rings deeper than PreallocatedBlocks allocate the extra slots on demand. Read slots go to
+// a spare list the producer takes from before allocating, so a deep ring only costs memory
+// for the most blocks it held at once, and steady-state streaming never touches the heap.
+class PcmStream
+{
+public:
+    static constexpr int64_t BlockFrames = 4096;
+    static constexpr int64_t WouldBlock = -2;
+    static constexpr int PreallocatedBlocks = 16;
+
+    PcmStream(const PcmFormat& format, uint64_t totalFrames, int capacityBlocks = PreallocatedBlocks);
+    ~PcmStream();
+
+    PcmFormat format() const { return m_format; }
+    uint64_t totalFrames() const { return m_totalFrames; }
+
+    // Producer side
+    bool write(const float* samples, int64_t frames); // false once the stream was aborted
+    void finish();
+    void fail(const QString& error);
+    // Blocks queued and not yet read
+    uint64_t queuedBlocks() const;
+    // Sleeps until fewer than blocks blocks are queued; false once the stream was aborted
+    bool waitUntilQueuedBelow(uint64_t blocks);
+
+    // Consumer side, same contract as PcmSource::read()
+    int64_t read(float* buffer, int64_t maxFrames);
+    // Non-blocking variant, returns WouldBlock if no data is queued yet
+    int64_t tryRead(float* buffer, int64_t maxFrames);
+    // Called on the producer thread, under the stream lock, when data arrives after tryRead()
+    // returned WouldBlock. Must only post work elsewhere (e.g. a queued invokeMethod).
+    void setReadyCallback(std::function<void()> callback);
+
+    QString errorString() const;
+
+    // Stops both sides, safe to call from either
+    void abort();
+    bool isAborted() const { return m_aborted.load(); }
+
+private:
+    static constexpr size_t CacheLineSize = 64;
+
+    struct AlignedDelete {
+        void operator()(float* storage) const;
+    };
+
+    // Consumer side without sleeping or waking, returns WouldBlock when empty
+    int64_t poll(float* buffer, int64_t maxFrames);
+    bool waitForSpace(uint64_t limit);
+    float* slotData(uint64_t slot);
+    void releaseSlot(uint64_t slot);
+    void wakeConsumer();
+    void wakeProducer();
+
+    const PcmFormat m_format;
+    const uint64_t m_totalFrames;
+    const uint64_t m_capacity;
+    const size_t m_slotSamples; // Floats per slot, padded to whole cache lines
+
+    std::unique_ptr<float[], AlignedDelete> m_storage; // The preallocated slots
+    std::unique_ptr<float*[]> m_slots;                  // Data of every slot, null while unallocated
+    std::unique_ptr<int64_t[]> m_slotFrames;
+    // Buffers of read slots beyond the preallocated ones, released by the consumer and
+    // reused by the producer. Never more than the ring holds, so it can't overflow.
+    std::unique_ptr<float*[]> m_spares;
+    uint64_t m_sparesTaken{0}; // Producer
+
+    // Written by one side each, kept on separate cache lines to avoid false sharing
+    alignas(CacheLineSize) std::atomic<uint64_t> m_writeIndex{0};
+    alignas(CacheLineSize) std::atomic<uint64_t> m_readIndex{0};
+    int64_t m_readPosition{0}; // Frames already consumed from the slot at m_readIndex
+    std::atomic<uint64_t> m_sparesReleased{0};
+
+    alignas(CacheLineSize) std::atomic<bool> m_finished{false};
+    std::atomic<bool> m_failed{false};
+    std::atomic<bool> m_aborted{false};
+    std::atomic<bool> m_producerWaiting{false};
+    std::atomic<bool> m_consumerWaiting{false};
+
+    // Slow path only: sleeping on a full or empty ring, the ready callback and the error text
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+    std::function<void()> m_readyCallback;
+    QString m_error;
+};
+
+// Lets an in-process encoder consume a stream like any other PcmSource
+class PcmStreamSource : public PcmSource
+{
+public:
+    explicit PcmStreamSource(std::shared_ptr<PcmStream> stream);
+
+    bool open(const QString& path) override;
+    PcmFormat format() const override { return m_stream->format(); }
+    uint64_t totalFrames() const override { return m_stream->totalFrames(); }
+    int64_t read(float* buffer, int64_t maxFrames) override;
+
+private:
+    std::shared_ptr<PcmStream> m_stream;
+};
@@ -0,0 +1,27 @@
+#include "quantizestage.h"
+
+#include <algorithm>
+
+QuantizeStage::QuantizeStage(const PcmFormat& inputFormat, int bitsPerSample)
+    : m_inputFormat{inputFormat}
+    , m_bitsPerSample{bitsPerSample}
+{ }
+
+PcmFormat QuantizeStage::outputFormat() const
+{
+    PcmFormat format{m_inputFormat};
+    format.bitsPerSample = m_bitsPerSample;
+    return format;
+}
+
+const float* QuantizeStage::process(const float* input, int64_t frames, int64_t& outputFrames)
+{
+    const auto samples = static_cast<size_t>(frames * m_inputFormat.channels);
+
+    m_output.resize(samples);
+    std::copy_n(input, samples, m_output.data());
+    Dsp::quantize(m_output.data(), samples, m_bitsPerSample, &m_dither);
+
+    outputFrames = frames;
+    return m_output.data();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "dspkernels.h"
+#include "pcmstage.h"
+
+#include <vector>
+
+// Rounds samples to the grid of the target integer bit depth with TPDF dither,
+// so the encoder's own float-to-int step is exact (e.g. 24 -> 16 bit FLAC)
+class QuantizeStage : public PcmStage
+{
+public:
+    QuantizeStage(const PcmFormat& inputFormat, int bitsPerSample);
+
+    PcmFormat outputFormat() const override;
+    const float* process(const float* input, int64_t frames, int64_t& outputFrames) override;
+
+private:
+    PcmFormat m_inputFormat;
+    int m_bitsPerSample;
+    Dsp::DitherState m_dither;
+    std::vector<float> m_output;
+};
@@ -0,0 +1,180 @@
+#include "resamplestage.h"
+#include "dspkernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+// Larger ratios (e.g. 44100 -> 47999) reuse the nearest of this many filter phases
+constexpr uint64_t MaxPhases = 1024;
+// Zero crossings of the sinc on each side of the centre, at the lower of the two rates
+constexpr int ZeroCrossings = 16;
+// Passband edge as a fraction of the lower Nyquist frequency
+constexpr double Rolloff = 0.945;
+// Kaiser window shape, roughly 90 dB of stopband attenuation
+constexpr double KaiserBeta = 9.0;
+constexpr double Pi = 3.14159265358979323846;
+
+double besselI0(double x)
+{
+    double sum{1.0};
+    double term{1.0};
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+} // namespace
+
+ResampleStage::ResampleStage(const PcmFormat& inputFormat, int outputRate)
+    : m_inputFormat{inputFormat}
+    , m_outputRate{outputRate}
+{
+    const auto divisor = static_cast<uint64_t>(std::gcd(inputFormat.sampleRate, outputRate));
+    m_interpolation = static_cast<uint64_t>(outputRate) / divisor;
+    m_decimation = static_cast<uint64_t>(inputFormat.sampleRate) / divisor;
+    m_phases = static_cast<int>(std::min(m_interpolation, MaxPhases));
+
+    // Downsampling lowers the cutoff, which needs a proportionally longer filter
+    const double ratio = std::min(1.0, static_cast<double>(outputRate) / inputFormat.sampleRate);
+    m_taps = static_cast<int>(std::ceil(2.0 * ZeroCrossings / ratio));
+    m_taps = (m_taps + 7) / 8 * 8;
+
+    buildFilter();
+
+    // Leading silence puts the filter centre on the first input frame
+    append(nullptr, m_taps / 2 - 1);
+}
+
+PcmFormat ResampleStage::outputFormat() const
+{
+    PcmFormat format{m_inputFormat};
+    format.sampleRate = m_outputRate;
+    return format;
+}
+
+uint64_t ResampleStage::outputFrames(uint64_t inputFrames) const
+{
+    return (inputFrames * m_interpolation + m_decimation - 1) / m_decimation;
+}
+
+void ResampleStage::buildFilter()
+{
+    const double ratio = std::min(1.0, static_cast<double>(m_outputRate) / m_inputFormat.sampleRate);
+    const int length = m_taps * m_phases;
+    const double centre = length / 2.0;
+    // Cutoff in cycles per sample of the oversampled prototype
+    const double cutoff = 0.5 * ratio * Rolloff / m_phases;
+    const double windowNorm = besselI0(KaiserBeta);
+
+    m_filter.assign(static_cast<size_t>(length), 0.0F);
+
+    for (int phase = 0; phase < m_phases; ++phase) {
+        for (int tap = 0; tap < m_taps; ++tap) {
+            const int n = phase + tap * m_phases;
+            const double x = n - centre;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * Pi * cutoff * x) / (2.0 * Pi * cutoff * x);
+            const double w = x / centre;
+            const double window = besselI0(KaiserBeta * std::sqrt(std::max(0.0, 1.0 - w * w))) / windowNorm;
+
+            // Reversed so each output is a plain dot product over the history
+            m_filter[static_cast<size_t>(phase * m_taps + (m_taps - 1 - tap))]
+                = static_cast<float>(2.0 * cutoff * m_phases * sinc * window);
+        }
+    }
+}
+
+void ResampleStage::append(const float* input, int64_t frames)
+{
+    const int channels = m_inputFormat.channels;
+
+    // Drop history the filter has moved past
+    if (m_index > 0) {
+        for (int ch = 0; ch < channels; ++ch) {
+            float* row = m_history.data() + ch * m_capacity;
+            std::memmove(row, row + m_index, static_cast<size_t>(m_buffered - m_index) * sizeof(float));
+        }
+        m_buffered -= m_index;
+        m_index = 0;
+    }
+
+    // Only grows for the first blocks, after that the history is reused
+    if (m_buffered + frames > m_capacity) {
+        const int64_t capacity = m_buffered + frames + m_taps;
+        std::vector<float> history(static_cast<size_t>(capacity * channels));
+        for (int ch = 0; ch < channels; ++ch) {
+            std::copy_n(m_history.data() + ch * m_capacity, m_buffered, history.data() + ch * capacity);
+        }
+        m_history.swap(history);
+        m_capacity = capacity;
+    }
+
+    for (int ch = 0; ch < channels; ++ch) {
+        float* row = m_history.data() + ch * m_capacity + m_buffered;
+        if (!input) {
+            std::fill_n(row, frames, 0.0F);
+            continue;
+        }
+        for (int64_t i = 0; i < frames; ++i) {
+            row[i] = input[i * channels + ch];
+        }
+    }
+
+    m_buffered += frames;
+}
+
+int64_t ResampleStage::produce(uint64_t maxFrames)
+{
+    const int channels = m_inputFormat.channels;
+
+    const auto available = static_cast<uint64_t>(m_buffered - m_index);
+    const uint64_t bound = std::min(maxFrames, available * m_interpolation / m_decimation + 2);
+    if (m_output.size() < bound * channels) {
+        m_output.resize(bound * channels);
+    }
+
+    uint64_t frames{0};
+    while (frames < bound && m_index + m_taps <= m_buffered) {
+        // Nearest filter phase when the ratio needs more phases than we keep
+        const auto row = static_cast<int>(m_phase * static_cast<uint64_t>(m_phases) / m_interpolation);
+        const float* coefficients = m_filter.data() + static_cast<size_t>(row) * m_taps;
+
+        float* out = m_output.data() + frames * channels;
+        for (int ch = 0; ch < channels; ++ch) {
+            out[ch] = Dsp::dotProduct(m_history.data() + ch * m_capacity + m_index, coefficients, m_taps);
+        }
+        ++frames;
+
+        m_phase += m_decimation;
+        m_index += static_cast<int64_t>(m_phase / m_interpolation);
+        m_phase %= m_interpolation;
+    }
+
+    m_framesOut += frames;
+    return static_cast<int64_t>(frames);
+}
+
+const float* ResampleStage::process(const float* input, int64_t frames, int64_t& outputFrames)
+{
+    append(input, frames);
+    m_framesIn += static_cast<uint64_t>(frames);
+
+    outputFrames = produce(UINT64_MAX);
+    return m_output.data();
+}
+
+const float* ResampleStage::flush(int64_t& outputFrames)
+{
+    // Enough silence to move the filter past the last input frame
+    append(nullptr, m_taps);
+
+    const uint64_t total = ResampleStage::outputFrames(m_framesIn);
+    outputFrames = total > m_framesOut ? produce(total - m_framesOut) : 0;
+    return m_output.data();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pcmstage.h"
+
+#include <vector>
+
+// Polyphase windowed-sinc sample rate converter. Every encoder gets the same
+// resampler, so the output rate no longer depends on which tool does the encoding.
+class ResampleStage : public PcmStage
+{
+public:
+    ResampleStage(const PcmFormat& inputFormat, int outputRate);
+
+    PcmFormat outputFormat() const override;
+    uint64_t outputFrames(uint64_t inputFrames) const override;
+
+    const float* process(const float* input, int64_t frames, int64_t& outputFrames) override;
+    const float* flush(int64_t& outputFrames) override;
+
+private:
+    void buildFilter();
+    void append(const float* input, int64_t frames);
+    // Produces output frames while the filter window fits in the buffered input
+    int64_t produce(uint64_t maxFrames);
+
+    PcmFormat m_inputFormat;
+    int m_outputRate;
+
+    // Output frame n is taken at input position n * m_decimation / m_interpolation
+    uint64_t m_interpolation{1};
+    uint64_t m_decimation{1};
+    int m_phases{1};
+    int m_taps{0};
+    std::vector<float> m_filter; // m_phases rows of m_taps coefficients, time reversed
+
+    // Planar input history, one row of m_capacity frames per channel
+    std::vector<float> m_history;
+    int64_t m_capacity{0};
+    int64_t m_buffered{0};
+    int64_t m_index{0};   // First history frame under the filter window
+    uint64_t m_phase{0}; // Position between m_index and m_index + 1 in 1/m_interpolation steps
+
+    uint64_t m_framesIn{0};
+    uint64_t m_framesOut{0};
+    std::vector<float> m_output;
+};
@@ -0,0 +1,162 @@
+#include "stagedoutput.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QRandomGenerator>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+QString errnoString()
+{
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+// Hidden name next to the final file, unique enough for concurrent jobs
+QString tempPathFor(const QString& finalPath)
+{
+    const QFileInfo info{finalPath};
+    return info.absolutePath() + "/." + info.fileName() + "."
+         + QString::number(QRandomGenerator::global()->generate(), 36) + ".part";
+}
+} // namespace
+
+StagedOutput::StagedOutput(QString finalPath)
+    : m_finalPath{std::move(finalPath)}
+{ }
+
+StagedOutput::~StagedOutput()
+{
+    discard();
+}
+
+bool StagedOutput::open(QString& error)
+{
+    const QString directory = QFileInfo{m_finalPath}.absolutePath();
+    // Mirrors create their folder structure as they go
+    QDir{}.mkpath(directory);
+
+#ifdef O_TMPFILE
+    m_fd = ::open(QFile::encodeName(directory).constData(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0666);
+    if (m_fd >= 0) {
+        // Reopening the descriptor through /proc works from any process, including encoder CLIs
+        m_path = QString("/proc/%1/fd/%2").arg(::getpid()).arg(m_fd);
+        return true;
+    }
+#endif
+
+    // No O_TMPFILE support (other systems, network and FUSE file systems)
+    m_tempPath = tempPathFor(m_finalPath);
+    QFile file{m_tempPath};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+        error = "Cannot create output file in " + directory + ": " + file.errorString();
+        m_tempPath.clear();
+        return false;
+    }
+
+    m_path = m_tempPath;
+    return true;
+}
+
+bool StagedOutput::publish(QString& error)
+{
+    const QByteArray finalName = QFile::encodeName(m_finalPath);
+
+    if (m_fd >= 0) {
+        const QByteArray procPath = QFile::encodeName(m_path);
+
+        // Fast path: nothing to replace
+        if (::linkat(AT_FDCWD, procPath.constData(), AT_FDCWD, finalName.constData(), AT_SYMLINK_FOLLOW) != 0) {
+            if (errno != EEXIST) {
+                error = "Cannot publish " + m_finalPath + ": " + errnoString();
+                return false;
+            }
+
+            // Link under a temp name, then atomically replace the old file
+            const QByteArray tempName = QFile::encodeName(tempPathFor(m_finalPath));
+            if (::linkat(AT_FDCWD, procPath.constData(), AT_FDCWD, tempName.constData(), AT_SYMLINK_FOLLOW) != 0
+                || ::rename(tempName.constData(), finalName.constData()) != 0) {
+                error = "Cannot publish " + m_finalPath + ": " + errnoString();
+                ::unlink(tempName.constData());
+                return false;
+            }
+        }
+
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    else if (!m_tempPath.isEmpty()) {
+        if (::rename(QFile::encodeName(m_tempPath).constData(), finalName.constData()) != 0) {
+            error = "Cannot publish " + m_finalPath + ": " + errnoString();
+            return false;
+        }
+        m_tempPath.clear();
+    }
+
+    m_published = true;
+    return true;
+}
+
+bool StagedOutput::publishLink(const QString& existing, QString& error)
+{
+    // Linked under a temp name first, then atomically replaces the old file like publish()
+    const QByteArray tempName = QFile::encodeName(tempPathFor(m_finalPath));
+    if (::link(QFile::encodeName(existing).constData(), tempName.constData()) != 0) {
+        error = "Cannot link " + m_finalPath + ": " + errnoString();
+        return false;
+    }
+    if (::rename(tempName.constData(), QFile::encodeName(m_finalPath).constData()) != 0) {
+        error = "Cannot publish " + m_finalPath + ": " + errnoString();
+        ::unlink(tempName.constData());
+        return false;
+    }
+
+    discard();
+    m_published = true;
+    return true;
+}
+
+void StagedOutput::discard()
+{
+    // An unlinked O_TMPFILE inode disappears with its last descriptor
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    if (!m_tempPath.isEmpty()) {
+        QFile::remove(m_tempPath);
+        m_tempPath.clear();
+    }
+}
+
+void syncOutputs(const QStringList& paths)
+{
+    QHash<QString, QStringList> directories;
+    for (const QString& path : paths) {
+        directories[QFileInfo{path}.absolutePath()].append(path);
+    }
+
+    for (auto it = directories.cbegin(); it != directories.cend(); ++it) {
+        for (const QString& path : it.value()) {
+            const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+
+        // Makes the new names durable
+        const int dirFd = ::open(QFile::encodeName(it.key()).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirFd >= 0) {
+            ::fsync(dirFd);
+            ::close(dirFd);
+        }
+    }
+}
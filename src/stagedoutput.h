@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+// An output file that only shows up under its final name once it is complete.
+// The encoder writes to path(); a crash or cancel leaves nothing behind in the
+// destination. On Linux the data goes to an unnamed O_TMPFILE inode in the
+// destination directory that publish() links into place, elsewhere (or on file
+// systems without O_TMPFILE, e.g. NFS/SMB) to a hidden temp file that is renamed.
+// Nothing is fsynced here, see syncOutputs().
+class StagedOutput
+{
+public:
+    explicit StagedOutput(QString finalPath);
+    ~StagedOutput();
+
+    StagedOutput(const StagedOutput&) = delete;
+    StagedOutput& operator=(const StagedOutput&) = delete;
+
+    bool open(QString& error);
+
+    QString finalPath() const { return m_finalPath; }
+    // Where the encoder should write. Also valid for child processes.
+    QString path() const { return m_path; }
+
+    // Moves the finished file to its final name, replacing any existing file
+    bool publish(QString& error);
+    // Publishes a hard link to existing (an identical finished file) instead of the staged
+    // data, which is dropped. Fails if existing is on another file system.
+    bool publishLink(const QString& existing, QString& error);
+    // Drops the staged data, if not published yet
+    void discard();
+
+private:
+    QString m_finalPath;
+    QString m_path;
+    QString m_tempPath; // Named fallback only
+    int m_fd{-1};       // O_TMPFILE inode only
+    bool m_published{false};
+};
+
+// Flushes published files to disk: every file, then each containing directory once.
+// Meant for the end of a batch, or a group commit of the batch journal, so encoders
+// never stall on per-file syncs.
+void syncOutputs(const QStringList& paths);
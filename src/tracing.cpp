@@ -0,0 +1,246 @@
+#include "tracing.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace {
+// Events per chunk; a thread allocates another chunk when one is full
+constexpr int ChunkEvents = 1024;
+
+struct Event {
+    const char* name;
+    uint64_t id;      // Track of begin/end events
+    int64_t start;    // ns
+    int64_t duration; // ns, complete events only
+    char phase;       // 'X' complete, 'b' begin, 'e' end
+};
+
+struct Chunk {
+    Event events[ChunkEvents];
+    std::atomic<int> count{0}; // Published by the writer
+    std::atomic<Chunk*> next{nullptr};
+};
+
+// Written by its thread only; read by write() under the registry lock. Chunks before the one
+// the thread writes to are never touched by it again, so write() frees them once read.
+struct ThreadBuffer {
+    int tid{0};
+    QString name;
+    Chunk* tail{nullptr}; // Writer
+    Chunk* head{nullptr}; // Reader
+    int read{0};          // Reader, events of head already written out
+    std::atomic<bool> exited{false};
+};
+
+struct Registry {
+    QMutex lock;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    int nextTid{1};
+};
+
+std::atomic<bool> enabled{false};
+
+// Never destroyed, threads may still record during shutdown
+Registry& registry()
+{
+    static auto* instance = new Registry;
+    return *instance;
+}
+
+// Marks the buffer of a finished thread, write() drops it once everything is read
+struct ThreadHandle {
+    ThreadBuffer* buffer{nullptr};
+
+    ~ThreadHandle()
+    {
+        if (buffer) {
+            buffer->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadHandle currentThread;
+
+int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+ThreadBuffer* threadBuffer()
+{
+    if (currentThread.buffer) {
+        return currentThread.buffer;
+    }
+
+    // Once per thread
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->tail = buffer->head = new Chunk;
+
+    const QThread* thread = QThread::currentThread();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        buffer->name = QStringLiteral("Main");
+    } else {
+        buffer->name = thread->objectName().isEmpty() ? QStringLiteral("Thread") : thread->objectName();
+    }
+
+    Registry& reg = registry();
+    const QMutexLocker locker{&reg.lock};
+    buffer->tid = reg.nextTid++;
+    currentThread.buffer = buffer.get();
+    reg.buffers.push_back(std::move(buffer));
+    return currentThread.buffer;
+}
+
+void record(const Event& event)
+{
+    ThreadBuffer* buffer = threadBuffer();
+    Chunk* chunk = buffer->tail;
+
+    int count = chunk->count.load(std::memory_order_relaxed);
+    if (count == ChunkEvents) {
+        auto* next = new Chunk;
+        chunk->next.store(next, std::memory_order_release);
+        buffer->tail = chunk = next;
+        count = 0;
+    }
+
+    chunk->events[count] = event;
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+// Moves what buffer recorded since the last call into events
+void drain(ThreadBuffer& buffer, QJsonArray& events, qint64 pid)
+{
+    while (true) {
+        Chunk* chunk = buffer.head;
+        const int count = chunk->count.load(std::memory_order_acquire);
+
+        for (int i = buffer.read; i < count; ++i) {
+            const Event& event = chunk->events[i];
+            QJsonObject object{{"name", QString::fromLatin1(event.name)},
+                               {"ph", QString{QLatin1Char(event.phase)}},
+                               {"ts", static_cast<double>(event.start) / 1000.0},
+                               {"pid", pid},
+                               {"tid", buffer.tid}};
+            if (event.phase == 'X') {
+                object.insert("dur", static_cast<double>(event.duration) / 1000.0);
+            } else {
+                object.insert("cat", "conversion");
+                object.insert("id", QString("0x%1").arg(event.id, 0, 16));
+            }
+            events.append(object);
+        }
+        buffer.read = count;
+
+        Chunk* next = chunk->next.load(std::memory_order_acquire);
+        if (count < ChunkEvents || !next) {
+            return;
+        }
+        delete chunk;
+        buffer.head = next;
+        buffer.read = 0;
+    }
+}
+} // namespace
+
+namespace Trace {
+void setEnabled(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+bool isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void begin(const char* name, uint64_t id)
+{
+    if (isEnabled()) {
+        record({name, id, now(), 0, 'b'});
+    }
+}
+
+void end(const char* name, uint64_t id)
+{
+    if (isEnabled()) {
+        record({name, id, now(), 0, 'e'});
+    }
+}
+
+uint64_t jobTrack(int jobId)
+{
+    return static_cast<uint64_t>(jobId) << 8 | 0xff;
+}
+
+uint64_t targetTrack(int jobId, int targetIndex)
+{
+    // 0xff is the job's own track; CUE sheets have at most 99 tracks anyway
+    return static_cast<uint64_t>(jobId) << 8 | static_cast<uint64_t>(qBound(0, targetIndex, 0xfe));
+}
+
+Scope::Scope(const char* name)
+    : m_name{name}
+    , m_start{isEnabled() ? now() : -1}
+{ }
+
+Scope::~Scope()
+{
+    if (m_start >= 0) {
+        record({m_name, 0, m_start, now() - m_start, 'X'});
+    }
+}
+
+bool write(const QString& path, QString& error)
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+
+    {
+        Registry& reg = registry();
+        const QMutexLocker locker{&reg.lock};
+
+        for (auto it = reg.buffers.begin(); it != reg.buffers.end();) {
+            ThreadBuffer& buffer = **it;
+            // Read before draining: a thread that exited has recorded everything
+            const bool exited = buffer.exited.load(std::memory_order_acquire);
+
+            events.append(QJsonObject{{"name", "thread_name"},
+                                      {"ph", "M"},
+                                      {"pid", pid},
+                                      {"tid", buffer.tid},
+                                      {"args", QJsonObject{{"name", buffer.name}}}});
+            drain(buffer, events, pid);
+
+            if (exited) {
+                delete buffer.head;
+                it = reg.buffers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    const QByteArray data = QJsonDocument{QJsonObject{{"traceEvents", events}, {"displayTimeUnit", "ms"}}}.toJson(
+        QJsonDocument::Compact);
+
+    QSaveFile file{path};
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        error = "Cannot write " + path + ": " + file.errorString();
+        return false;
+    }
+    return true;
+}
+} // namespace Trace
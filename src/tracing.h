@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QString>
+
+#include <cstdint>
+
+// Timeline of the conversion pipeline, written as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+// Every thread records into its own buffer without locks; while tracing is off, recording
+// is a single relaxed atomic load. Names must be string literals, only the pointer is kept.
+namespace Trace {
+void setEnabled(bool enabled);
+bool isEnabled();
+
+// Spans matched by name and id, may begin and end on different threads. Spans with the
+// same id are drawn on one track and must nest.
+void begin(const char* name, uint64_t id);
+void end(const char* name, uint64_t id);
+
+// Ids of the track of a job, and of the track of one of its outputs
+uint64_t jobTrack(int jobId);
+uint64_t targetTrack(int jobId, int targetIndex);
+
+// Span of the enclosing scope on the calling thread
+class Scope
+{
+public:
+    explicit Scope(const char* name);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* m_name;
+    int64_t m_start;
+};
+
+// Takes everything recorded since the last call and writes it to path as JSON
+bool write(const QString& path, QString& error);
+} // namespace Trace
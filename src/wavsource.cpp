@@ -0,0 +1,141 @@
+#include "wavsource.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+constexpr uint16_t WavFormatPcm = 0x0001;
+constexpr uint16_t WavFormatFloat = 0x0003;
+constexpr uint16_t WavFormatExtensible = 0xFFFE;
+} // namespace
+
+bool WavSource::open(const QString& path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = "Cannot open input file: " + m_file.errorString();
+        return false;
+    }
+
+    const QByteArray riff = m_file.read(12);
+    if (riff.size() < 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE") {
+        m_error = "Not a RIFF/WAVE file";
+        return false;
+    }
+
+    uint16_t audioFormat{0};
+    bool haveFormat{false};
+
+    // Walk the chunk list until the sample data is found
+    while (!m_file.atEnd()) {
+        const QByteArray header = m_file.read(8);
+        if (header.size() < 8) {
+            break;
+        }
+
+        const QByteArray id = header.left(4);
+        const auto size = qFromLittleEndian<quint32>(header.constData() + 4);
+
+        if (id == "fmt ") {
+            const QByteArray fmt = m_file.read(size);
+            if (fmt.size() < 16) {
+                break;
+            }
+
+            audioFormat = qFromLittleEndian<quint16>(fmt.constData());
+            m_format.channels = qFromLittleEndian<quint16>(fmt.constData() + 2);
+            m_format.sampleRate = static_cast<int>(qFromLittleEndian<quint32>(fmt.constData() + 4));
+            m_format.bitsPerSample = qFromLittleEndian<quint16>(fmt.constData() + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format code in the sub-format GUID
+            if (audioFormat == WavFormatExtensible && fmt.size() >= 26) {
+                audioFormat = qFromLittleEndian<quint16>(fmt.constData() + 24);
+            }
+            haveFormat = true;
+
+            if (size & 1) {
+                m_file.skip(1);
+            }
+        }
+        else if (id == "data") {
+            if (!haveFormat) {
+                break;
+            }
+
+            m_isFloat = audioFormat == WavFormatFloat;
+            m_bytesPerSample = (m_format.bitsPerSample + 7) / 8;
+
+            const bool supported = (audioFormat == WavFormatPcm && m_bytesPerSample >= 1 && m_bytesPerSample <= 4)
+                                || (m_isFloat && m_bytesPerSample == 4);
+            if (!supported || !m_format.isValid()) {
+                m_error = QString("Unsupported WAV sample format (%1, %2 bits)").arg(audioFormat).arg(m_format.bitsPerSample);
+                return false;
+            }
+
+            m_totalFrames = size / (static_cast<uint64_t>(m_bytesPerSample) * m_format.channels);
+            return true;
+        }
+        else {
+            m_file.skip(size + (size & 1));
+        }
+    }
+
+    m_error = "WAV file has no audio data";
+    return false;
+}
+
+int64_t WavSource::read(float* buffer, int64_t maxFrames)
+{
+    const int64_t framesLeft = static_cast<int64_t>(m_totalFrames - m_framesRead);
+    const int64_t frames = qMin(maxFrames, framesLeft);
+    if (frames <= 0) {
+        return 0;
+    }
+
+    const int64_t samples = frames * m_format.channels;
+    m_readBuffer.resize(samples * m_bytesPerSample);
+
+    const qint64 bytesRead = m_file.read(m_readBuffer.data(), m_readBuffer.size());
+    if (bytesRead < 0) {
+        m_error = "Read error: " + m_file.errorString();
+        return -1;
+    }
+
+    const int64_t framesGot = bytesRead / (m_bytesPerSample * m_format.channels);
+    const int64_t samplesGot = framesGot * m_format.channels;
+    const auto* in = reinterpret_cast<const uchar*>(m_readBuffer.constData());
+
+    for (int64_t i = 0; i < samplesGot; ++i) {
+        const uchar* p = in + i * m_bytesPerSample;
+        switch (m_bytesPerSample) {
+            case 1:
+                buffer[i] = (static_cast<int>(p[0]) - 128) / 128.0F;
+                break;
+            case 2:
+                buffer[i] = qFromLittleEndian<qint16>(p) / 32768.0F;
+                break;
+            case 3: {
+                const int32_t value = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8)
+                                                           | (static_cast<uint32_t>(p[1]) << 16)
+                                                           | (static_cast<uint32_t>(p[2]) << 24))
+                                    >> 8;
+                buffer[i] = value / 8388608.0F;
+                break;
+            }
+            case 4:
+                if (m_isFloat) {
+                    const quint32 bits = qFromLittleEndian<quint32>(p);
+                    std::memcpy(&buffer[i], &bits, sizeof(float));
+                } else {
+                    buffer[i] = static_cast<float>(qFromLittleEndian<qint32>(p) / 2147483648.0);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    m_framesRead += static_cast<uint64_t>(framesGot);
+    return framesGot;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "pcmsource.h"
+
+#include <QFile>
+#include <QByteArray>
+
+// Reads PCM (8/16/24/32-bit) and IEEE float RIFF/WAVE files
+class WavSource : public PcmSource
+{
+public:
+    bool open(const QString& path) override;
+    PcmFormat format() const override { return m_format; }
+    uint64_t totalFrames() const override { return m_totalFrames; }
+    int64_t read(float* buffer, int64_t maxFrames) override;
+
+private:
+    QFile m_file;
+    PcmFormat m_format;
+    bool m_isFloat{false};
+    int m_bytesPerSample{0};
+    uint64_t m_totalFrames{0};
+    uint64_t m_framesRead{0};
+    QByteArray m_readBuffer;
+};